@@ -0,0 +1,53 @@
+#include <xc.h>    
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "i2c_core.h"
+
+//Initialize the bus timeout feature
+void I2C_initBTO(bool reset, bool prescale, uint8_t timeout, I2C_BTO_Clock clock)
+{
+    I2C1BTO = (reset << 7) | (prescale << 6) | (0x3F & timeout);
+    I2C1BTOC = clock;
+}
+
+//Initializes the I/O pins for I2C
+void I2C_initPins(void)
+{
+    //Disable Analog Inputs
+    I2C_PIN_ANSEL(I2C_SCL_PORT, I2C_SCL_PIN) = 0;
+    I2C_PIN_ANSEL(I2C_SDA_PORT, I2C_SDA_PIN) = 0;
+    
+    //Configure as Open-Drain
+    I2C_PIN_ODCON(I2C_SCL_PORT, I2C_SCL_PIN) = 1;
+    I2C_PIN_ODCON(I2C_SDA_PORT, I2C_SDA_PIN) = 1;
+    
+    //Set as Outputs
+    I2C_PIN_TRIS(I2C_SCL_PORT, I2C_SCL_PIN) = 0;
+    I2C_PIN_TRIS(I2C_SDA_PORT, I2C_SDA_PIN) = 0;
+    
+    //Set PPS Inputs
+    I2C1SCLPPS = I2C_PPS_IN(I2C_SCL_PORT, I2C_SCL_PIN);
+    I2C1SDAPPS = I2C_PPS_IN(I2C_SDA_PORT, I2C_SDA_PIN);
+    
+    //Set PPS Outputs
+    I2C_PIN_PPS(I2C_SCL_PORT, I2C_SCL_PIN) = I2C_PPS_OUT_SCL;
+    I2C_PIN_PPS(I2C_SDA_PORT, I2C_SDA_PIN) = I2C_PPS_OUT_SDA;
+    
+    //Standard Slew Rate
+    I2C_PIN_PAD(I2C_SCL_PORT, I2C_SCL_PIN).SLEW = 0b00;
+    I2C_PIN_PAD(I2C_SDA_PORT, I2C_SDA_PIN).SLEW = 0b00;
+    
+    //I2C Thresholds
+    I2C_PIN_PAD(I2C_SCL_PORT, I2C_SCL_PIN).TH = 0b01;
+    I2C_PIN_PAD(I2C_SDA_PORT, I2C_SDA_PIN).TH = 0b01;
+    
+    //Enable Internal Pullup resistors
+#ifdef USE_INTERNAL_PULLUPS
+    
+    //10x Normal Pullup Strength
+    I2C_PIN_PAD(I2C_SCL_PORT, I2C_SCL_PIN).PU = 0b10;
+    I2C_PIN_PAD(I2C_SDA_PORT, I2C_SDA_PIN).PU = 0b10;
+#endif
+}
@@ -0,0 +1,112 @@
+/*
+ [2022] Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip 
+    software and any derivatives exclusively with Microchip products. 
+    You are responsible for complying with 3rd party license terms  
+    applicable to your use of 3rd party software (including open source  
+    software) that may accompany Microchip software. SOFTWARE IS ?AS IS.? 
+    NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS 
+    SOFTWARE, INCLUDING ANY IMPLIED WARRANTIES OF NON-INFRINGEMENT,  
+    MERCHANTABILITY, OR FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT 
+    WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, 
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY 
+    KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF 
+    MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE 
+    FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP?S 
+    TOTAL LIABILITY ON ALL CLAIMS RELATED TO THE SOFTWARE WILL NOT 
+    EXCEED AMOUNT OF FEES, IF ANY, YOU PAID DIRECTLY TO MICROCHIP FOR 
+    THIS SOFTWARE.
+*/
+
+#ifndef I2C_CORE_H
+#define	I2C_CORE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//Project settings - role selection, pins and pull-ups
+#include "i2c_config.h"
+    
+#ifndef I2C_ROLE_HOST
+#define I2C_ROLE_HOST 0
+#endif
+    
+#ifndef I2C_ROLE_CLIENT
+#define I2C_ROLE_CLIENT 0
+#endif
+    
+#if (!I2C_ROLE_HOST) && (!I2C_ROLE_CLIENT)
+#error "Select I2C_ROLE_HOST and/or I2C_ROLE_CLIENT in i2c_config.h"
+#endif
+    
+//Reserved address used for General Call (broadcast) writes
+#define I2C_GENERAL_CALL_ADDR 0x00
+    
+//Default pins are RC3 (SCL) and RC4 (SDA)
+#ifndef I2C_SCL_PORT
+#define I2C_SCL_PORT C
+#define I2C_SCL_PIN 3
+#endif
+    
+#ifndef I2C_SDA_PORT
+#define I2C_SDA_PORT C
+#define I2C_SDA_PIN 4
+#endif
+    
+//Token pasting helpers used to build register names from the pin settings
+#define I2C_CAT_(a, b) a##b
+#define I2C_CAT(a, b) I2C_CAT_(a, b)
+#define I2C_CAT3(a, b, c) I2C_CAT(I2C_CAT(a, b), c)
+#define I2C_CAT4(a, b, c, d) I2C_CAT(I2C_CAT3(a, b, c), d)
+    
+//Port numbers used by the PPS input selection
+#define I2C_PORT_NUM_A 0
+#define I2C_PORT_NUM_B 1
+#define I2C_PORT_NUM_C 2
+#define I2C_PORT_NUM_D 3
+#define I2C_PORT_NUM_E 4
+#define I2C_PORT_NUM_F 5
+    
+//PPS input selection value for a pin, e.g. RC3 -> 0b010011
+#define I2C_PPS_IN(port, pin) ((I2C_CAT(I2C_PORT_NUM_, port) << 3) | (pin))
+    
+//PPS output selection values for I2C1
+#define I2C_PPS_OUT_SCL 0x20
+#define I2C_PPS_OUT_SDA 0x21
+    
+//Register bits for a pin, e.g. I2C_PIN_ANSEL(C, 3) -> ANSELCbits.ANSELC3
+#define I2C_PIN_ANSEL(port, pin) I2C_CAT3(ANSEL, port, bits).I2C_CAT3(ANSEL, port, pin)
+#define I2C_PIN_ODCON(port, pin) I2C_CAT3(ODCON, port, bits).I2C_CAT3(ODC, port, pin)
+#define I2C_PIN_TRIS(port, pin) I2C_CAT3(TRIS, port, bits).I2C_CAT3(TRIS, port, pin)
+#define I2C_PIN_PPS(port, pin) I2C_CAT4(R, port, pin, PPS)
+#define I2C_PIN_PAD(port, pin) I2C_CAT4(R, port, pin, I2Cbits)
+    
+    //Options for Bus Time Out (BTO) Clock Sources
+    typedef enum {
+        I2C_BTO_TMR2 = 0b0001, I2C_BTO_TMR4, 
+        I2C_TU16A, I2C_TU16B_OUT, I2C_BTO_LFINTOSC, 
+        I2C_BTO_MFINTOSC, I2C_BTO_SOSC
+    } I2C_BTO_Clock;
+    
+    //Initialize the bus timeout feature
+    //Reset - enables whether the I2C module should reset on a timeout
+    //Prescale - enables a 32x clock divider for the timeout
+    //Timeout - the number of clock cycles before a timeout. Must be less than 64
+    //Clock - Select the clock source used
+    void I2C_initBTO(bool reset, bool prescale, uint8_t timeout, I2C_BTO_Clock clock);
+    
+    //Initializes the I/O pins for I2C
+    //Pins are selected with I2C_SCL_PORT/PIN and I2C_SDA_PORT/PIN in i2c_config.h
+    void I2C_initPins(void);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_CORE_H */
+
@@ -0,0 +1,96 @@
+#include "eeprom.h"
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//NVMCON1 commands
+#define EEPROM_CMD_READ     0b000
+#define EEPROM_CMD_WRITE    0b011
+
+//Loads the NVM address of the data EEPROM byte at OFFSET
+static void EEPROM_setAddress(uint16_t offset)
+{
+    uint32_t addr = EEPROM_BASE_ADDR + offset;
+    
+    NVMADRU = (uint8_t) (addr >> 16);
+    NVMADRH = (uint8_t) (addr >> 8);
+    NVMADRL = (uint8_t) addr;
+}
+
+//Returns the data EEPROM byte at OFFSET
+//Waits for a write in progress to finish first
+uint8_t EEPROM_read(uint16_t offset)
+{
+    while (NVMCON0bits.GO);
+    
+    EEPROM_setAddress(offset);
+    
+    //Read is complete when GO clears
+    NVMCON1bits.CMD = EEPROM_CMD_READ;
+    NVMCON0bits.GO = 1;
+    while (NVMCON0bits.GO);
+    
+    return NVMDATL;
+}
+
+//Starts writing DATA to the data EEPROM byte at OFFSET and returns without waiting
+//Interrupts are disabled for the unlock sequence only. Do not call from an ISR
+void EEPROM_startWrite(uint16_t offset, uint8_t data)
+{
+    while (NVMCON0bits.GO);
+    
+    EEPROM_setAddress(offset);
+    NVMDATL = data;
+    NVMCON1bits.CMD = EEPROM_CMD_WRITE;
+    
+    //The unlock sequence must not be interrupted
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    NVMLOCK = 0x55;
+    NVMLOCK = 0xAA;
+    NVMCON0bits.GO = 1;
+    
+    INTCON0bits.GIE = enabled;
+}
+
+//Returns true while a write is in progress
+bool EEPROM_isBusy(void)
+{
+    if (NVMCON0bits.GO)
+    {
+        return true;
+    }
+    
+    //Write finished - return to reads, so a stray GO cannot write
+    NVMCON1bits.CMD = EEPROM_CMD_READ;
+    return false;
+}
+
+//Sleeps until the write in progress finishes
+void EEPROM_sleepUntilDone(void)
+{
+    //Interrupts off, so NVMIF wakes the CPU without vectoring
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    PIR0bits.NVMIF = 0;
+    PIE0bits.NVMIE = 1;
+    
+    //Checked after the flag is cleared, so the end of the write cannot be missed
+    if (NVMCON0bits.GO)
+    {
+        //Full Sleep - the write continues, and completes from its own timer
+        CPUDOZEbits.IDLEN = 0;
+        SLEEP();
+        NOP();
+    }
+    
+    PIE0bits.NVMIE = 0;
+    PIR0bits.NVMIF = 0;
+    
+    //Interrupts that ended the Sleep are serviced here
+    INTCON0bits.GIE = enabled;
+}
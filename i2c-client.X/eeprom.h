@@ -0,0 +1,37 @@
+#ifndef EEPROM_H
+#define	EEPROM_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//Start of Data Flash Memory (data EEPROM) in the NVM address space
+#define EEPROM_BASE_ADDR 0x380000
+    
+//Size of the data EEPROM, in bytes
+#define EEPROM_SIZE 512
+    
+    //Returns the data EEPROM byte at OFFSET
+    //Waits for a write in progress to finish first
+    uint8_t EEPROM_read(uint16_t offset);
+    
+    //Starts writing DATA to the data EEPROM byte at OFFSET and returns without waiting
+    //Interrupts are disabled for the unlock sequence only. Do not call from an ISR
+    void EEPROM_startWrite(uint16_t offset, uint8_t data);
+    
+    //Returns true while a write is in progress
+    bool EEPROM_isBusy(void);
+    
+    //Sleeps until the write in progress finishes. Other enabled interrupts also end the Sleep
+    //Returns at once if no write is in progress. Do not call from an ISR
+    void EEPROM_sleepUntilDone(void);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* EEPROM_H */
+
@@ -4,7 +4,6 @@
 #include <stdbool.h>
 
 static volatile bool isFirst = true;
-static volatile bool wasRead = false;
 
 static volatile uint8_t i2c_index = 0;
 
@@ -14,14 +13,208 @@ static volatile uint8_t writeBufferSize = 0;
 static volatile uint8_t* readBuffer = 0;
 static volatile uint8_t readBufferSize = 0;
 
-void I2C_BlockData_StoreByte(uint8_t data)
+static volatile uint8_t* gcBuffer = 0;
+static volatile uint8_t gcBufferSize = 0;
+
+//Streaming FIFO register (see I2C_BlockData_setupFifo)
+static volatile uint8_t* fifoStorage = 0;
+static uint8_t fifoSize = 0;
+static uint8_t fifoReg = 0;
+
+//HEAD is only written by the producer, TAIL only at STOP
+static volatile uint8_t fifoHead = 0;
+static volatile uint8_t fifoTail = 0;
+
+//Entries requested in this transaction, and entries present at its 1st FIFO access
+static volatile uint8_t fifoPeek = 0;
+static volatile uint8_t fifoAvail = 0;
+static volatile bool fifoSnapshot = false;
+
+//Set while the FIFO or fill level register is selected by the register address
+static volatile bool fifoSelected = false;
+
+//Returns the number of entries in the FIFO
+static uint8_t I2C_BlockData_fifoCount(void)
+{
+    uint8_t head = fifoHead;
+    uint8_t tail = fifoTail;
+    
+    if (head >= tail)
+    {
+        return head - tail;
+    }
+    return (uint8_t) (head + fifoSize - tail);
+}
+
+//Returns true if the index is on the FIFO or fill level register
+static bool I2C_BlockData_atFifo(void)
+{
+    if (fifoStorage == 0)
+    {
+        return false;
+    }
+    
+    return ((i2c_index == fifoReg) || ((fifoReg != 0) && (i2c_index == (uint8_t) (fifoReg - 1))));
+}
+
+//Returns the fill level or the next FIFO entry, without removing it
+static uint8_t I2C_BlockData_RequestFifoByte(void)
+{
+    //Only entries present at the 1st access are sent in this transaction
+    if (!fifoSnapshot)
+    {
+        fifoAvail = I2C_BlockData_fifoCount();
+        fifoSnapshot = true;
+    }
+    
+    if (i2c_index != fifoReg)
+    {
+        //Fill level register - the next byte comes from the FIFO
+        i2c_index++;
+        return (fifoAvail > fifoPeek) ? (fifoAvail - fifoPeek) : 0x00;
+    }
+    
+    uint8_t data = 0x00;
+    
+    if (fifoPeek < fifoAvail)
+    {
+        uint16_t pos = (uint16_t) fifoTail + fifoPeek;
+        if (pos >= fifoSize)
+        {
+            pos -= fifoSize;
+        }
+        data = fifoStorage[pos];
+    }
+    
+    //The index stays on the FIFO register. Entries are removed at STOP
+    if (fifoPeek < 0xFF)
+    {
+        fifoPeek++;
+    }
+    
+    return data;
+}
+
+#ifdef BLOCKDATA_MAILBOX
+#include "i2c_mailbox.h"
+
+//Set while MAILBOX_COMMAND_REG is selected - writes are commands, reads return the response
+static volatile bool mailboxSelected = false;
+#endif
+
+#ifdef BLOCKDATA_CHANGE_MAP
+#include <xc.h>
+
+//Changed read buffer bytes, 1 bit each
+static volatile uint8_t changeMap[BLOCKDATA_CHANGE_MAP_SIZE];
+
+//Map bytes requested in this transaction, the index of the 1st one and the index after the last one sent
+static volatile uint8_t changeSent[BLOCKDATA_CHANGE_MAP_SIZE];
+static volatile uint8_t changeStart = 0;
+static volatile uint8_t changeEnd = 0;
+static volatile bool changeRead = false;
+
+//Set while the change map is selected by the register address
+static volatile bool changeSelected = false;
+
+//Returns true if the index is on the change map register
+static bool I2C_BlockData_atChangeMap(void)
+{
+    return ((i2c_index >= BLOCKDATA_CHANGE_REG) 
+            && (i2c_index < (uint8_t) (BLOCKDATA_CHANGE_REG + BLOCKDATA_CHANGE_MAP_SIZE)));
+}
+#endif
+
+//Records whether the index was set to the FIFO or the change map.
+//Reads that run into them from another register do not take entries or clear bits
+static void I2C_BlockData_select(void)
+{
+    fifoSelected = I2C_BlockData_atFifo();
+#ifdef BLOCKDATA_CHANGE_MAP
+    changeSelected = I2C_BlockData_atChangeMap();
+#endif
+}
+
+//Returns 0x00 for a byte that is not read from its register, and moves to the next one
+static uint8_t I2C_BlockData_skipByte(void)
+{
+    if (i2c_index < 0xFF)
+    {
+        i2c_index++;
+    }
+    return 0x00;
+}
+
+#ifdef BLOCKDATA_PERSIST
+#include <xc.h>
+
+#include "eeprom.h"
+
+//Stored after the image once it has been saved in full
+#define BLOCKDATA_PERSIST_MARKER 0xA5
+#define BLOCKDATA_PERSIST_MARKER_ADDR (BLOCKDATA_PERSIST_OFFSET + BLOCKDATA_PERSIST_SIZE)
+
+//Part of the write buffer that is persisted
+static uint8_t persistStart = 0;
+static uint8_t persistLen = 0;
+
+//Range of the write buffer changed in this transaction (first > last if none)
+static volatile uint8_t writeFirst = 0xFF;
+static volatile uint8_t writeLast = 0x00;
+
+//Range changed in completed transactions, since the last flush
+static volatile uint8_t dirtyFirst = 0xFF;
+static volatile uint8_t dirtyLast = 0x00;
+
+//Persisted bytes waiting for the EEPROM (main loop only)
+static uint8_t dirtyMap[(BLOCKDATA_PERSIST_SIZE + 7) / 8];
+static uint8_t dirtyCount = 0;
+static uint8_t flushIndex = 0;
+static bool markerValid = false;
+
+//Records a byte stored at the current index
+static void I2C_BlockData_trackWrite(volatile uint8_t* buffer)
+{
+    if (buffer != writeBuffer)
+    {
+        return;
+    }
+    
+    if (i2c_index < writeFirst)
+    {
+        writeFirst = i2c_index;
+    }
+    if (i2c_index > writeLast)
+    {
+        writeLast = i2c_index;
+    }
+}
+
+//Marks persisted byte INDEX as waiting for the EEPROM
+static void I2C_BlockData_markDirty(uint8_t index)
+{
+    uint8_t mask = (uint8_t) (1 << (index & 0x07));
+    
+    if (!(dirtyMap[index >> 3] & mask))
+    {
+        dirtyMap[index >> 3] |= mask;
+        dirtyCount++;
+    }
+}
+#endif
+
+//Stores DATA into BUFFER, using the shared transfer index
+static void I2C_BlockData_StoreInto(volatile uint8_t* buffer, uint8_t size, uint8_t data)
 {
 #ifdef FIRST_BYTE_ADDR                                                          // If set, treat the 1st byte as an index
     if (!isFirst)
     {
-        if (i2c_index < writeBufferSize)
+        if (i2c_index < size)
         {
-            writeBuffer[i2c_index] = data;
+            buffer[i2c_index] = data;
+#ifdef BLOCKDATA_PERSIST
+            I2C_BlockData_trackWrite(buffer);
+#endif
             i2c_index++;
         }
     }
@@ -29,48 +222,233 @@ void I2C_BlockData_StoreByte(uint8_t data)
     {
         isFirst = false;
         i2c_index = data;
+        I2C_BlockData_select();
+#ifdef BLOCKDATA_MAILBOX
+        mailboxSelected = false;
+#endif
     }
 #else
-    if (i2c_index < writeBufferSize)
+    if (i2c_index < size)
     {
-        writeBuffer[i2c_index] = data;
+        buffer[i2c_index] = data;
+#ifdef BLOCKDATA_PERSIST
+        I2C_BlockData_trackWrite(buffer);
+#endif
         i2c_index++;
     }
 #endif
 }
 
+void I2C_BlockData_StoreByte(uint8_t data)
+{
+#ifdef BLOCKDATA_MAILBOX
+    if ((mailboxSelected) && (!isFirst))
+    {
+        //Command and arguments - a Repeated Start read then returns the response
+        Mailbox_receiveByte(data);
+        return;
+    }
+    
+    if ((isFirst) && (data == MAILBOX_COMMAND_REG))
+    {
+        //The read and write buffers are not changed - the response has its own buffer
+        isFirst = false;
+        mailboxSelected = true;
+        Mailbox_select();
+        return;
+    }
+#endif
+    
+    I2C_BlockData_StoreInto(writeBuffer, writeBufferSize, data);
+}
+
+void I2C_BlockData_StoreGeneralCallByte(uint8_t data)
+{
+    I2C_BlockData_StoreInto(gcBuffer, gcBufferSize, data);
+}
+
 uint8_t I2C_BlockData_RequestByte(void)
 {
-    wasRead = true;
+#ifdef BLOCKDATA_MAILBOX
+    if (mailboxSelected)
+    {
+        return Mailbox_requestByte();
+    }
+#endif
+    
+    if (I2C_BlockData_atFifo())
+    {
+        //Entries are only read by a transaction that selected the FIFO, not by an over-long read
+        if (!fifoSelected)
+        {
+            return I2C_BlockData_skipByte();
+        }
+        return I2C_BlockData_RequestFifoByte();
+    }
+    
+#ifdef BLOCKDATA_CHANGE_MAP
+    if (I2C_BlockData_atChangeMap())
+    {
+        if (!changeSelected)
+        {
+            return I2C_BlockData_skipByte();
+        }
+        
+        //Bits are only cleared at STOP, once the bytes actually sent are known
+        uint8_t map = changeMap[i2c_index - BLOCKDATA_CHANGE_REG];
+        changeSent[i2c_index - BLOCKDATA_CHANGE_REG] = map;
+        
+        if ((!changeRead) || (i2c_index < changeStart))
+        {
+            changeStart = i2c_index;
+        }
+        changeRead = true;
+        
+        i2c_index++;
+        changeEnd = i2c_index;
+        return map;
+    }
+#endif
+    
     uint8_t data = 0x00;
     if (i2c_index < readBufferSize)
     {
         data = readBuffer[i2c_index];
-        i2c_index++;
     }
-    else
-    {        
-        //This line is to correct for the extra byte loaded, but not sent when stopped.
-        i2c_index = readBufferSize + 1;
+    
+    //Keep counting past the end, so unsent bytes can be returned exactly
+    if (i2c_index < 0xFF)
+    {
+        i2c_index++;
     }
     return data;
 }
 
-void I2C_BlockData_onStop(void)
+void I2C_BlockData_UnreadBytes(uint8_t count)
 {
+#ifdef BLOCKDATA_MAILBOX
+    //Response reads do not move the index, and restart at STOP
+    if (mailboxSelected)
+    {
+        return;
+    }
+#endif
+    
+    //Bytes requested on the FIFO register did not move the index
+    if ((fifoStorage != 0) && (i2c_index == fifoReg))
+    {
+        uint8_t fifoCount = (count > fifoPeek) ? fifoPeek : count;
+        fifoPeek -= fifoCount;
+        count -= fifoCount;
+    }
+    
+    //Rewind over bytes that were requested, but not sent to the host
+    if (count > i2c_index)
+    {
+        count = i2c_index;
+    }
+    i2c_index -= count;
+    
+#ifdef BLOCKDATA_CHANGE_MAP
+    //Map bytes that were not sent keep their bits
+    if ((changeRead) && (i2c_index < changeEnd))
+    {
+        changeEnd = i2c_index;
+    }
+#endif
+}
+
+bool I2C_BlockData_WriteReady(void)
+{
+#ifdef BLOCKDATA_MAILBOX
+    //Command bytes are not stored in the write buffer
+    if (mailboxSelected)
+    {
+        return true;
+    }
+#endif
+    
 #ifdef FIRST_BYTE_ADDR
-    if ((wasRead) && (i2c_index != 0))
+    //The 1st byte is the index, not data
+    if (isFirst)
     {
-        // If reading bytes, an extra byte is loaded but not sent when stopped.
-        i2c_index--;
+        return true;
     }
-#else
+#endif
+    
+    return (i2c_index < writeBufferSize);
+}
+
+void I2C_BlockData_onStop(void)
+{
+#ifndef FIRST_BYTE_ADDR
     //Reset the index
     i2c_index = 0;
+    I2C_BlockData_select();
 #endif
     
     isFirst = true;
-    wasRead = false;
+    
+#ifdef BLOCKDATA_MAILBOX
+    //The register stays selected, so the next read returns the response from its start
+    Mailbox_rewind();
+#endif
+    
+#ifdef BLOCKDATA_CHANGE_MAP
+    //Clear the bits the host received, in the map bytes sent in this transaction only.
+    //Bits set after the map was sent stay set
+    if (changeRead)
+    {
+        for (uint8_t i = changeStart - BLOCKDATA_CHANGE_REG; i < BLOCKDATA_CHANGE_MAP_SIZE; i++)
+        {
+            if ((uint8_t) (BLOCKDATA_CHANGE_REG + i) >= changeEnd)
+            {
+                break;
+            }
+            changeMap[i] &= (uint8_t) ~changeSent[i];
+        }
+        
+        //The next read takes a new snapshot of each byte it sends
+        for (uint8_t i = 0; i < BLOCKDATA_CHANGE_MAP_SIZE; i++)
+        {
+            changeSent[i] = 0x00;
+        }
+        
+        changeRead = false;
+        changeStart = 0;
+        changeEnd = 0;
+    }
+#endif
+    
+    //Remove the FIFO entries the host received
+    if (fifoSnapshot)
+    {
+        uint8_t used = (fifoPeek < fifoAvail) ? fifoPeek : fifoAvail;
+        uint16_t tail = (uint16_t) fifoTail + used;
+        if (tail >= fifoSize)
+        {
+            tail -= fifoSize;
+        }
+        
+        fifoTail = (uint8_t) tail;
+        fifoPeek = 0;
+        fifoSnapshot = false;
+    }
+    
+#ifdef BLOCKDATA_PERSIST
+    //Transaction complete - its bytes can now be saved together
+    if (writeFirst < dirtyFirst)
+    {
+        dirtyFirst = writeFirst;
+    }
+    if ((writeFirst <= writeLast) && (writeLast > dirtyLast))
+    {
+        dirtyLast = writeLast;
+    }
+    
+    writeFirst = 0xFF;
+    writeLast = 0x00;
+#endif
 }
 
 void I2C_BlockData_setupReadBuffer(volatile uint8_t* buffer, uint8_t size)
@@ -84,3 +462,196 @@ void I2C_BlockData_setupWriteBuffer(volatile uint8_t* buffer, uint8_t size)
     writeBuffer = buffer;
     writeBufferSize = size;
 }
+
+void I2C_BlockData_setupGeneralCallBuffer(volatile uint8_t* buffer, uint8_t size)
+{
+    gcBuffer = buffer;
+    gcBufferSize = size;
+}
+
+void I2C_BlockData_setupFifo(uint8_t reg, volatile uint8_t* storage, uint8_t size)
+{
+    fifoStorage = 0;
+    
+    fifoReg = reg;
+    fifoSize = size;
+    fifoHead = 0;
+    fifoTail = 0;
+    fifoPeek = 0;
+    fifoSnapshot = false;
+    
+    //At least 2 slots - 1 is always left empty
+    if (size >= 2)
+    {
+        fifoStorage = storage;
+    }
+    
+    I2C_BlockData_select();
+}
+
+bool I2C_BlockData_pushFifo(uint8_t data)
+{
+    if (fifoStorage == 0)
+    {
+        return false;
+    }
+    
+    uint8_t head = fifoHead;
+    uint8_t next = head + 1;
+    if (next >= fifoSize)
+    {
+        next = 0;
+    }
+    
+    if (next == fifoTail)
+    {
+        //Full
+        return false;
+    }
+    
+    //Store the entry, then publish it by advancing HEAD
+    fifoStorage[head] = data;
+    fifoHead = next;
+    return true;
+}
+
+uint8_t I2C_BlockData_getFifoLevel(void)
+{
+    return I2C_BlockData_fifoCount();
+}
+
+#ifdef BLOCKDATA_CHANGE_MAP
+bool I2C_BlockData_writeRegister(uint8_t index, uint8_t value)
+{
+    if ((index >= readBufferSize) || (index >= (BLOCKDATA_CHANGE_MAP_SIZE * 8)))
+    {
+        return false;
+    }
+    
+    //The value and its bit must change together for the ISR
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    if (readBuffer[index] != value)
+    {
+        readBuffer[index] = value;
+        changeMap[index >> 3] |= (uint8_t) (1 << (index & 0x07));
+    }
+    
+    INTCON0bits.GIE = enabled;
+    
+    return true;
+}
+#endif
+
+#ifdef BLOCKDATA_PERSIST
+void I2C_BlockData_setupPersistRange(uint8_t start, uint8_t len)
+{
+    if (start > writeBufferSize)
+    {
+        start = writeBufferSize;
+    }
+    if (len > (uint8_t) (writeBufferSize - start))
+    {
+        len = writeBufferSize - start;
+    }
+    if (len > BLOCKDATA_PERSIST_SIZE)
+    {
+        len = BLOCKDATA_PERSIST_SIZE;
+    }
+    
+    persistStart = start;
+    persistLen = len;
+}
+
+bool I2C_BlockData_restore(void)
+{
+    if (EEPROM_read(BLOCKDATA_PERSIST_MARKER_ADDR) != BLOCKDATA_PERSIST_MARKER)
+    {
+        //No image yet - save the whole range, then the marker
+        markerValid = false;
+        for (uint8_t i = 0; i < persistLen; i++)
+        {
+            I2C_BlockData_markDirty(i);
+        }
+        return false;
+    }
+    
+    markerValid = true;
+    for (uint8_t i = 0; i < persistLen; i++)
+    {
+        writeBuffer[persistStart + i] = EEPROM_read(BLOCKDATA_PERSIST_OFFSET + i);
+    }
+    return true;
+}
+
+bool I2C_BlockData_flush(void)
+{
+    //One write at a time, without waiting
+    if (EEPROM_isBusy())
+    {
+        return true;
+    }
+    
+    //Take the range recorded at STOP
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    uint8_t first = dirtyFirst;
+    uint8_t last = dirtyLast;
+    dirtyFirst = 0xFF;
+    dirtyLast = 0x00;
+    
+    INTCON0bits.GIE = enabled;
+    
+    //Mark the persisted part of the range
+    if (first < persistStart)
+    {
+        first = persistStart;
+    }
+    for (uint8_t i = first; (i <= last) && (i < (uint8_t) (persistStart + persistLen)); i++)
+    {
+        I2C_BlockData_markDirty(i - persistStart);
+    }
+    
+    //Write the next byte that differs from the EEPROM
+    while (flushIndex < persistLen)
+    {
+        uint8_t index = flushIndex;
+        uint8_t mask = (uint8_t) (1 << (index & 0x07));
+        flushIndex++;
+        
+        if (dirtyMap[index >> 3] & mask)
+        {
+            dirtyMap[index >> 3] &= ~mask;
+            dirtyCount--;
+            
+            uint8_t value = writeBuffer[persistStart + index];
+            
+            //Matching bytes are not rewritten, to save wear
+            if (EEPROM_read(BLOCKDATA_PERSIST_OFFSET + index) != value)
+            {
+                EEPROM_startWrite(BLOCKDATA_PERSIST_OFFSET + index, value);
+                return true;
+            }
+        }
+    }
+    
+    //End of the range - bytes marked behind the cursor are written on the next pass
+    flushIndex = 0;
+    if (dirtyCount != 0)
+    {
+        return true;
+    }
+    
+    //Image saved in full - mark it valid
+    if (!markerValid)
+    {
+        EEPROM_startWrite(BLOCKDATA_PERSIST_MARKER_ADDR, BLOCKDATA_PERSIST_MARKER);
+        markerValid = true;
+        return true;
+    }
+    
+    return false;
+}
+#endif
@@ -35,6 +35,43 @@ extern "C" {
  */
 #define FIRST_BYTE_ADDR
     
+/*
+ * If defined, part of the write buffer is mirrored into the data EEPROM (requires eeprom.c).
+ * Bytes written by the host are recorded at STOP, and written to the EEPROM from the 
+ * main loop by I2C_BlockData_flush. No EEPROM writes occur in the ISR.
+ */
+//#define BLOCKDATA_PERSIST
+    
+//Largest number of persisted bytes, and the location of the image in the data EEPROM
+#define BLOCKDATA_PERSIST_SIZE 16
+#define BLOCKDATA_PERSIST_OFFSET 0x0000
+    
+/*
+ * If defined, writes to MAILBOX_COMMAND_REG are commands (requires i2c_mailbox.c).
+ * Commands are dispatched through the table in mailbox_commands.h when the last argument
+ * byte arrives. Reads of MAILBOX_COMMAND_REG return the response from its own buffer.
+ */
+//#define BLOCKDATA_MAILBOX
+    
+#if defined(BLOCKDATA_MAILBOX) && !defined(FIRST_BYTE_ADDR)
+#error "BLOCKDATA_MAILBOX requires FIRST_BYTE_ADDR"
+#endif
+    
+/*
+ * If defined, writes through I2C_BlockData_writeRegister set a bit in a change map, 
+ * one bit per read buffer byte. The map is read at BLOCKDATA_CHANGE_REG, and the bits 
+ * sent to the host are cleared at STOP (read-to-clear).
+ */
+//#define BLOCKDATA_CHANGE_MAP
+    
+//Index of the change map register, and its size in bytes (8 read buffer bytes per map byte)
+#define BLOCKDATA_CHANGE_REG 0x90
+#define BLOCKDATA_CHANGE_MAP_SIZE 2
+    
+#if defined(BLOCKDATA_CHANGE_MAP) && !defined(FIRST_BYTE_ADDR)
+#error "BLOCKDATA_CHANGE_MAP requires FIRST_BYTE_ADDR"
+#endif
+    
     /**
      * <b><FONT COLOR=BLUE>void</FONT> _I2C_BlockData_StoreByte(<FONT COLOR=BLUE>uint8_t</FONT> data)</B>
      * @param uint8_t data - Byte of data received by the I2C module
@@ -44,6 +81,15 @@ extern "C" {
      */
     void I2C_BlockData_StoreByte(uint8_t data);
     
+    /**
+     * <b><FONT COLOR=BLUE>void</FONT> I2C_BlockData_StoreGeneralCallByte(<FONT COLOR=BLUE>uint8_t</FONT> data)</B>
+     * @param uint8_t data - Byte of data received on the General Call address
+     * 
+     * This function stores a byte of broadcast data into the General Call buffer.
+     * Indexing follows the same rules as I2C_BlockData_StoreByte.
+     */
+    void I2C_BlockData_StoreGeneralCallByte(uint8_t data);
+    
     /**
      * <b><FONT COLOR=BLUE>uint8_t</FONT> _I2C_BlockData_RequestByte(<FONT COLOR=BLUE>void</FONT>)</B>
      * 
@@ -52,6 +98,23 @@ extern "C" {
      */
     uint8_t I2C_BlockData_RequestByte(void);
     
+    /**
+     * <b><FONT COLOR=BLUE>void</FONT> I2C_BlockData_UnreadBytes(<FONT COLOR=BLUE>uint8_t</FONT> count)</B>
+     * @param uint8_t count - Number of bytes requested, but not sent
+     * 
+     * This function moves the internal index back over bytes that were requested by the driver,
+     * but never sent to the host (the byte loaded at STOP, or a prefetched byte).
+     */
+    void I2C_BlockData_UnreadBytes(uint8_t count);
+    
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> I2C_BlockData_WriteReady(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * This function returns false if the next byte received would not fit in the write buffer.
+     * The example Write Ready Handler NACKs the byte when this returns false, rather than discarding it.
+     */
+    bool I2C_BlockData_WriteReady(void);
+    
     /**
      * <b><FONT COLOR=BLUE>void</FONT> _I2C_BlockData_onStop(<FONT COLOR=BLUE>void</FONT>)</B>
      * 
@@ -78,6 +141,88 @@ extern "C" {
      */
     void I2C_BlockData_setupWriteBuffer(volatile uint8_t* buffer, uint8_t size);
     
+    /**
+     * <b><FONT COLOR=BLUE>void</FONT> I2C_BlockData_setupGeneralCallBuffer(<FONT COLOR=BLUE>uint8_t*</FONT> buffer, <FONT COLOR=BLUE>uint8_t</FONT> size)</B>
+     * @param buffer (uint8_t*) - Buffer to write broadcast data to
+     * @param size (uint8_t) - Length of the buffer.
+     * 
+     * Assigns the buffer of memory to write General Call data to.
+     */
+    void I2C_BlockData_setupGeneralCallBuffer(volatile uint8_t* buffer, uint8_t size);
+    
+    /**
+     * <b><FONT COLOR=BLUE>void</FONT> I2C_BlockData_setupFifo(<FONT COLOR=BLUE>uint8_t</FONT> reg, <FONT COLOR=BLUE>uint8_t*</FONT> storage, <FONT COLOR=BLUE>uint8_t</FONT> size)</B>
+     * @param reg (uint8_t) - Index of the FIFO register. The fill level is read at REG - 1
+     * @param storage (uint8_t*) - Memory for the FIFO entries
+     * @param size (uint8_t) - Size of STORAGE. The FIFO holds up to SIZE - 1 entries
+     * 
+     * Assigns a streaming FIFO register. Reads of REG return successive FIFO entries
+     * without advancing the index, so one read can drain many entries. Entries are 
+     * only removed at STOP, once the number of bytes sent to the host is known.
+     * Only reads that start at REG or REG - 1 access the FIFO. A read that runs into 
+     * them from a lower register gets 0x00.
+     */
+    void I2C_BlockData_setupFifo(uint8_t reg, volatile uint8_t* storage, uint8_t size);
+    
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> I2C_BlockData_pushFifo(<FONT COLOR=BLUE>uint8_t</FONT> data)</B>
+     * @param data (uint8_t) - Entry to add
+     * 
+     * Adds an entry to the FIFO register. Call from one producer only (main loop or an ISR).
+     * Returns false if the FIFO is full.
+     */
+    bool I2C_BlockData_pushFifo(uint8_t data);
+    
+    /**
+     * <b><FONT COLOR=BLUE>uint8_t</FONT> I2C_BlockData_getFifoLevel(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * Returns the number of entries in the FIFO register.
+     */
+    uint8_t I2C_BlockData_getFifoLevel(void);
+    
+#ifdef BLOCKDATA_PERSIST
+    /**
+     * <b><FONT COLOR=BLUE>void</FONT> I2C_BlockData_setupPersistRange(<FONT COLOR=BLUE>uint8_t</FONT> start, <FONT COLOR=BLUE>uint8_t</FONT> len)</B>
+     * @param start (uint8_t) - Index of the 1st persisted byte in the write buffer
+     * @param len (uint8_t) - Number of persisted bytes, up to BLOCKDATA_PERSIST_SIZE
+     * 
+     * Selects the part of the write buffer mirrored into the data EEPROM.
+     * Call after I2C_BlockData_setupWriteBuffer.
+     */
+    void I2C_BlockData_setupPersistRange(uint8_t start, uint8_t len);
+    
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> I2C_BlockData_restore(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * Copies the saved image from the data EEPROM into the write buffer. Call before I2C_initClient.
+     * Returns false if no image has been saved. The buffer then keeps its initial values, 
+     * and these are saved by the following flushes.
+     */
+    bool I2C_BlockData_restore(void);
+    
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> I2C_BlockData_flush(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * Writes at most one changed byte to the data EEPROM and returns without waiting.
+     * Bytes that already match the EEPROM are skipped, and repeated writes to a byte 
+     * before the flush cost one EEPROM write. Call from the main loop.
+     * Returns true while bytes are waiting to be written.
+     */
+    bool I2C_BlockData_flush(void);
+#endif
+    
+#ifdef BLOCKDATA_CHANGE_MAP
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> I2C_BlockData_writeRegister(<FONT COLOR=BLUE>uint8_t</FONT> index, <FONT COLOR=BLUE>uint8_t</FONT> value)</B>
+     * @param index (uint8_t) - Index in the read buffer
+     * @param value (uint8_t) - New value
+     * 
+     * Writes VALUE to the read buffer, and marks the byte as changed if the value is different.
+     * Returns false if INDEX is outside the read buffer or the change map.
+     */
+    bool I2C_BlockData_writeRegister(uint8_t index, uint8_t value);
+#endif
+    
 #ifdef	__cplusplus
 }
 #endif
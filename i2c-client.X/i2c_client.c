@@ -5,10 +5,60 @@
 
 #include "i2c_client.h"
 #include "interrupts.h"
+#include "timebase.h"
+
+//Only built into firmware that uses this role (see i2c_config.h)
+#if I2C_ROLE_CLIENT
 
 static void (*rxCallback)(uint8_t) = 0;
 static uint8_t (*txCallback)(void) = 0;
 static void (*stopCallback)(void) = 0;
+static void (*gcCallback)(uint8_t) = 0;
+
+//Set by the STOP handler, cleared by the application
+static volatile bool transactionDone = false;
+
+//Longest ISR entry to SCL release after an address match
+//ISR time only - TMR1 stops in Sleep, so the wake-up before the ISR is not included
+static volatile uint16_t worstAddressStretch = 0;
+
+static void (*addressCallback)(uint8_t, bool, I2C_ClientBuffer*) = 0;
+static void (*completeCallback)(bool, uint8_t, I2C_ClientStatus) = 0;
+static void (*unreadCallback)(uint8_t) = 0;
+
+//Read handler calls in this segment, and the byte staged for the next TXIF
+static volatile uint8_t txCalls = 0;
+static volatile uint8_t txNext = 0x00;
+static volatile bool txNextValid = false;
+
+//Longest TX ISR entry to I2C1TXB write
+static volatile uint16_t worstTxStretch = 0;
+
+#ifdef I2C_CLIENT_BACKPRESSURE
+static I2C_ClientWriteReady (*writeReadyCallback)(void) = 0;
+
+//A received byte is held before its ACK while the destination is full
+static volatile bool rxPaused = false;
+
+//Set after a NACK - bytes are NACKed and dropped until the next START or STOP
+static volatile bool rxDiscard = false;
+
+static volatile uint16_t stretchTimeouts = 0;
+#endif
+
+#ifdef I2C_CLIENT_ISR_STATS
+//Time spent in the I2C ISRs, and STOPs seen
+static volatile uint32_t isrTicks = 0;
+static volatile uint32_t isrTransactions = 0;
+#endif
+
+//State of the current transaction segment (START or Repeated Start to the next)
+static volatile bool xferActive = false;
+static volatile bool xferRead = false;
+static volatile uint8_t* volatile xferBuffer = 0;
+static volatile uint8_t xferSize = 0;
+static volatile uint8_t xferIndex = 0;
+static volatile uint8_t segmentStartCount = 0xFF;
 
 //Initializes the I2C Module in Client Mode
 //I/O is configured seperately
@@ -23,12 +73,19 @@ void I2C_initClient(uint8_t address)
     //Set to Standard Mode
     I2C1CON3 = 0x00;
     
+#ifdef I2C_ENABLE_GENERAL_CALL
+    //ACK the General Call address in addition to the Client Address
+    I2C1CON2bits.GCEN = 1;
+#endif
+    
     //Enable STOP Interrupts
     I2C1PIE = 0x00;
     I2C1PIEbits.PC1IE = 1;
     
-    //Enable Address Match Interrupts
-//    I2C1PIEbits.ADRIE = 1;
+#if defined(I2C_CLIENT_WAKE_ON_ADDRESS) || defined(I2C_TX_PREFETCH)
+    //Enable Address Match Interrupts (wakes the CPU from Sleep, marks the start of each segment)
+    I2C1PIEbits.ADRIE = 1;
+#endif
     
     //Clock source is Fosc (64 MHz)
     I2C1CLK = 0b00001;
@@ -54,96 +111,339 @@ void I2C_initClient(uint8_t address)
     PIE7bits.I2C1RXIE = 1;
     PIE7bits.I2C1TXIE = 1;
     
+#ifdef INTERRUPTS_PRIORITY
+    //High priority, so application ISRs cannot delay the bus
+    IPR7bits.I2C1IP = 1;
+    IPR7bits.I2C1RXIP = 1;
+    IPR7bits.I2C1TXIP = 1;
+#endif
+    
+#ifdef I2C_CLIENT_BACKPRESSURE
+    //Hold SCL after the 8th bit of each data byte, so the ACK can be decided first
+    //The byte is read in the general ISR, not the RX ISR
+    I2C1PIEbits.WRIE = 1;
+    PIE7bits.I2C1RXIE = 0;
+    
+    //TMR4 limits the backpressure stretch - LFINTOSC / 32 (~1 ms per count), one-shot
+    T4CON = 0x00;
+    T4CLKCON = 0b0100;
+    T4CONbits.CKPS = 0b101;
+    T4HLTbits.MODE = 0b01000;
+    T4PR = I2C_CLIENT_MAX_STRETCH_MS;
+    
+#ifdef INTERRUPTS_PRIORITY
+    //Shares state with the I2C ISRs, so it must not preempt them
+    IPR11bits.TMR4IP = 1;
+#endif
+    
+    PIR11bits.TMR4IF = 0;
+    PIE11bits.TMR4IE = 1;
+#endif
+    
     //Enable I2C Module
     I2C1CON0bits.EN = 1;
 }
 
-//Initialize the bus timeout feature
-void I2C_initBTO(bool reset, bool prescale, uint8_t timeout, I2C_BTO_Clock clock)
+#ifdef I2C_CLIENT_ISR_STATS
+//Adds the time since ENTRY to the ISR total
+static void I2C_addISRTime(uint16_t entry)
 {
-    I2C1BTO = (reset << 7) | (prescale << 6) | (0x3F & timeout);
-    I2C1BTOC = clock;
+    isrTicks += (uint16_t) (Timebase_now() - entry);
 }
+#endif
 
-//Initializes the I/O pins for I2C
-void I2C_initPins(void)
+//Completes the current segment (on STOP or Repeated Start) and calls the Complete Handler
+static void I2C_completeSegment(void)
 {
-    //RC3 - SCL
-    //RC4 - SDA
+    //CNT counts down once per data byte clocked on the bus
+    uint8_t len = segmentStartCount - I2C1CNTL;
+    I2C_ClientStatus status = I2C_CLIENT_OK;
     
-    //Disable Analog Inputs
-    ANSELCbits.ANSELC3 = 0;
-    ANSELCbits.ANSELC4 = 0;
-    
-    //Configure as Open-Drain
-    ODCONCbits.ODCC3 = 1;
-    ODCONCbits.ODCC4 = 1;
-    
-    //Set as Outputs
-    TRISC3 = 0;
-    TRISC4 = 0;
-    
-    //Set PPS Outputs
-    I2C1SCLPPS = 0b010011;
-    I2C1SDAPPS = 0b010100;
+    if (I2C1ERRbits.BCLIF || I2C1ERRbits.BTOIF)
+    {
+        status = I2C_CLIENT_BUS_ERROR;
+    }
+    else if ((xferBuffer != 0) && (len > xferSize))
+    {
+        status = I2C_CLIENT_OVERFLOW;
+    }
     
-    //Set PPS Inputs
-    RC3PPS = 0x20;
-    RC4PPS = 0x21;
+    //Bytes requested from the read handler, but never clocked out (loaded at STOP or prefetched)
+    if ((xferRead) && (txCalls > len) && (unreadCallback != 0))
+    {
+        unreadCallback(txCalls - len);
+    }
     
-    //Standard Slew Rate
-    RC3I2Cbits.SLEW = 0b00;
-    RC4I2Cbits.SLEW = 0b00;
+    if (completeCallback != 0)
+    {
+        completeCallback(xferRead, len, status);
+    }
     
-    //I2C Thresholds
-    RC3I2Cbits.TH = 0b01;
-    RC4I2Cbits.TH = 0b01;
+    xferActive = false;
+    xferBuffer = 0;
+    txCalls = 0;
+    txNextValid = false;
+}
+
+//Returns the next byte from the read handler
+static uint8_t I2C_requestTxByte(void)
+{
+    if (txCallback == 0)
+    {
+        return 0x00;
+    }
     
-    //Enable Internal Pullup resistors
-#ifdef USE_INTERNAL_PULLUPS
+    if (txCalls < 0xFF)
+    {
+        txCalls++;
+    }
     
-    //10x Normal Pullup Strength
-    RC3I2Cbits.PU = 0b10;
-    RC4I2Cbits.PU = 0b10;
-#endif
+    return txCallback();
 }
 
 //Write Interrupt
 void __interrupt(irq(I2C1TX), base(INTERRUPT_BASE)) I2C_writeISR(void)
 {    
-    if (txCallback != 0)
+    uint16_t entry = Timebase_now();
+    
+    if (xferBuffer != 0)
     {
-        I2C1TXB = txCallback();
+        //Pre-armed buffer - no per-byte callback
+        if (xferIndex < xferSize)
+        {
+            I2C1TXB = xferBuffer[xferIndex];
+            xferIndex++;
+        }
+        else
+        {
+            I2C1TXB = 0x00;
+        }
     }
     else
     {
-        I2C1TXB = 0x00;
+#ifdef I2C_TX_PREFETCH
+        //Only the 1st byte of a segment is computed while SCL is held
+        if (!txNextValid)
+        {
+            txNext = I2C_requestTxByte();
+        }
+        
+        I2C1TXB = txNext;
+#else
+        I2C1TXB = I2C_requestTxByte();
+#endif
+    }
+    
+    uint16_t stretch = Timebase_now() - entry;
+    if (stretch > worstTxStretch)
+    {
+        worstTxStretch = stretch;
     }
     
+#ifdef I2C_TX_PREFETCH
+    if (xferBuffer == 0)
+    {
+        //Compute the next byte while this one is shifted out
+        txNext = I2C_requestTxByte();
+        txNextValid = true;
+    }
+#endif
+    
     //Clear flag
     PIR7bits.I2C1TXIF = 0;
+    
+#ifdef I2C_CLIENT_ISR_STATS
+    I2C_addISRTime(entry);
+#endif
 }
 
-//Read Interrupt
-void __interrupt(irq(I2C1RX), base(INTERRUPT_BASE)) I2C_readISR(void)
+//Reads I2C1RXB and passes the byte to the transfer buffer or a handler
+static void I2C_receiveByte(void)
 {
     volatile uint8_t rx = I2C1RXB;
     
-    if (rxCallback != 0)
+    if (xferBuffer != 0)
+    {
+        //Pre-armed buffer - no per-byte callback
+        if (xferIndex < xferSize)
+        {
+            xferBuffer[xferIndex] = rx;
+            xferIndex++;
+        }
+    }
+#ifdef I2C_ENABLE_GENERAL_CALL
+    //ADB0 holds the address byte that was matched
+    else if ((gcCallback != 0) && (I2C1ADB0 == (I2C_GENERAL_CALL_ADDR << 1)))
+    {
+        gcCallback(rx);
+    }
+#endif
+    else if (rxCallback != 0)
     {
         rxCallback(rx);
     }
+}
+
+#ifdef I2C_CLIENT_BACKPRESSURE
+//ACKs or NACKs the byte held before its ACK, and releases SCL
+static void I2C_releaseReceive(bool accept)
+{
+    T4CONbits.ON = 0;
+    rxPaused = false;
+    
+    if (accept)
+    {
+        I2C1CON1bits.ACKDT = 0;
+        I2C_receiveByte();
+    }
+    else
+    {
+        //The byte is dropped - the host sees the NACK
+        I2C1CON1bits.ACKDT = 1;
+        volatile uint8_t rx = I2C1RXB;
+        rxDiscard = true;
+    }
+    
+    I2C1PIRbits.WRIF = 0;
+    PIR7bits.I2C1RXIF = 0;
+    
+    //Release SCL - the ACK is sent with ACKDT
+    I2C1CON0bits.CSTR = 0;
+}
+
+//Decides the ACK of a received data byte while SCL is held (WRIF, ACKT set)
+static void I2C_acceptByte(void)
+{
+    I2C_ClientWriteReady ready = I2C_CLIENT_ACCEPT;
+    
+    if (rxDiscard)
+    {
+        ready = I2C_CLIENT_REJECT;
+    }
+    else if ((xferBuffer == 0) && (writeReadyCallback != 0))
+    {
+        ready = writeReadyCallback();
+    }
+    
+    if (ready == I2C_CLIENT_HOLD)
+    {
+        //Keep SCL low until I2C_resumeReceive or the stretch timeout
+        rxPaused = true;
+        I2C1PIRbits.WRIF = 0;
+        
+        T4TMR = 0x00;
+        PIR11bits.TMR4IF = 0;
+        T4CONbits.ON = 1;
+        return;
+    }
+    
+    I2C_releaseReceive(ready == I2C_CLIENT_ACCEPT);
+}
+
+//Stretch Timeout Interrupt
+void __interrupt(irq(TMR4), base(INTERRUPT_BASE)) I2C_stretchTimeoutISR(void)
+{
+    PIR11bits.TMR4IF = 0;
+    
+    if (rxPaused)
+    {
+        //NACK the held byte, so the host ends the transfer
+        I2C_releaseReceive(false);
+        stretchTimeouts++;
+    }
+}
+#endif
 
+//Read Interrupt
+void __interrupt(irq(I2C1RX), base(INTERRUPT_BASE)) I2C_readISR(void)
+{
+#ifdef I2C_CLIENT_ISR_STATS
+    uint16_t isrEntry = Timebase_now();
+#endif
+    
+    I2C_receiveByte();
     
     //Clear flag
     PIR7bits.I2C1RXIF = 0;
+    
+#ifdef I2C_CLIENT_ISR_STATS
+    I2C_addISRTime(isrEntry);
+#endif
 }
 
 //General I2C Interrupt Handler
 void __interrupt(irq(I2C1), base(INTERRUPT_BASE)) I2C_stopISR(void)
 {
+#ifdef I2C_CLIENT_ISR_STATS
+    uint16_t isrEntry = Timebase_now();
+#endif
+    
+    if (I2C1PIRbits.ADRIF)
+    {
+        uint16_t entry = Timebase_now();
+        
+        //A Repeated Start ends the previous segment
+        if (xferActive)
+        {
+            I2C_completeSegment();
+        }
+        
+        xferActive = true;
+        xferRead = I2C1STAT0bits.R;
+        xferIndex = 0;
+        segmentStartCount = I2C1CNTL;
+        
+        if (addressCallback != 0)
+        {
+            I2C_ClientBuffer target = {0, 0};
+            
+            //ADB0 holds the matched address and R/W bit
+            addressCallback(I2C1ADB0 >> 1, xferRead, &target);
+            
+            xferBuffer = target.buffer;
+            xferSize = target.size;
+        }
+        
+#ifdef I2C_CLIENT_BACKPRESSURE
+        //ACK the address and the bytes of the new segment
+        I2C1CON1bits.ACKDT = 0;
+        rxDiscard = false;
+#endif
+        
+        //Clear Address Flag
+        I2C1PIRbits.ADRIF = 0;
+        
+        //Release SCL
+        I2C1CON0bits.CSTR = 0;
+        
+        uint16_t stretch = Timebase_now() - entry;
+        if (stretch > worstAddressStretch)
+        {
+            worstAddressStretch = stretch;
+        }
+    }
+    
+#ifdef I2C_CLIENT_BACKPRESSURE
+    //Data byte received - SCL is held before the ACK
+    if ((I2C1PIRbits.WRIF) && (!rxPaused))
+    {
+        I2C_acceptByte();
+    }
+#endif
+    
     if (I2C1PIRbits.PCIF)
     {
+#ifdef I2C_CLIENT_BACKPRESSURE
+        //ACK the next transaction
+        I2C1CON1bits.ACKDT = 0;
+        rxDiscard = false;
+#endif
+        
+        if (xferActive)
+        {
+            I2C_completeSegment();
+        }
+        
         //Stop Interrupt
         I2C1CNTL = 0xFF;
         
@@ -155,12 +455,23 @@ void __interrupt(irq(I2C1), base(INTERRUPT_BASE)) I2C_stopISR(void)
             stopCallback();
         }
         
+        //Signal the main loop
+        transactionDone = true;
+        
+#ifdef I2C_CLIENT_ISR_STATS
+        isrTransactions++;
+#endif
+        
         //Clear STOP Flag
         I2C1PIRbits.PCIF = 0;
     }
     
     //Clear General Flag
     PIR7bits.I2C1IF = 0;
+    
+#ifdef I2C_CLIENT_ISR_STATS
+    I2C_addISRTime(isrEntry);
+#endif
 }
 
 
@@ -181,3 +492,139 @@ void I2C_assignStopHandler(void (*stopHandler)(void))
 {
     stopCallback = stopHandler;
 }
+
+//This function is called on an I2C Write to the General Call address
+void I2C_assignGeneralCallWriteHandler(void (*writeHandler)(uint8_t))
+{
+    gcCallback = writeHandler;
+}
+
+//This function is called on each address match, and may supply a buffer for the transfer
+void I2C_assignAddressHandler(void (*addressHandler)(uint8_t, bool, I2C_ClientBuffer*))
+{
+    addressCallback = addressHandler;
+    
+    //Address Match interrupts are required
+    I2C1PIEbits.ADRIE = 1;
+}
+
+//This function is called when a transaction segment ends (Repeated Start or STOP)
+void I2C_assignCompleteHandler(void (*completeHandler)(bool, uint8_t, I2C_ClientStatus))
+{
+    completeCallback = completeHandler;
+    
+    //Address Match interrupts are required to find the start of a segment
+    I2C1PIEbits.ADRIE = 1;
+}
+
+//This function is called at the end of a read with the number of bytes requested, but not sent
+void I2C_assignByteUnreadHandler(void (*unreadHandler)(uint8_t))
+{
+    unreadCallback = unreadHandler;
+    
+    //Address Match interrupts are required to find the start of a segment
+    I2C1PIEbits.ADRIE = 1;
+}
+
+#ifdef I2C_CLIENT_BACKPRESSURE
+//This function is called before each received byte is passed to the Byte Write Handler
+void I2C_assignWriteReadyHandler(I2C_ClientWriteReady (*writeReadyHandler)(void))
+{
+    writeReadyCallback = writeReadyHandler;
+}
+
+//Passes the held byte to the Byte Write Handler and releases SCL
+void I2C_resumeReceive(void)
+{
+    //The timeout ISR must not release the byte at the same time
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    if (rxPaused)
+    {
+        I2C_releaseReceive(true);
+    }
+    
+    INTCON0bits.GIE = enabled;
+}
+
+//Returns the number of stretches that ended in a NACK
+uint16_t I2C_getStretchTimeoutCount(void)
+{
+    return stretchTimeouts;
+}
+#endif
+
+//Returns true once for each transaction that ended with a STOP since the last call
+bool I2C_isTransactionComplete(void)
+{
+    if (!transactionDone)
+    {
+        return false;
+    }
+    
+    transactionDone = false;
+    return true;
+}
+
+//Sleeps until a transaction has completed, waking on each address match
+void I2C_waitForTransaction(void)
+{
+    //Full Sleep, not IDLE
+    CPUDOZEbits.IDLEN = 0;
+    
+    while (!I2C_isTransactionComplete())
+    {
+        //Interrupts off, so an event between the check and SLEEP still wakes the CPU
+        INTCON0bits.GIE = 0;
+        
+        if (!transactionDone)
+        {
+            SLEEP();
+            NOP();
+        }
+        
+        //Pending interrupts are serviced here
+        INTCON0bits.GIE = 1;
+    }
+}
+
+//Returns the longest time SCL was held after an address match, in timebase ticks
+uint16_t I2C_getWorstAddressStretch(void)
+{
+    return worstAddressStretch;
+}
+
+//Returns the longest time from TX ISR entry to loading I2C1TXB, in timebase ticks
+uint16_t I2C_getWorstTxStretch(void)
+{
+    return worstTxStretch;
+}
+
+#ifdef I2C_CLIENT_ISR_STATS
+//Copies the total I2C ISR time (timebase ticks) and the number of STOPs since the last clear
+void I2C_getISRLoad(uint32_t* ticks, uint32_t* transactions)
+{
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    *ticks = isrTicks;
+    *transactions = isrTransactions;
+    
+    INTCON0bits.GIE = enabled;
+}
+
+//Clears the ISR time and STOP count
+void I2C_clearISRLoad(void)
+{
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    isrTicks = 0;
+    isrTransactions = 0;
+    
+    INTCON0bits.GIE = enabled;
+}
+#endif
+
+#endif	/* I2C_ROLE_CLIENT */
@@ -29,30 +29,54 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
     
-//If defined, internal pull-up resistors will be used
-#define USE_INTERNAL_PULLUPS
+//Shared pin and bus timeout setup, role selection
+#include "i2c_core.h"
     
-    //Options for Bus Time Out (BTO) Clock Sources
+//If defined, the client will also ACK the General Call address (I2C_GENERAL_CALL_ADDR)
+//Off by default - any host on the bus can then write to the General Call buffer
+//#define I2C_ENABLE_GENERAL_CALL
+    
+//If defined, Address Match interrupts are enabled so the CPU can sleep between transactions
+//SCL is held after each address match until the ISR releases it
+#define I2C_CLIENT_WAKE_ON_ADDRESS
+    
+//If defined, the next byte to send is computed while the current byte is shifted out
+//The read handler is only on the clock-stretch path for the 1st byte of a read
+#define I2C_TX_PREFETCH
+    
+//If defined, the Write Ready Handler decides the ACK of each received byte before it is sent
+//It can NACK the byte, or hold SCL low while the destination is full (uses TMR4)
+//If the stretch lasts longer than I2C_CLIENT_MAX_STRETCH_MS, the held byte is NACKed
+//Off by default - SCL is held on every data byte while the handler runs
+//#define I2C_CLIENT_BACKPRESSURE
+    
+//Longest backpressure stretch, in ms (1 - 255)
+#define I2C_CLIENT_MAX_STRETCH_MS 10
+    
+//If defined, the time spent in the I2C ISRs is accumulated with the timebase
+//#define I2C_CLIENT_ISR_STATS
+    
+    //Buffer supplied by the Address Handler for a transfer
+    //If BUFFER is left as 0, the byte handlers are used instead
+    typedef struct {
+        volatile uint8_t* buffer;
+        uint8_t size;
+    } I2C_ClientBuffer;
+    
+    //Result of the Write Ready Handler for the byte waiting for its ACK
     typedef enum {
-        I2C_BTO_TMR2 = 0b0001, I2C_BTO_TMR4, 
-        I2C_TU16A, I2C_TU16B_OUT, I2C_BTO_LFINTOSC, 
-        I2C_BTO_MFINTOSC, I2C_BTO_SOSC
-    } I2C_BTO_Clock;
+        I2C_CLIENT_ACCEPT = 0, I2C_CLIENT_HOLD, I2C_CLIENT_REJECT
+    } I2C_ClientWriteReady;
+    
+    //Result of a transfer, passed to the Complete Handler
+    typedef enum {
+        I2C_CLIENT_OK = 0, I2C_CLIENT_OVERFLOW, I2C_CLIENT_BUS_ERROR
+    } I2C_ClientStatus;
     
     //Initializes the I2C Module in Client Mode
     //I/O is configured separately
     void I2C_initClient(uint8_t address);
     
-    //Initialize the bus timeout feature
-    //Reset - enables whether the I2C module should reset on a timeout
-    //Prescale - enables a 32x clock divider for the timeout
-    //Timeout - the number of clock cycles before a timeout. Must be less than 64
-    //Clock - Select the clock source used
-    void I2C_initBTO(bool reset, bool prescale, uint8_t timeout, I2C_BTO_Clock clock);
-    
-    //Initializes the I/O pins for I2C
-    void I2C_initPins(void);
-    
     //This function is called on an I2C Write from the Host
     void I2C_assignByteWriteHandler(void (*writeHandler)(uint8_t));
     
@@ -61,6 +85,63 @@ extern "C" {
 
     //This function is called when an I2C Stop Event occurs
     void I2C_assignStopHandler(void (*stopHandler)(void));
+    
+    //This function is called at the end of a read with the number of bytes requested
+    //from the Byte Read Handler that were never sent (loaded at STOP or prefetched)
+    //Enables Address Match interrupts
+    void I2C_assignByteUnreadHandler(void (*unreadHandler)(uint8_t));
+    
+    //This function is called on an I2C Write to the General Call address
+    //If not assigned, General Call bytes are passed to the Byte Write Handler
+    void I2C_assignGeneralCallWriteHandler(void (*writeHandler)(uint8_t));
+    
+    //This function is called on each address match with the 7-bit address and direction (isRead)
+    //It may point BUFFER at memory to transfer directly, without per-byte handlers
+    //Enables Address Match interrupts
+    void I2C_assignAddressHandler(void (*addressHandler)(uint8_t addr, bool isRead, I2C_ClientBuffer* buffer));
+    
+    //This function is called when a transfer ends on a Repeated Start or STOP
+    //LEN is the number of bytes clocked on the bus, STATUS reports overflow or bus errors
+    //Enables Address Match interrupts
+    void I2C_assignCompleteHandler(void (*completeHandler)(bool isRead, uint8_t len, I2C_ClientStatus status));
+    
+#ifdef I2C_CLIENT_BACKPRESSURE
+    //This function is called before each received byte is ACKed
+    //ACCEPT passes it to the Byte Write Handler, REJECT NACKs it (and the rest until START or STOP)
+    //HOLD keeps SCL low, before the ACK, until I2C_resumeReceive or the stretch timeout
+    void I2C_assignWriteReadyHandler(I2C_ClientWriteReady (*writeReadyHandler)(void));
+    
+    //ACKs the held byte, passes it to the Byte Write Handler and releases SCL
+    //Call once the destination has space. Does nothing if no byte is held
+    void I2C_resumeReceive(void);
+    
+    //Returns the number of held bytes that were NACKed (I2C_CLIENT_MAX_STRETCH_MS exceeded)
+    uint16_t I2C_getStretchTimeoutCount(void);
+#endif
+    
+    //Returns true once for each transaction that ended with a STOP since the last call
+    bool I2C_isTransactionComplete(void);
+    
+    //Sleeps until a transaction has completed, waking on each address match
+    //Returns immediately if a completed transaction has not been consumed yet
+    void I2C_waitForTransaction(void);
+    
+    //Returns the longest time from address ISR entry to the SCL release, in timebase ticks
+    //ISR time only: the timebase stops in Sleep, so the wake-up latency is not included
+    //Requires I2C_CLIENT_WAKE_ON_ADDRESS and Timebase_init()
+    uint16_t I2C_getWorstAddressStretch(void);
+    
+    //Returns the longest time from TX ISR entry to loading I2C1TXB, in timebase ticks
+    //Requires Timebase_init()
+    uint16_t I2C_getWorstTxStretch(void);
+    
+#ifdef I2C_CLIENT_ISR_STATS
+    //Copies the total I2C ISR time (timebase ticks) and the number of STOPs since the last clear
+    void I2C_getISRLoad(uint32_t* ticks, uint32_t* transactions);
+    
+    //Clears the ISR time and STOP count
+    void I2C_clearISRLoad(void);
+#endif
 
     
 #ifdef	__cplusplus
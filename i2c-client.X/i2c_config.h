@@ -0,0 +1,26 @@
+#ifndef I2C_CONFIG_H
+#define	I2C_CONFIG_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+//Driver roles built into this firmware (set both for multi-role firmware)
+#define I2C_ROLE_HOST 0
+#define I2C_ROLE_CLIENT 1
+    
+//I2C Pins - only pins with I2C pads (RB1, RB2, RC3, RC4) support the I2C thresholds and pull-ups
+#define I2C_SCL_PORT C
+#define I2C_SCL_PIN 3
+#define I2C_SDA_PORT C
+#define I2C_SDA_PIN 4
+    
+//If defined, internal pull-up resistors will be used
+#define USE_INTERNAL_PULLUPS
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_CONFIG_H */
+
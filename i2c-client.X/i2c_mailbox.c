@@ -0,0 +1,196 @@
+#include "i2c_mailbox.h"
+#include "i2c_blockData.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Only built into firmware that uses the mailbox (see i2c_blockData.h)
+#ifdef BLOCKDATA_MAILBOX
+
+//Handler prototypes, from the command table
+#define MAILBOX_PROTOTYPE(id, handler, argLen, runMode) uint8_t handler(const volatile uint8_t* args, volatile uint8_t* data);
+MAILBOX_COMMANDS(MAILBOX_PROTOTYPE)
+
+//Argument lengths are checked at compile time
+#define MAILBOX_CHECK(id, handler, argLen, runMode) typedef char handler##_argLen_check[((argLen) <= MAILBOX_MAX_ARGS) ? 1 : -1];
+MAILBOX_COMMANDS(MAILBOX_CHECK)
+
+//Dispatch table, indexed by command ID. IDs above MAILBOX_MAX_COMMAND fail to compile
+#define MAILBOX_ENTRY(id, handler, argLen, runMode) [id] = {&handler, argLen, runMode},
+static const Mailbox_Command commandTable[MAILBOX_MAX_COMMAND + 1] = {
+    MAILBOX_COMMANDS(MAILBOX_ENTRY)
+};
+
+//Response layout
+#define MAILBOX_RESPONSE_STATUS 0
+#define MAILBOX_RESPONSE_LENGTH 1
+#define MAILBOX_RESPONSE_DATA   2
+
+//Response of the last command, read through MAILBOX_COMMAND_REG (not part of the read buffer)
+static volatile uint8_t response[MAILBOX_RESPONSE_SIZE];
+static volatile uint8_t responseIndex = 0;
+
+//Command being received
+static const Mailbox_Command* command = 0;
+static volatile uint8_t commandId = 0;
+static volatile uint8_t args[MAILBOX_MAX_ARGS];
+static volatile uint8_t argCount = 0;
+static volatile bool hasCommand = false;
+static volatile bool accepting = false;
+
+//Set when a command is waiting for Mailbox_service
+static volatile bool deferredPending = false;
+
+//Commands that overran the ISR budget, 1 bit per ID - they are deferred from then on
+static volatile uint8_t overrunMap[(MAILBOX_MAX_COMMAND + 8) / 8];
+
+static volatile uint16_t worstTurnaround = 0;
+static volatile uint16_t overrunCount = 0;
+
+//Runs the handler and stages the response - the status is written last
+static void Mailbox_run(void)
+{
+    uint8_t len = command->handler(args, &response[MAILBOX_RESPONSE_DATA]);
+    
+    if (len > MAILBOX_RESPONSE_SIZE - MAILBOX_RESPONSE_DATA)
+    {
+        len = MAILBOX_RESPONSE_SIZE - MAILBOX_RESPONSE_DATA;
+    }
+    
+    response[MAILBOX_RESPONSE_LENGTH] = len;
+    response[MAILBOX_RESPONSE_STATUS] = MAILBOX_STATUS_OK;
+}
+
+//Runs the command in the ISR, or leaves it for Mailbox_service
+static void Mailbox_dispatch(void)
+{
+    uint8_t mask = (uint8_t) (1 << (commandId & 0x07));
+    
+    if ((command->runMode == MAILBOX_RUN_DEFERRED) || (overrunMap[commandId >> 3] & mask))
+    {
+        //The response stays BUSY until the main loop runs the handler
+        deferredPending = true;
+        return;
+    }
+    
+    uint16_t entry = Timebase_now();
+    Mailbox_run();
+    uint16_t turnaround = Timebase_now() - entry;
+    
+    if (turnaround > worstTurnaround)
+    {
+        worstTurnaround = turnaround;
+    }
+    
+    if (turnaround > MAILBOX_TURNAROUND_LIMIT)
+    {
+        //Bound the stretch - this command runs from the main loop from now on
+        overrunMap[commandId >> 3] |= mask;
+        overrunCount++;
+    }
+}
+
+//Called when the host selects MAILBOX_COMMAND_REG
+void Mailbox_select(void)
+{
+    hasCommand = false;
+    accepting = false;
+    responseIndex = 0;
+}
+
+//Adds a byte of the command (ID, then arguments)
+void Mailbox_receiveByte(uint8_t data)
+{
+    if (!hasCommand)
+    {
+        hasCommand = true;
+        
+        //A deferred command owns the arguments and response until it has run
+        if (deferredPending)
+        {
+            return;
+        }
+        
+        accepting = true;
+        command = 0;
+        commandId = data;
+        argCount = 0;
+        
+        //A read before the command completes sees BUSY
+        response[MAILBOX_RESPONSE_STATUS] = MAILBOX_STATUS_BUSY;
+        response[MAILBOX_RESPONSE_LENGTH] = 0;
+        
+        //O(1) lookup - unused IDs have no handler
+        if ((data > MAILBOX_MAX_COMMAND) || (commandTable[data].handler == 0))
+        {
+            response[MAILBOX_RESPONSE_STATUS] = MAILBOX_STATUS_UNKNOWN;
+            accepting = false;
+            return;
+        }
+        
+        command = &commandTable[data];
+    }
+    else if ((accepting) && (argCount < command->argLen))
+    {
+        args[argCount] = data;
+        argCount++;
+    }
+    else
+    {
+        //Extra bytes after the arguments, or an ignored command
+        return;
+    }
+    
+    if (argCount == command->argLen)
+    {
+        accepting = false;
+        Mailbox_dispatch();
+    }
+}
+
+//Returns the next response byte
+uint8_t Mailbox_requestByte(void)
+{
+    uint8_t data = 0x00;
+    
+    if (responseIndex < MAILBOX_RESPONSE_SIZE)
+    {
+        data = response[responseIndex];
+        responseIndex++;
+    }
+    
+    return data;
+}
+
+//Restarts response reads at the status byte
+void Mailbox_rewind(void)
+{
+    responseIndex = 0;
+}
+
+//Runs a deferred command, if one is waiting
+void Mailbox_service(void)
+{
+    if (!deferredPending)
+    {
+        return;
+    }
+    
+    //The ISR does not touch the command or response while this is set
+    Mailbox_run();
+    deferredPending = false;
+}
+
+//Returns the longest dispatch time in the ISR, in timebase ticks
+uint16_t Mailbox_getWorstTurnaround(void)
+{
+    return worstTurnaround;
+}
+
+//Returns the number of ISR dispatches longer than MAILBOX_TURNAROUND_LIMIT
+uint16_t Mailbox_getOverrunCount(void)
+{
+    return overrunCount;
+}
+
+#endif	/* BLOCKDATA_MAILBOX */
@@ -0,0 +1,57 @@
+#ifndef I2C_MAILBOX_H
+#define	I2C_MAILBOX_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+#include "timebase.h"
+#include "mailbox_commands.h"
+    
+//Status byte at the start of each response
+#define MAILBOX_STATUS_OK       0x00
+#define MAILBOX_STATUS_UNKNOWN  0x01
+#define MAILBOX_STATUS_BUSY     0xFF
+    
+    //Command handler - ARGS holds argLen bytes, up to MAILBOX_RESPONSE_SIZE - 2 bytes can be written to DATA
+    //Returns the number of bytes written to DATA. Runs in the I2C ISR
+    typedef uint8_t (*Mailbox_Handler)(const volatile uint8_t* args, volatile uint8_t* data);
+    
+    //Command table entry
+    typedef struct {
+        Mailbox_Handler handler;
+        uint8_t argLen;
+        uint8_t runMode;
+    } Mailbox_Command;
+    
+    //Called when the host selects MAILBOX_COMMAND_REG. The next byte written is a command ID
+    void Mailbox_select(void);
+    
+    //Adds a byte of the command (ID, then arguments). Ignored while a deferred command is waiting
+    void Mailbox_receiveByte(uint8_t data);
+    
+    //Returns the next response byte. Reads past the end return 0x00
+    uint8_t Mailbox_requestByte(void);
+    
+    //Restarts response reads at the status byte (called at STOP)
+    void Mailbox_rewind(void);
+    
+    //Runs a deferred command, if one is waiting. Call from the main loop
+    void Mailbox_service(void);
+    
+    //Returns the longest dispatch time in the ISR (last argument byte to response staged), in timebase ticks
+    uint16_t Mailbox_getWorstTurnaround(void);
+    
+    //Returns the number of ISR dispatches longer than MAILBOX_TURNAROUND_LIMIT
+    //Each command that overruns is deferred to Mailbox_service from then on
+    uint16_t Mailbox_getOverrunCount(void);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_MAILBOX_H */
+
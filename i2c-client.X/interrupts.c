@@ -2,15 +2,124 @@
 
 #include <xc.h>
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef INTERRUPTS_LATENCY_PROBE
+static volatile uint8_t worstLatency = 0;
+static volatile uint16_t latencyCounts[INTERRUPTS_LATENCY_BUCKETS];
+
+//Starts TMR0 as a periodic probe - Fosc/4, 1:16 prescaler (1 us per count)
+//This is the latency of TMR0 itself - a proxy for the I2C vectors at the same level
+static void Interrupts_initLatencyProbe(void)
+{
+    T0CON0 = 0x00;
+    T0CON1 = 0b01000100;
+    
+    //8-bit mode - TMR0L resets to 0 on a period match, as TMR0IF is set
+    TMR0H = INTERRUPTS_LATENCY_PERIOD_US - 1;
+    TMR0L = 0x00;
+    
+#ifdef INTERRUPTS_PRIORITY
+    //Same level as the I2C vectors
+    IPR3bits.TMR0IP = 1;
+#endif
+    
+    PIR3bits.TMR0IF = 0;
+    PIE3bits.TMR0IE = 1;
+    
+    T0CON0bits.EN = 1;
+}
+
+//Latency Probe Interrupt
+void __interrupt(irq(TMR0), base(INTERRUPT_BASE)) Interrupts_latencyISR(void)
+{
+    //Counts since the flag was set, including the context save
+    uint8_t latency = TMR0L;
+    
+    PIR3bits.TMR0IF = 0;
+    
+    if (latency > worstLatency)
+    {
+        worstLatency = latency;
+    }
+    
+    uint8_t bucket = latency / INTERRUPTS_LATENCY_BUCKET_US;
+    if (bucket >= INTERRUPTS_LATENCY_BUCKETS)
+    {
+        bucket = INTERRUPTS_LATENCY_BUCKETS - 1;
+    }
+    
+    if (latencyCounts[bucket] != 0xFFFF)
+    {
+        latencyCounts[bucket]++;
+    }
+}
+#endif
+
 //Initializes vector interrupts on the devices
 void Interrupts_init(void)
 {
     IVTBASE = INTERRUPT_BASE;
     IVTLOCKbits.IVTLOCKED = 1;
+    
+#ifdef INTERRUPTS_PRIORITY
+    //Enable High / Low Priority Levels
+    INTCON0bits.IPEN = 1;
+#endif
+    
+#ifdef INTERRUPTS_LATENCY_PROBE
+    Interrupts_initLatencyProbe();
+#endif
 }
 
 //Enables interrupts on the device
 void Interrupts_enable(void)
 {
+#ifdef INTERRUPTS_PRIORITY
+    INTCON0bits.GIEL = 1;
+#endif
     INTCON0bits.GIE = 1;
-}
\ No newline at end of file
+}
+
+#ifdef INTERRUPTS_LATENCY_PROBE
+//Returns the longest time from the probe flag to ISR entry, in us
+uint8_t Interrupts_getWorstLatency(void)
+{
+    return worstLatency;
+}
+
+//Returns the number of probe entries in histogram bucket BUCKET
+uint16_t Interrupts_getLatencyCount(uint8_t bucket)
+{
+    if (bucket >= INTERRUPTS_LATENCY_BUCKETS)
+    {
+        return 0;
+    }
+    
+    //16-bit value - not read atomically
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    uint16_t count = latencyCounts[bucket];
+    
+    INTCON0bits.GIE = enabled;
+    
+    return count;
+}
+
+//Clears the worst case and the histogram
+void Interrupts_clearLatencyStats(void)
+{
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    worstLatency = 0;
+    for (uint8_t i = 0; i < INTERRUPTS_LATENCY_BUCKETS; i++)
+    {
+        latencyCounts[i] = 0;
+    }
+    
+    INTCON0bits.GIE = enabled;
+}
+#endif
@@ -5,14 +5,47 @@
 extern "C" {
 #endif
     
+#include <stdint.h>
+    
 #define INTERRUPT_BASE 0x1000
     
+//If defined, interrupt priorities are enabled (IPEN)
+//The I2C vectors are high priority. Application vectors can be moved below them by
+//clearing their IPRx bit - the ISR must then be declared with low_priority
+//GIE (GIEH) masks both levels, so existing critical sections are unchanged
+#define INTERRUPTS_PRIORITY
+    
+//If defined, TMR0 measures the time from its flag to ISR entry, at the I2C priority
+//#define INTERRUPTS_LATENCY_PROBE
+    
+//Probe period, in us (1 us per TMR0 count, max 256)
+#define INTERRUPTS_LATENCY_PERIOD_US 250
+    
+#if (INTERRUPTS_LATENCY_PERIOD_US < 2) || (INTERRUPTS_LATENCY_PERIOD_US > 256)
+#error "INTERRUPTS_LATENCY_PERIOD_US must be 2 to 256"
+#endif
+    
+//Histogram size and bucket width, in us - the last bucket counts all longer entries
+#define INTERRUPTS_LATENCY_BUCKETS 8
+#define INTERRUPTS_LATENCY_BUCKET_US 2
+    
     //Initializes vector interrupts on the devices
     void Interrupts_init(void);
     
     //Enables interrupts on the device
     void Interrupts_enable(void);
     
+#ifdef INTERRUPTS_LATENCY_PROBE
+    //Returns the longest time from the TMR0 probe flag to ISR entry, in us
+    uint8_t Interrupts_getWorstLatency(void);
+    
+    //Returns the number of probe entries in histogram bucket BUCKET
+    uint16_t Interrupts_getLatencyCount(uint8_t bucket);
+    
+    //Clears the worst case and the histogram
+    void Interrupts_clearLatencyStats(void);
+#endif
+    
 #ifdef	__cplusplus
 }
 #endif
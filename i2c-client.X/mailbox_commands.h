@@ -0,0 +1,42 @@
+#ifndef MAILBOX_COMMANDS_H
+#define	MAILBOX_COMMANDS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+//Register written by the host to issue a command, and read for the response
+//Must be above the end of the read and write buffers (checked in main.c)
+#define MAILBOX_COMMAND_REG 0x80
+    
+//Size of the response buffer: status, length, then data
+#define MAILBOX_RESPONSE_SIZE 8
+    
+//Largest argument length and command ID in the table
+#define MAILBOX_MAX_ARGS 4
+#define MAILBOX_MAX_COMMAND 0x0F
+    
+//Dispatch time budget in the ISR (last argument byte to response staged), in timebase ticks
+#define MAILBOX_TURNAROUND_LIMIT (20 * TIMEBASE_TICKS_PER_US)
+    
+//Where a command runs
+//MAILBOX_RUN_ISR - in the I2C ISR, so the response is ready for the Repeated Start
+//MAILBOX_RUN_DEFERRED - from Mailbox_service in the main loop, the host polls until it is not BUSY
+#define MAILBOX_RUN_ISR         0
+#define MAILBOX_RUN_DEFERRED    1
+    
+/*
+ * Command table - X(id, handler, argLen, runMode)
+ * Each handler is defined by the application as:
+ * uint8_t handler(const volatile uint8_t* args, volatile uint8_t* data)
+ */
+#define MAILBOX_COMMANDS(X)                                                     \
+    X(0x01, Mailbox_cmdEcho, 4, MAILBOX_RUN_ISR)                                \
+    X(0x02, Mailbox_cmdGetTurnaround, 0, MAILBOX_RUN_ISR)
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* MAILBOX_COMMANDS_H */
+
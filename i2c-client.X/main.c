@@ -88,11 +88,51 @@
 #include "i2c_client.h"
 #include "i2c_blockData.h"
 #include "interrupts.h"
+#include "timebase.h"
+
+#ifdef BLOCKDATA_PERSIST
+#include "eeprom.h"
+#endif
 
 #define BUFFER_SIZE 16
 
 static volatile uint8_t buffer[BUFFER_SIZE];
 
+#ifdef I2C_CLIENT_BACKPRESSURE
+//The buffer is not drained, so a byte past the end is NACKed at once, without a stretch
+static I2C_ClientWriteReady writeReady(void)
+{
+    return (I2C_BlockData_WriteReady()) ? I2C_CLIENT_ACCEPT : I2C_CLIENT_REJECT;
+}
+#endif
+
+#ifdef BLOCKDATA_MAILBOX
+#include "i2c_mailbox.h"
+
+#if (BUFFER_SIZE > MAILBOX_COMMAND_REG)
+#error "MAILBOX_COMMAND_REG must be outside the read and write buffers"
+#endif
+
+//Example command - returns the 4 argument bytes
+uint8_t Mailbox_cmdEcho(const volatile uint8_t* args, volatile uint8_t* data)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        data[i] = args[i];
+    }
+    return 4;
+}
+
+//Example command - returns the worst dispatch time (timebase ticks, MSB first)
+uint8_t Mailbox_cmdGetTurnaround(const volatile uint8_t* args, volatile uint8_t* data)
+{
+    uint16_t worst = Mailbox_getWorstTurnaround();
+    data[0] = (uint8_t) (worst >> 8);
+    data[1] = (uint8_t) worst;
+    return 2;
+}
+#endif
+
 //Example WRITE function (Host -> Client)
 void myI2CWriteFunction(uint8_t data)
 {
@@ -113,9 +153,19 @@ void myI2CStopFunction(void)
 
 void main(void) {
     
+    //Timebase for stretch measurements
+    Timebase_init();
+    
     //Init I/O
     I2C_initPins();
     
+#ifdef BLOCKDATA_PERSIST
+    //Restore the saved registers before the host can access them
+    I2C_BlockData_setupWriteBuffer(&buffer[0], BUFFER_SIZE);
+    I2C_BlockData_setupPersistRange(0, BUFFER_SIZE);
+    I2C_BlockData_restore();
+#endif
+    
     //Init I2C Client
     I2C_initClient(0x64);
     
@@ -140,9 +190,17 @@ void main(void) {
     I2C_assignByteWriteHandler(&I2C_BlockData_StoreByte);
     I2C_assignByteReadHandler(&I2C_BlockData_RequestByte);
     I2C_assignStopHandler(&I2C_BlockData_onStop);
+    I2C_assignByteUnreadHandler(&I2C_BlockData_UnreadBytes);
+    I2C_assignGeneralCallWriteHandler(&I2C_BlockData_StoreGeneralCallByte);
+    
+#ifdef I2C_CLIENT_BACKPRESSURE
+    //NACK writes past the end of the buffer, instead of discarding them
+    I2C_assignWriteReadyHandler(&writeReady);
+#endif
     
     I2C_BlockData_setupReadBuffer(&buffer[0], BUFFER_SIZE);
     I2C_BlockData_setupWriteBuffer(&buffer[0], BUFFER_SIZE);
+    I2C_BlockData_setupGeneralCallBuffer(&buffer[0], BUFFER_SIZE);
     
     //Configure Vector Interrupts
     Interrupts_init();
@@ -152,11 +210,43 @@ void main(void) {
     
     while (1)
     {
+#ifdef I2C_CLIENT_WAKE_ON_ADDRESS
+#ifdef BLOCKDATA_PERSIST
+        //Save one changed register per pass, sleeping while the EEPROM write runs
+        //A transaction that completes meanwhile is still seen by I2C_waitForTransaction
+        if (I2C_BlockData_flush())
+        {
+            EEPROM_sleepUntilDone();
+            continue;
+        }
+#endif
+        
+        //Sleep until the host completes a transaction
+        I2C_waitForTransaction();
+        
+        //Application work runs once per transaction - toggle the LED
+        LATC7 = !LATC7;
+        
+#ifdef BLOCKDATA_MAILBOX
+        //Commands that are too slow for the ISR
+        Mailbox_service();
+#endif
+#else
         //Blink the LED
         LATC7 = !LATC7;
         
+#ifdef BLOCKDATA_MAILBOX
+        Mailbox_service();
+#endif
+        
+#ifdef BLOCKDATA_PERSIST
+        //Save one changed register per pass - the write runs during the delay
+        I2C_BlockData_flush();
+#endif
+        
         //Simple delay
         for (uint32_t i = 0; i < 0xFFFFF; i++) { ; }
+#endif
     }
     
     return;
@@ -0,0 +1,29 @@
+#include "timebase.h"
+
+#include <xc.h>
+
+#include <stdint.h>
+
+//Starts TMR1 as a free-running 16-bit timebase from Fosc/4
+void Timebase_init(void)
+{
+    T1CON = 0x00;
+    
+    //Fosc/4, 1:1 prescaler
+    T1CLK = 0b00001;
+    
+    //16-bit reads - reading TMR1L latches TMR1H
+    T1CONbits.RD16 = 1;
+    
+    TMR1H = 0x00;
+    TMR1L = 0x00;
+    
+    T1CONbits.ON = 1;
+}
+
+//Returns the current timebase count
+uint16_t Timebase_now(void)
+{
+    uint8_t low = TMR1L;
+    return ((uint16_t) TMR1H << 8) | low;
+}
@@ -0,0 +1,25 @@
+#ifndef TIMEBASE_H
+#define	TIMEBASE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+    
+//Number of timebase ticks per microsecond (Fosc/4 = 16 MHz)
+#define TIMEBASE_TICKS_PER_US 16
+    
+    //Starts TMR1 as a free-running 16-bit timebase from Fosc/4
+    //The timebase does not run in Sleep
+    void Timebase_init(void);
+    
+    //Returns the current timebase count
+    uint16_t Timebase_now(void);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* TIMEBASE_H */
+
@@ -1,5 +1,8 @@
+#include <xc.h>
+
 #include "advanced_IO.h"
 #include "i2c_host.h"
+#include "power.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -11,8 +14,44 @@
 #define MEM_UNLOCK_1 0xA5
 #define MEM_UNLOCK_2 0xF0
 
+//Number of addressable registers (0x00 - ADV_IO_SLRCONx)
+#define ADV_IO_REG_COUNT (ADV_IO_SLRCONx + 1)
+
+//Unimplemented register between IOCxN and WPUx
+#define ADV_IO_RESERVED_REG 0x07
+
+//Largest gap of unchanged registers that is re-written to merge two bursts
+#define ADV_IO_MAX_BRIDGE 2
+
+//!INT from the IO Expander (active LOW) on RB4
+#define ADV_IO_INT_TRIS  TRISBbits.TRISB4
+#define ADV_IO_INT_ANSEL ANSELBbits.ANSELB4
+#define ADV_IO_INT_IOCN  IOCBNbits.IOCBN4
+#define ADV_IO_INT_IOCF  IOCBFbits.IOCBF4
+
+//Volatile, so the unlock sequence is cleared after each memory operation
+//The I2C functions take plain pointers, so it is cast at each call
 static volatile uint8_t memBlock[4];
 
+//State of the memory operation in flight
+static ADVANCED_IO_MEMORY_STATUS memOpStatus = ADV_IO_MEM_IDLE;
+static uint16_t memOpStamp = 0;
+static uint32_t memOpTicks = 0;
+
+//Write-back buffer used between advancedIO_begin and advancedIO_commit
+static uint8_t burstBlock[ADV_IO_REG_COUNT + 1];
+static uint8_t shadowReg[ADV_IO_REG_COUNT];
+static uint16_t shadowValid = 0;
+static uint16_t shadowDirty = 0;
+static bool batchActive = false;
+
+//Returns true if REG can be held in the write-back buffer
+static bool advancedIO_isCacheable(ADVANCED_IO_REGISTER reg)
+{
+    //PORTx and IOCx reflect live pin state and flags - always access the device
+    return ((reg >= ADV_IO_TRISx) && (reg < ADV_IO_REG_COUNT) && (reg != ADV_IO_RESERVED_REG));
+}
+
 void advancedIO_init(void)
 {   
     //Init I/O
@@ -20,10 +59,29 @@ void advancedIO_init(void)
     
     //Init I2C Module in Host Mode
     I2C_initHost();
+    
+#ifdef ADV_IO_USE_INT_PIN
+    //!INT is a digital input
+    ADV_IO_INT_ANSEL = 0;
+    ADV_IO_INT_TRIS = 1;
+    
+    //Latch falling edges in the IOC flag (interrupt is not enabled)
+    ADV_IO_INT_IOCN = 1;
+    ADV_IO_INT_IOCF = 0;
+#endif
 }
 
 void advancedIO_setRegister(ADVANCED_IO_REGISTER reg, uint8_t value)
 {
+    if (batchActive && advancedIO_isCacheable(reg))
+    {
+        //Defer the write until commit
+        shadowReg[reg] = value;
+        shadowValid |= (1 << reg);
+        shadowDirty |= (1 << reg);
+        return;
+    }
+    
     //1st Byte is address inside the expander
     memBlock[0] = reg;
     
@@ -31,18 +89,138 @@ void advancedIO_setRegister(ADVANCED_IO_REGISTER reg, uint8_t value)
     memBlock[1] = value;
     
     //Send I2C
-    I2C_sendBytes(ADVANCED_IO_I2C_ADDR, &memBlock[0], 2);
+    I2C_sendBytes(ADVANCED_IO_I2C_ADDR, (uint8_t*) &memBlock[0], 2);
+}
+
+bool advancedIO_setRegisterBroadcast(ADVANCED_IO_REGISTER reg, uint8_t value)
+{
+    //1st Byte is address inside the expander
+    memBlock[0] = reg;
+    
+    //2nd Byte is value to write
+    memBlock[1] = value;
+    
+    //Send to all expanders at once
+    return I2C_sendGeneralCall((uint8_t*) &memBlock[0], 2);
 }
 
 uint8_t advancedIO_getRegister(ADVANCED_IO_REGISTER reg)
 {    
-    I2C_registerWriteRead(ADVANCED_IO_I2C_ADDR, reg, &memBlock[0], 1);
+    bool cache = (batchActive && advancedIO_isCacheable(reg));
+    
+    if (cache && (shadowValid & (1 << reg)))
+    {
+        //Already known inside this batch
+        return shadowReg[reg];
+    }
+    
+    I2C_registerWriteRead(ADVANCED_IO_I2C_ADDR, reg, (uint8_t*) &memBlock[0], 1);
+    
+    if (cache)
+    {
+        shadowReg[reg] = memBlock[0];
+        shadowValid |= (1 << reg);
+    }
+    
     return memBlock[0];
 }
 
+void advancedIO_begin(void)
+{
+    //Start with an empty write-back buffer
+    shadowValid = 0;
+    shadowDirty = 0;
+    batchActive = true;
+}
+
+bool advancedIO_commit(void)
+{
+    bool success = true;
+    uint8_t reg = ADV_IO_TRISx;
+    
+    batchActive = false;
+    
+    //A burst from TRISx writes it before LATx. If both changed, write LATx first,
+    //so pins that become outputs drive the new value instead of the old one
+    if ((shadowDirty & (1 << ADV_IO_TRISx)) && (shadowDirty & (1 << ADV_IO_LATx)))
+    {
+        burstBlock[0] = ADV_IO_LATx;
+        burstBlock[1] = shadowReg[ADV_IO_LATx];
+        
+        if (!I2C_sendBytes(ADVANCED_IO_I2C_ADDR, &burstBlock[0], 2))
+        {
+            success = false;
+        }
+        
+        //Still valid, so the TRISx burst below may bridge over it with the same value
+        shadowDirty &= ~(1 << ADV_IO_LATx);
+    }
+    
+    while (reg < ADV_IO_REG_COUNT)
+    {
+        if (!(shadowDirty & (1 << reg)))
+        {
+            reg++;
+            continue;
+        }
+        
+        //Start a burst at the 1st dirty register (expander auto-increments)
+        uint8_t start = reg;
+        uint8_t end = reg;
+        
+        while (end < ADV_IO_REG_COUNT)
+        {
+            //Extend over dirty registers
+            while ((end + 1 < ADV_IO_REG_COUNT) && (shadowDirty & (1 << (end + 1))))
+            {
+                end++;
+            }
+            
+            //Bridge a short run of known, unchanged registers if another dirty register follows
+            uint8_t next = end + 1;
+            while ((next < ADV_IO_REG_COUNT) && (next - end <= ADV_IO_MAX_BRIDGE)
+                    && advancedIO_isCacheable(next) && (shadowValid & (1 << next))
+                    && !(shadowDirty & (1 << next)))
+            {
+                next++;
+            }
+            
+            if ((next < ADV_IO_REG_COUNT) && (next - end <= ADV_IO_MAX_BRIDGE + 1)
+                    && (shadowDirty & (1 << next)))
+            {
+                end = next;
+            }
+            else
+            {
+                break;
+            }
+        }
+        
+        //1st Byte is address inside the expander, followed by the values
+        burstBlock[0] = start;
+        for (uint8_t i = start; i <= end; i++)
+        {
+            burstBlock[1 + i - start] = shadowReg[i];
+        }
+        
+        //Send the whole run as one transaction
+        if (!I2C_sendBytes(ADVANCED_IO_I2C_ADDR, &burstBlock[0], (end - start) + 2))
+        {
+            success = false;
+        }
+        
+        reg = end + 1;
+    }
+    
+    shadowValid = 0;
+    shadowDirty = 0;
+    
+    return success;
+}
+
 uint8_t advancedIO_getPinState(void)
 {
-    I2C_registerWriteRead(ADVANCED_IO_I2C_ADDR, ADV_IO_PORTx, &memBlock[0], 1);
+    I2C_registerWriteRead(ADVANCED_IO_I2C_ADDR, ADV_IO_PORTx, (uint8_t*) &memBlock[0], 1);
     return memBlock[0];
 }
 
@@ -92,38 +270,138 @@ void advancedIO_setPinsAsOutputs(uint8_t mask)
     advancedIO_setRegister(ADV_IO_TRISx, value);
 }
 
-void advancedIO_resetToDefault(void)
+//Sets the SET bits and clears the CLR bits of REG
+//No access if nothing changes, and no read if every bit is written
+static void advancedIO_updateRegister(ADVANCED_IO_REGISTER reg, uint8_t set, uint8_t clr)
 {
-    //Setup Command
-    memBlock[0] = MEM_OP_ADDR;
-    memBlock[1] = 0x00;     //Reset to default
-    memBlock[2] = MEM_UNLOCK_1;
-    memBlock[3] = MEM_UNLOCK_2;
+    uint8_t written = set | clr;
     
-    //Send I2C Command
-    I2C_sendBytes(ADVANCED_IO_I2C_ADDR, &memBlock[0], 4);
+    if (written == 0x00)
+    {
+        return;
+    }
     
-    //Clear Memory Block (to prevent accidental double send)
-    memBlock[0] = 0x00;
-    memBlock[1] = 0x00;
-    memBlock[2] = 0x00;
-    memBlock[3] = 0x00;
+    uint8_t value = 0x00;
+    
+    if (written != 0xFF)
+    {
+        value = advancedIO_getRegister(reg);
+    }
+    
+    value = (value & ~clr) | set;
+    
+    advancedIO_setRegister(reg, value);
 }
 
-void advancedIO_performMemoryOP(ADVANCED_IO_MEMORY_OP op)
+bool advancedIO_applyPinGroup(const ADVANCED_IO_PIN_GROUP* group)
 {
+    //Join a batch in progress, or batch the registers of this group
+    bool ownBatch = !batchActive;
+    
+    if (ownBatch)
+    {
+        advancedIO_begin();
+    }
+    
+    //The commit writes LATx, then TRISx, then WPUx - new outputs never drive a stale value
+    advancedIO_updateRegister(ADV_IO_LATx, group->latSet, group->latClr);
+    advancedIO_updateRegister(ADV_IO_TRISx, group->trisSet, group->trisClr);
+    advancedIO_updateRegister(ADV_IO_WPUx, group->wpuSet, group->wpuClr);
+    
+    if (!ownBatch)
+    {
+        return true;
+    }
+    
+    return advancedIO_commit();
+}
+
+//Sends the unlock sequence for a memory operation and arms completion monitoring
+static ADVANCED_IO_MEMORY_STATUS advancedIO_startMemoryOP(uint8_t opCode)
+{
+    if (memOpStatus == ADV_IO_MEM_PENDING)
+    {
+        //Only one memory operation can be in flight
+        return ADV_IO_MEM_ERROR;
+    }
+    
     //Setup Command
     memBlock[0] = MEM_OP_ADDR;
-    memBlock[1] = op.opCode;
+    memBlock[1] = opCode;
     memBlock[2] = MEM_UNLOCK_1;
     memBlock[3] = MEM_UNLOCK_2;
     
+#ifdef ADV_IO_USE_INT_PIN
+    //Clear any stale edge before starting
+    ADV_IO_INT_IOCF = 0;
+#endif
+    
     //Send I2C Command
-    I2C_sendBytes(ADVANCED_IO_I2C_ADDR, &memBlock[0], 4);
+    bool sent = I2C_sendBytes(ADVANCED_IO_I2C_ADDR, (uint8_t*) &memBlock[0], 4);
     
     //Clear Memory Block (to prevent accidental double send)
     memBlock[0] = 0x00;
     memBlock[1] = 0x00;
     memBlock[2] = 0x00;
     memBlock[3] = 0x00;
-}
\ No newline at end of file
+    
+    //Time since the command was sent, accumulated on each status check
+    memOpStamp = Power_getTicks();
+    memOpTicks = 0;
+    memOpStatus = (sent) ? ADV_IO_MEM_PENDING : ADV_IO_MEM_ERROR;
+    
+    return memOpStatus;
+}
+
+ADVANCED_IO_MEMORY_STATUS advancedIO_resetToDefault(void)
+{
+    //Reset to default
+    return advancedIO_startMemoryOP(0x00);
+}
+
+ADVANCED_IO_MEMORY_STATUS advancedIO_performMemoryOP(ADVANCED_IO_MEMORY_OP op)
+{
+    return advancedIO_startMemoryOP(op.opCode);
+}
+
+ADVANCED_IO_MEMORY_STATUS advancedIO_getMemoryOPStatus(void)
+{
+    if (memOpStatus != ADV_IO_MEM_PENDING)
+    {
+        return memOpStatus;
+    }
+    
+#ifdef ADV_IO_USE_INT_PIN
+    //!INT is asserted (falling edge) when the operation finishes
+    bool done = (ADV_IO_INT_IOCF != 0);
+#else
+    //The expander does not respond while the operation is running
+    uint8_t probe;
+    bool done = I2C_readByte(ADVANCED_IO_I2C_ADDR, &probe);
+#endif
+    
+    if (done)
+    {
+#ifdef ADV_IO_USE_INT_PIN
+        ADV_IO_INT_IOCF = 0;
+#endif
+        //Register contents may have changed - drop the values read in a batch
+        //Values written in the batch are kept, and still sent on commit
+        shadowValid = shadowDirty;
+        
+        memOpStatus = ADV_IO_MEM_COMPLETE;
+    }
+    else
+    {
+        uint16_t now = Power_getTicks();
+        memOpTicks += (uint16_t) (now - memOpStamp);
+        memOpStamp = now;
+        
+        if (memOpTicks >= ((uint32_t) ADV_IO_MEM_OP_TIMEOUT_MS * POWER_TICKS_PER_MS))
+        {
+            memOpStatus = ADV_IO_MEM_TIMEOUT;
+        }
+    }
+    
+    return memOpStatus;
+}
@@ -28,6 +28,7 @@ extern "C" {
 #endif
     
 #include <stdint.h>
+#include <stdbool.h>
     
     //Available registers to access in the Advanced IO Expander
     typedef enum {
@@ -68,9 +69,42 @@ extern "C" {
 #define ADV_IO_OP_SAVE          0b01
 #define ADV_IO_OP_LOAD          0b10
 #define ADV_IO_OP_SAVE_LOAD     0b11
+    
+    //Status of a memory operation on the IO Expander
+    typedef enum {
+        ADV_IO_MEM_IDLE = 0, ADV_IO_MEM_PENDING, ADV_IO_MEM_COMPLETE,
+        ADV_IO_MEM_TIMEOUT, ADV_IO_MEM_ERROR
+    } ADVANCED_IO_MEMORY_STATUS;
+
+    //Precomputed register updates for a group of pins (see ADV_IO_PIN_GROUP)
+    typedef struct {
+        uint8_t latSet, latClr;
+        uint8_t trisSet, trisClr;
+        uint8_t wpuSet, wpuClr;
+    } ADVANCED_IO_PIN_GROUP;
+    
+//Mask of IO Expander pin N (0 - 7)
+#define ADV_IO_PIN(n) ((uint8_t) (1 << (n)))
+    
+//Builds an ADVANCED_IO_PIN_GROUP at compile time from pin masks
+//OUTHIGH/OUTLOW are outputs driven HIGH/LOW, INPULLUP/INFLOAT are inputs with/without the weak pull-up
+//Pins in none of the masks are not changed
+#define ADV_IO_PIN_GROUP(outHigh, outLow, inPullup, inFloat) {                  \
+        (outHigh), (outLow),                                                    \
+        ((inPullup) | (inFloat)), ((outHigh) | (outLow)),                       \
+        (inPullup), (inFloat)                                                   \
+    }
 
 //I2C Address to Use
 #define ADVANCED_IO_I2C_ADDR 0x60
+    
+//If defined, the !INT line of the IO Expander (RB4) signals completion of memory operations
+//If commented out, completion is detected by polling the IO Expander for an ACK
+#define ADV_IO_USE_INT_PIN
+    
+//Time after which a memory operation times out, in ms (requires Power_init)
+//advancedIO_getMemoryOPStatus must be called at least every 130 ms while the operation is pending
+#define ADV_IO_MEM_OP_TIMEOUT_MS 100
         
     /**
      * <b><FONT COLOR=BLUE>void</FONT> advancedIO_init(<FONT COLOR=BLUE>void</FONT>)</B>
@@ -88,6 +122,17 @@ extern "C" {
      */
     void advancedIO_setRegister(ADVANCED_IO_REGISTER reg, uint8_t value);
     
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> advancedIO_setRegisterBroadcast(<FONT COLOR=BLUE>ADVANCED_IO_REGISTER</FONT> reg, <FONT COLOR=BLUE>uint8_t</FONT> value)</B>
+     * @param ADVANCED_IO_REGISTER reg - Register to access
+     * @param uint8_t value - data to write
+     * 
+     * This function sets a register in every IO Expander on the bus with a single General Call write.
+     * All expanders latch the new value at the same time. Returns false if no device ACKed.
+     * Warning: the expanders must be configured to respond to the General Call address.
+     */
+    bool advancedIO_setRegisterBroadcast(ADVANCED_IO_REGISTER reg, uint8_t value);
+    
     /**
      * <b><FONT COLOR=BLUE>uint8_t</FONT> advancedIO_getRegister(<FONT COLOR=BLUE>ADVANCED_IO_REGISTER</FONT> reg)</B>
      * @param ADVANCED_IO_REGISTER reg - Register to access
@@ -148,25 +193,70 @@ extern "C" {
     void advancedIO_setPinsAsOutputs(uint8_t mask);
     
     /**
-     * <b><FONT COLOR=BLUE>void</FONT> advancedIO_resetToDefault(<FONT COLOR=BLUE>void</FONT>)</B>
+     * <b><FONT COLOR=BLUE>void</FONT> advancedIO_begin(<FONT COLOR=BLUE>void</FONT>)</B>
      * 
-     * This function resets the IO Expander to compile time defaults.
-     * Warning: !INT monitoring must be used with this function.
+     * This function starts a batch of register updates. Until advancedIO_commit is called,
+     * writes to TRISx, LATx, IOCxP, IOCxN, WPUx, INLVLx, ODCONx and SLRCONx are held in a local 
+     * write-back buffer, and each register is read from the IO Expander at most once.
+     * PORTx and IOCx are always accessed directly.
+     */
+    void advancedIO_begin(void);
+    
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> advancedIO_commit(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * This function ends a batch of register updates and writes the changed registers to the
+     * IO Expander. Adjacent registers are written in a single auto-incrementing burst.
+     * If both LATx and TRISx changed, LATx is written first, so new outputs never drive the old value.
+     * Returns false if any write was not ACKed.
+     */
+    bool advancedIO_commit(void);
+    
+    /**
+     * <b><FONT COLOR=BLUE>bool</FONT> advancedIO_applyPinGroup(<FONT COLOR=BLUE>const ADVANCED_IO_PIN_GROUP*</FONT> group)</B>
+     * @param const ADVANCED_IO_PIN_GROUP* group - Pin group built with ADV_IO_PIN_GROUP
+     * 
+     * This function applies a pin group with the fewest transactions. Registers with no changes are not
+     * accessed, and registers where every bit is set or cleared are written without being read.
+     * Changes are committed together, unless called between advancedIO_begin and advancedIO_commit.
+     * The commit writes LATx before TRISx, and TRISx before WPUx.
+     * Returns false if any write was not ACKed.
+     */
+    bool advancedIO_applyPinGroup(const ADVANCED_IO_PIN_GROUP* group);
+    
+    /**
+     * <b><FONT COLOR=BLUE>ADVANCED_IO_MEMORY_STATUS</FONT> advancedIO_resetToDefault(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * This function starts a reset of the IO Expander to compile time defaults and returns immediately.
+     * Returns ADV_IO_MEM_PENDING if started, or ADV_IO_MEM_ERROR if the command was not ACKed or 
+     * another memory operation is still pending. Use advancedIO_getMemoryOPStatus to wait for completion.
      * 
      * Consult the IO Expander documentation for more information.
      */
-    void advancedIO_resetToDefault(void);
+    ADVANCED_IO_MEMORY_STATUS advancedIO_resetToDefault(void);
     
     /**
-     * <b><FONT COLOR=BLUE>void</FONT> advancedIO_performMemoryOP(<FONT COLOR=BLUE>ADVANCED_IO_MEMORY_OP</FONT> op)</B>
+     * <b><FONT COLOR=BLUE>ADVANCED_IO_MEMORY_STATUS</FONT> advancedIO_performMemoryOP(<FONT COLOR=BLUE>ADVANCED_IO_MEMORY_OP</FONT> op)</B>
      * @param ADVANCED_IO_MEMORY_OP op - Memory Operation to Execution
      * 
-     * This function executes a memory operation on the IO Expander (Save/Load/Save+Load/Reset).
-     * Warning: !INT monitoring must be used with this function.
+     * This function starts a memory operation on the IO Expander (Save/Load/Save+Load/Reset) and returns immediately.
+     * Returns ADV_IO_MEM_PENDING if started, or ADV_IO_MEM_ERROR if the command was not ACKed or 
+     * another memory operation is still pending. Use advancedIO_getMemoryOPStatus to wait for completion.
      * 
      * Consult the IO Expander documentation for more information.
      */
-    void advancedIO_performMemoryOP(ADVANCED_IO_MEMORY_OP op);
+    ADVANCED_IO_MEMORY_STATUS advancedIO_performMemoryOP(ADVANCED_IO_MEMORY_OP op);
+    
+    /**
+     * <b><FONT COLOR=BLUE>ADVANCED_IO_MEMORY_STATUS</FONT> advancedIO_getMemoryOPStatus(<FONT COLOR=BLUE>void</FONT>)</B>
+     * 
+     * This function checks the memory operation in flight and returns its status. Completion is detected 
+     * from the !INT line (IOC flag) or, without ADV_IO_USE_INT_PIN, by polling the IO Expander for an ACK.
+     * If not complete ADV_IO_MEM_OP_TIMEOUT_MS after it started, ADV_IO_MEM_TIMEOUT is returned.
+     * On completion, register values read in an open batch are discarded, as a Load may have changed them.
+     * Values written in the batch are kept and sent by advancedIO_commit.
+     */
+    ADVANCED_IO_MEMORY_STATUS advancedIO_getMemoryOPStatus(void);
     
 #ifdef	__cplusplus
 }
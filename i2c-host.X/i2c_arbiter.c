@@ -0,0 +1,234 @@
+#include "i2c_arbiter.h"
+#include "i2c_host.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if (I2C_ARBITER_QUEUE_SIZE & (I2C_ARBITER_QUEUE_SIZE - 1)) != 0
+#error "I2C_ARBITER_QUEUE_SIZE must be a power of 2"
+#endif
+
+#define I2C_ARBITER_QUEUE_MASK (I2C_ARBITER_QUEUE_SIZE - 1)
+
+//A queued request and its progress
+typedef struct {
+    I2C_ArbiterRequest request;
+    uint32_t submitted;
+    uint16_t offset;
+    bool failed;
+} I2C_ArbiterEntry;
+
+//Single producer, single consumer ring per class
+//HEAD is only written by submit, TAIL only by service
+typedef struct {
+    I2C_ArbiterEntry entries[I2C_ARBITER_QUEUE_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} I2C_ArbiterQueue;
+
+static I2C_ArbiterQueue queues[I2C_ARB_CLASS_COUNT];
+
+static uint32_t (*timeSource)(void) = 0;
+
+static uint16_t deadlineMisses = 0;
+static uint32_t worstUrgentLatency = 0;
+
+//Register address followed by 1 chunk of data
+static uint8_t chunkBlock[I2C_ARBITER_CHUNK + 1];
+
+//Returns the current time, or 0 if no time source is assigned
+//32 bits, so a request that waits longer than a 16-bit timer period is still timed correctly
+static uint32_t I2C_Arbiter_now(void)
+{
+    if (timeSource == 0)
+    {
+        return 0;
+    }
+    return timeSource();
+}
+
+//Runs the next transaction of ENTRY. Returns true once the request is complete
+static bool I2C_Arbiter_runChunk(I2C_ArbiterEntry* entry)
+{
+    I2C_ArbiterRequest* request = &entry->request;
+    uint16_t remaining = request->len - entry->offset;
+    uint8_t chunk = (remaining > I2C_ARBITER_CHUNK) ? I2C_ARBITER_CHUNK : (uint8_t) remaining;
+    uint8_t* data = &request->data[entry->offset];
+    uint8_t reg = request->regAddr + (uint8_t) entry->offset;
+    bool success = true;
+    
+    switch (request->op)
+    {
+        case I2C_ARB_WRITE:
+        {
+            //A raw write cannot be split without changing its meaning
+            chunk = (uint8_t) remaining;
+            success = I2C_sendBytes(request->addr, data, chunk);
+            break;
+        }
+        case I2C_ARB_READ:
+        {
+            //The client continues from the last byte read
+            success = I2C_readBytes(request->addr, data, chunk);
+            break;
+        }
+        case I2C_ARB_REG_WRITE:
+        {
+            //1st Byte is the register address of this chunk
+            chunkBlock[0] = reg;
+            for (uint8_t i = 0; i < chunk; i++)
+            {
+                chunkBlock[1 + i] = data[i];
+            }
+            success = I2C_sendBytes(request->addr, &chunkBlock[0], chunk + 1);
+            break;
+        }
+        case I2C_ARB_REG_READ:
+        {
+            success = I2C_registerWriteRead(request->addr, reg, data, chunk);
+            break;
+        }
+        default:
+        {
+            success = false;
+            break;
+        }
+    }
+    
+    entry->offset += chunk;
+    
+    if (!success)
+    {
+        entry->failed = true;
+        return true;
+    }
+    
+    return (entry->offset >= request->len);
+}
+
+//Initializes the arbiter. GETTIME returns an accumulated 32-bit tick count
+void I2C_Arbiter_init(uint32_t (*getTime)(void))
+{
+    timeSource = getTime;
+    
+    for (uint8_t i = 0; i < I2C_ARB_CLASS_COUNT; i++)
+    {
+        queues[i].head = 0;
+        queues[i].tail = 0;
+    }
+    
+    I2C_Arbiter_clearStats();
+}
+
+//Queues a copy of REQUEST in the priority class CLS
+//Returns false if the queue is full or the request is invalid
+bool I2C_Arbiter_submit(I2C_ArbiterClass cls, const I2C_ArbiterRequest* request)
+{
+    if (cls >= I2C_ARB_CLASS_COUNT)
+    {
+        return false;
+    }
+    
+    if ((request->len == 0) || ((request->op == I2C_ARB_WRITE) && (request->len > 0xFF)))
+    {
+        return false;
+    }
+    
+    I2C_ArbiterQueue* queue = &queues[cls];
+    uint8_t head = queue->head;
+    uint8_t next = (head + 1) & I2C_ARBITER_QUEUE_MASK;
+    
+    if (next == queue->tail)
+    {
+        return false;
+    }
+    
+    //Fill the entry, then publish it by advancing HEAD
+    I2C_ArbiterEntry* entry = &queue->entries[head];
+    entry->request = *request;
+    entry->submitted = I2C_Arbiter_now();
+    entry->offset = 0;
+    entry->failed = false;
+    
+    if (request->status != 0)
+    {
+        *request->status = I2C_ARB_PENDING;
+    }
+    
+    queue->head = next;
+    return true;
+}
+
+//Runs one transaction of the highest priority request
+//Returns true if requests are still waiting
+bool I2C_Arbiter_service(void)
+{
+    I2C_ArbiterClass cls = I2C_ARB_URGENT;
+    
+    //Highest priority class with a request waiting
+    while ((cls < I2C_ARB_CLASS_COUNT) && (queues[cls].head == queues[cls].tail))
+    {
+        cls++;
+    }
+    
+    if (cls >= I2C_ARB_CLASS_COUNT)
+    {
+        return false;
+    }
+    
+    I2C_ArbiterQueue* queue = &queues[cls];
+    I2C_ArbiterEntry* entry = &queue->entries[queue->tail];
+    
+    if (I2C_Arbiter_runChunk(entry))
+    {
+        uint32_t latency = I2C_Arbiter_now() - entry->submitted;
+        
+        if (latency > entry->request.deadline)
+        {
+            deadlineMisses++;
+        }
+        
+        if ((cls == I2C_ARB_URGENT) && (latency > worstUrgentLatency))
+        {
+            worstUrgentLatency = latency;
+        }
+        
+        if (entry->request.status != 0)
+        {
+            *entry->request.status = (entry->failed) ? I2C_ARB_FAILED : I2C_ARB_DONE;
+        }
+        
+        //Release the entry to the producer
+        queue->tail = (queue->tail + 1) & I2C_ARBITER_QUEUE_MASK;
+    }
+    
+    //Check if anything is left
+    for (cls = I2C_ARB_URGENT; cls < I2C_ARB_CLASS_COUNT; cls++)
+    {
+        if (queues[cls].head != queues[cls].tail)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+//Returns the number of requests that completed after their deadline since the last clear
+uint16_t I2C_Arbiter_getDeadlineMisses(void)
+{
+    return deadlineMisses;
+}
+
+//Returns the longest urgent request latency (submit to completion), in ticks
+uint32_t I2C_Arbiter_getWorstUrgentLatency(void)
+{
+    return worstUrgentLatency;
+}
+
+//Clears the deadline miss count and worst latency
+void I2C_Arbiter_clearStats(void)
+{
+    deadlineMisses = 0;
+    worstUrgentLatency = 0;
+}
@@ -0,0 +1,71 @@
+#ifndef I2C_ARBITER_H
+#define	I2C_ARBITER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//Requests held per priority class (power of 2)
+#define I2C_ARBITER_QUEUE_SIZE 4
+    
+//Largest number of data bytes moved in one transaction. Longer requests are split
+#define I2C_ARBITER_CHUNK 16
+    
+    //Priority classes - urgent requests run at the next transaction boundary
+    typedef enum {
+        I2C_ARB_URGENT = 0, I2C_ARB_BULK, I2C_ARB_CLASS_COUNT
+    } I2C_ArbiterClass;
+    
+    //Bus operations
+    typedef enum {
+        I2C_ARB_WRITE = 0,      //Raw write, in 1 transaction (LEN <= 255, not split)
+        I2C_ARB_READ,           //Raw read, split into current address reads
+        I2C_ARB_REG_WRITE,      //Write starting at REGADDR, split by register address
+        I2C_ARB_REG_READ        //Read starting at REGADDR, split by register address
+    } I2C_ArbiterOp;
+    
+    //Progress of a request
+    typedef enum {
+        I2C_ARB_PENDING = 0, I2C_ARB_DONE, I2C_ARB_FAILED
+    } I2C_ArbiterStatus;
+    
+    //A queued bus request. DATA must remain valid until the request completes
+    typedef struct {
+        I2C_ArbiterOp op;
+        uint8_t addr;
+        uint8_t regAddr;
+        uint8_t* data;
+        uint16_t len;
+        uint32_t deadline;                  //Ticks allowed from submit to completion
+        volatile I2C_ArbiterStatus* status; //Updated on completion, or NULL
+    } I2C_ArbiterRequest;
+    
+    //Initializes the arbiter. GETTIME returns an accumulated 32-bit tick count (such as Power_getTime)
+    void I2C_Arbiter_init(uint32_t (*getTime)(void));
+    
+    //Queues a copy of REQUEST in the priority class CLS
+    //Safe to call from one ISR or the main loop per class. Returns false if the queue is full or the request is invalid
+    bool I2C_Arbiter_submit(I2C_ArbiterClass cls, const I2C_ArbiterRequest* request);
+    
+    //Runs one transaction of the highest priority request. Call from the main loop
+    //Returns true if requests are still waiting
+    bool I2C_Arbiter_service(void);
+    
+    //Returns the number of requests that completed after their deadline since the last clear
+    uint16_t I2C_Arbiter_getDeadlineMisses(void);
+    
+    //Returns the longest urgent request latency (submit to completion), in ticks
+    uint32_t I2C_Arbiter_getWorstUrgentLatency(void);
+    
+    //Clears the deadline miss count and worst latency
+    void I2C_Arbiter_clearStats(void);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_ARBITER_H */
+
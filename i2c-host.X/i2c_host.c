@@ -5,6 +5,179 @@
 
 #include "i2c_host.h"
 
+//Only built into firmware that uses this role (see i2c_config.h)
+#if I2C_ROLE_HOST
+
+#ifdef I2C_HOST_LOW_POWER
+#include "power.h"
+#endif
+
+//Number of transactions started (a Repeated Start does not begin a new transaction)
+static uint16_t transactionCount = 0;
+
+//Number of transactions repeated after a lost arbitration or a busy bus
+static uint16_t retryCount = 0;
+
+//Reason the last transaction failed
+static I2C_HostError lastError = I2C_HOST_OK;
+
+//Backoff LFSR state - must never be 0
+static uint16_t backoffState = I2C_BACKOFF_SEED;
+
+//Called while a transfer waits for the module
+static void (*waitCallback)(void) = 0;
+
+//Clears latched event flags so the CPU only wakes on new events
+static void I2C_clearEvents(void)
+{
+#ifdef I2C_HOST_LOW_POWER
+    I2C1PIR = 0x00;
+#endif
+}
+
+//Idles the CPU until the I2C module needs service
+static void I2C_idleUntilEvent(void)
+{
+    //Other work, such as a software bus, runs while I2C1 shifts the byte
+    if (waitCallback != 0)
+    {
+        waitCallback();
+    }
+    
+#ifdef I2C_HOST_LOW_POWER
+    //Count and Stop flags stay set once handled, and would end IDLE at once - clear them first
+    I2C1PIR = 0x00;
+    
+    //Check again after the clear, so an event in between is not slept through
+    if ((I2C1STAT0bits.MMA) && (!I2C1CON0bits.MDR) && (!I2C1STAT1bits.RXBF))
+    {
+        Power_idle();
+    }
+#endif
+}
+
+//Selects if an empty I2C1TXB wakes the CPU
+//The flag stays set while TXB is empty, so it is only enabled while bytes are left to load
+static void I2C_wakeOnTransmit(bool enable)
+{
+#ifdef I2C_HOST_LOW_POWER
+    PIE7bits.I2C1TXIE = enable;
+#endif
+}
+
+//Waits for the bus to be idle before a Start. Returns false if another host keeps it busy
+static bool I2C_waitForBusFree(void)
+{
+    uint16_t polls = I2C_BUS_FREE_POLLS;
+    
+    //BFRE is set once SCL and SDA have been high for the bus free time
+    while (!I2C1STAT0bits.BFRE)
+    {
+        if (polls == 0)
+        {
+            return false;
+        }
+        polls--;
+    }
+    
+    return true;
+}
+
+//Prepares the module for a new transaction
+//Returns false (I2C_HOST_BUSY) if the bus did not become free
+static bool I2C_beginTransfer(void)
+{
+    if (!I2C_waitForBusFree())
+    {
+        lastError = I2C_HOST_BUSY;
+        return false;
+    }
+    
+    I2C_clearEvents();
+    transactionCount++;
+    
+    //Reset Status and Error (keep the error interrupt enables)
+    I2C1STAT1 = 0x00;
+    I2C1ERRbits.BTOIF = 0;
+    I2C1ERRbits.BCLIF = 0;
+    I2C1ERRbits.NACKIF = 0;
+    
+    return true;
+}
+
+//Records why a transaction ended. SUCCESS is the transfer's own completion check
+static bool I2C_endTransfer(bool success)
+{
+    if (I2C1ERRbits.BCLIF)
+    {
+        //Lost arbitration - the other host owns the bus, flush any stale data
+        I2C1STAT1bits.CLRBF = 1;
+        lastError = I2C_HOST_COLLISION;
+        return false;
+    }
+    
+    if (success)
+    {
+        lastError = I2C_HOST_OK;
+    }
+    else if (I2C1ERRbits.BTOIF)
+    {
+        lastError = I2C_HOST_TIMEOUT;
+    }
+    else
+    {
+        lastError = I2C_HOST_NACK;
+    }
+    
+    return success;
+}
+
+//Advances the 16-bit Galois LFSR used for backoff
+static uint16_t I2C_nextRandom(void)
+{
+    bool lsb = (backoffState & 0x0001);
+    backoffState >>= 1;
+    
+    if (lsb)
+    {
+        backoffState ^= 0xB400;
+    }
+    
+    return backoffState;
+}
+
+//Checks if a failed transaction should be repeated. If so, waits a random time first
+//Only arbitration losses and a busy bus are retried - NACKs and timeouts are returned to the caller
+static bool I2C_retryAfterBackoff(uint8_t* attempt)
+{
+    if ((lastError != I2C_HOST_COLLISION) && (lastError != I2C_HOST_BUSY))
+    {
+        return false;
+    }
+    
+    if (*attempt >= I2C_ARBITRATION_RETRIES)
+    {
+        return false;
+    }
+    
+    (*attempt)++;
+    retryCount++;
+    
+    //Random number of slots, in a window that doubles after each lost attempt
+    uint8_t slots = I2C_nextRandom() & ((0x04 << *attempt) - 1);
+    
+    while (slots > 0)
+    {
+        for (uint8_t i = 0; i < I2C_BACKOFF_SLOT_LOOPS; i++)
+        {
+            NOP();
+        }
+        slots--;
+    }
+    
+    return true;
+}
+
 //Initializes the I2C Module in Host Mode
 //I/O is configured seperately
 void I2C_initHost(void)
@@ -40,60 +213,27 @@ void I2C_initHost(void)
     //BTO is configured separately
     I2C1BTO = 0x00;
     
+#ifdef I2C_HOST_LOW_POWER
+    //Enable wake-up sources - Stop, Count = 0, NACK, Bus Timeout and Bus Collision
+    //GIE is not set, so these wake the CPU from IDLE without vectoring
+    I2C1PIEbits.PCIE = 1;
+    I2C1PIEbits.CNTIE = 1;
+    I2C1ERRbits.NACKIE = 1;
+    I2C1ERRbits.BTOIE = 1;
+    I2C1ERRbits.BCLIE = 1;
+    
+    PIE7bits.I2C1IE = 1;
+    PIE7bits.I2C1EIE = 1;
+    PIE7bits.I2C1RXIE = 1;
+    
+    //TX wake-up is enabled by each transfer, while it has bytes to load
+    PIE7bits.I2C1TXIE = 0;
+#endif
+    
     //Enable I2C Module
     I2C1CON0bits.EN = 1;
 }
 
-//Initialize the bus timeout feature
-void I2C_initBTO(bool reset, bool prescale, uint8_t timeout, I2C_BTO_Clock clock)
-{
-    I2C1BTO = (reset << 7) | (prescale << 6) | (0x3F & timeout);
-    I2C1BTOC = clock;
-}
-
-//Initializes the I/O pins for I2C
-void I2C_initPins(void)
-{
-    //RC3 - SCL
-    //RC4 - SDA
-    
-    //Disable Analog Inputs
-    ANSELCbits.ANSELC3 = 0;
-    ANSELCbits.ANSELC4 = 0;
-    
-    //Configure as Open-Drain
-    ODCONCbits.ODCC3 = 1;
-    ODCONCbits.ODCC4 = 1;
-    
-    //Set as Outputs
-    TRISC3 = 0;
-    TRISC4 = 0;
-    
-    //Set PPS Outputs
-    I2C1SCLPPS = 0b010011;
-    I2C1SDAPPS = 0b010100;
-    
-    //Set PPS Inputs
-    RC3PPS = 0x20;
-    RC4PPS = 0x21;
-    
-    //Standard Slew Rate
-    RC3I2Cbits.SLEW = 0b00;
-    RC4I2Cbits.SLEW = 0b00;
-    
-    //I2C Thresholds
-    RC3I2Cbits.TH = 0b01;
-    RC4I2Cbits.TH = 0b01;
-    
-    //Enable Internal Pullup resistors
-#ifdef USE_INTERNAL_PULLUPS
-    
-    //10x Normal Pullup Strength
-    RC3I2Cbits.PU = 0b10;
-    RC4I2Cbits.PU = 0b10;
-#endif
-}
-
 //Attempts to send 1 byte of DATA to a device at ADDR
 //Returns true if successful, or false if an error occurred
 bool I2C_sendByte(uint8_t addr, uint8_t data)
@@ -117,22 +257,23 @@ uint8_t I2C_readByteNoWarn(uint8_t addr)
     return data;
 }
 
-//Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads LEN bytes to READDATA
-//Returns true if successful, or false if an error occurred
-bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t len)
+//Single attempt of I2C_writeRead
+static bool I2C_writeReadOnce(uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen)
 {    
+    if (!I2C_beginTransfer())
+    {
+        return false;
+    }
+    
     //Load Address
     I2C1ADB1 = (addr << 1);
     
-    //Load Data Byte
-    I2C1TXB = regAddr;
+    //Load 1st Byte
+    I2C1TXB = writeData[0];
+    I2C_wakeOnTransmit(writeLen > 1);
     
     //Set Data Length
-    I2C1CNTL = 1;
-
-    //Reset Status and Error
-    I2C1STAT1 = 0x00;
-    I2C1ERR = 0x00;
+    I2C1CNTL = writeLen;
         
     //Set Restart Enable
     I2C1CON0bits.RSEN = 1;
@@ -140,7 +281,12 @@ bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uin
     //Start Communication
     I2C1CON0bits.S = 1;
     
+    uint8_t writeIndex = 1;
     uint8_t index = 0;
+    bool restarted = false;
+    
+    //Read address for the Repeated Start (written directly, no read-modify-write)
+    uint8_t readAddr = (addr << 1) | 0b1;
     
     //Wait for Start!
     while (I2C1CON0bits.S);
@@ -156,13 +302,23 @@ bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uin
                 readData[index] = I2C1RXB;
                 index++;
             }
-            else
+            else if ((!restarted) && (writeIndex < writeLen))
+            {
+                if (I2C1STAT1bits.TXBE)
+                {
+                    //Load next byte
+                    I2C1TXB = writeData[writeIndex];
+                    writeIndex++;
+                    I2C_wakeOnTransmit(writeIndex < writeLen);
+                }
+            }
+            else if ((!restarted) && (I2C1CNTL == 0))
             {
-                //Set Read address
-                I2C1ADB1 |= 0b1;
+                //Write phase done - set Read address
+                I2C1ADB1 = readAddr;
                 
                 //Set # of Bytes
-                I2C1CNTL = len;
+                I2C1CNTL = readLen;
 
                 //Start Communication
                 I2C1CON0bits.S = 1;
@@ -172,10 +328,16 @@ bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uin
 
                 //Clear Restart Flag
                 I2C1CON0bits.RSEN = 0;
+                restarted = true;
                 
+#ifdef I2C_HOST_LOW_POWER
+                //Write phase is done
+                I2C1PIRbits.CNTIF = 0;
+#endif
             }
         }
         
+        I2C_idleUntilEvent();
     }
     
     if (I2C1STAT1bits.RXBF)
@@ -185,19 +347,238 @@ bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uin
         index++;
     }
     
-    return (I2C1CNTL == 0);
+    //Clear Restart Flag, in case arbitration was lost before the Repeated Start
+    I2C1CON0bits.RSEN = 0;
+    
+    return I2C_endTransfer((restarted) && (I2C1CNTL == 0));
 
 }
 
-//Attempts to send LEN bytes of DATA to the I2C with address ADDR
+//Attempts to send WRITELEN bytes of WRITEDATA to the device at ADDR, then restarts and reads READLEN bytes to READDATA
 //Returns true if successful, or false if an error occurred
-bool I2C_sendBytes(uint8_t addr, uint8_t* data, uint8_t len)
+bool I2C_writeRead(uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen)
+{
+    uint8_t attempt = 0;
+    
+    while (!I2C_writeReadOnce(addr, writeData, writeLen, readData, readLen))
+    {
+        if (!I2C_retryAfterBackoff(&attempt))
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+//Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads LEN bytes to READDATA
+//Returns true if successful, or false if an error occurred
+bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t len)
+{
+    return I2C_writeRead(addr, &regAddr, 1, readData, len);
+}
+
+//Single attempt of I2C_registerReadBlock
+//Returns true if the bus transfer succeeded, even if the block was larger than MAXLEN
+static bool I2C_registerReadBlockOnce(uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t maxLen, uint8_t* len)
 {
+    *len = 0;
+    
+    if (!I2C_beginTransfer())
+    {
+        return false;
+    }
+    
+    uint8_t readAddr = (addr << 1) | 0b1;
+    
+    //Load Address
+    I2C1ADB1 = (addr << 1);
+    
+    //Load Data Byte
+    I2C1TXB = regAddr;
+    I2C_wakeOnTransmit(false);
+    
+    //Set Data Length
+    I2C1CNTL = 1;
+    
+    //Set Restart Enable
+    I2C1CON0bits.RSEN = 1;
+    
+    //Start Communication
+    I2C1CON0bits.S = 1;
+    
+    bool first = true;
+    bool restarted = false;
+    uint8_t index = 0;
+    
+    //Wait for Start!
+    while (I2C1CON0bits.S);
+    
+    //While in host mode...
+    while (I2C1STAT0bits.MMA)
+    {
+        if (I2C1STAT1bits.RXBF)
+        {
+            uint8_t data = I2C1RXB;
+            
+            if (first)
+            {
+                //Length byte - already copied into I2C1CNT by the hardware
+                first = false;
+                *len = data;
+            }
+            else
+            {
+                if (index < maxLen)
+                {
+                    readData[index] = data;
+                }
+                index++;
+            }
+        }
+        else if ((!restarted) && (I2C1CON0bits.MDR))
+        {
+            //Write phase done - set Read address
+            I2C1ADB1 = readAddr;
+            
+            //Read the length byte, then let the hardware reload the count
+            I2C1CNTL = 1;
+            I2C1CON2bits.ACNT = 1;
+            
+            //Start Communication
+            I2C1CON0bits.S = 1;
+            
+            //Wait for Start!
+            while (I2C1CON0bits.S);
+            
+            //Clear Restart Flag
+            I2C1CON0bits.RSEN = 0;
+            restarted = true;
+            
+#ifdef I2C_HOST_LOW_POWER
+            //Write phase is done
+            I2C1PIRbits.CNTIF = 0;
+#endif
+        }
+        
+        I2C_idleUntilEvent();
+    }
+    
+    if (I2C1STAT1bits.RXBF)
+    {
+        //Read last byte
+        uint8_t data = I2C1RXB;
+        if (!first && (index < maxLen))
+        {
+            readData[index] = data;
+        }
+        index++;
+    }
+    
+    //Auto-Load OFF for normal transfers
+    I2C1CON2bits.ACNT = 0;
+    
+    //Clear Restart Flag, in case arbitration was lost before the Repeated Start
+    I2C1CON0bits.RSEN = 0;
+    
+    return I2C_endTransfer((restarted) && (!first) && (I2C1CNTL == 0));
+}
+
+//Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads a block
+//The 1st byte returned by the device is the block length, which is auto-loaded into I2C1CNT by hardware
+//Up to MAXLEN bytes are stored in READDATA, and the block length is returned in LEN
+//Returns true if successful, or false if an error occurred or the block was larger than MAXLEN
+bool I2C_registerReadBlock(uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t maxLen, uint8_t* len)
+{
+    uint8_t attempt = 0;
+    
+    while (!I2C_registerReadBlockOnce(addr, regAddr, readData, maxLen, len))
+    {
+        if (!I2C_retryAfterBackoff(&attempt))
+        {
+            return false;
+        }
+    }
+    
+    return (*len <= maxLen);
+}
+
+//Reads the change map at MAPREG, then reads only the changed registers into MIRROR
+bool I2C_readChanged(uint8_t addr, uint8_t mapReg, uint8_t mapLen, uint8_t* mirror, uint8_t size, uint8_t* changed)
+{
+    uint8_t map[I2C_CHANGE_MAP_MAX];
+    
+    if ((mapLen == 0) || (mapLen > I2C_CHANGE_MAP_MAX))
+    {
+        return false;
+    }
+    
+    if (!I2C_registerWriteRead(addr, mapReg, &map[0], mapLen))
+    {
+        return false;
+    }
+    
+    if (changed != 0)
+    {
+        for (uint8_t i = 0; i < mapLen; i++)
+        {
+            changed[i] = map[i];
+        }
+    }
+    
+    uint8_t limit = mapLen * 8;
+    if (limit > size)
+    {
+        limit = size;
+    }
+    
+    uint8_t index = 0;
+    
+    while (index < limit)
+    {
+        if (!(map[index >> 3] & (1 << (index & 0x07))))
+        {
+            index++;
+            continue;
+        }
+        
+        //Extend the range over changed registers, and over gaps of up to I2C_CHANGE_MAX_GAP
+        uint8_t start = index;
+        uint8_t end = index + 1;
+        
+        for (uint8_t next = end; (next < limit) && ((next - end) <= I2C_CHANGE_MAX_GAP); next++)
+        {
+            if (map[next >> 3] & (1 << (next & 0x07)))
+            {
+                end = next + 1;
+            }
+        }
+        
+        if (!I2C_registerWriteRead(addr, start, &mirror[start], end - start))
+        {
+            return false;
+        }
+        
+        index = end;
+    }
+    
+    return true;
+}
+
+//Single attempt of I2C_sendBytes
+static bool I2C_sendBytesOnce(uint8_t addr, uint8_t* data, uint8_t len)
+{
+    if (!I2C_beginTransfer())
+    {
+        return false;
+    }
+    
     //Load Address
     I2C1ADB1 = (addr << 1);
     
     //Load 1st Byte
     I2C1TXB = data[0];
+    I2C_wakeOnTransmit(len > 1);
     
     //Set Data Length
     I2C1CNTL = len;
@@ -226,20 +607,53 @@ bool I2C_sendBytes(uint8_t addr, uint8_t* data, uint8_t len)
                     //Load next byte
                     I2C1TXB = data[index];
                     index++;
+                    I2C_wakeOnTransmit(index < len);
                 }
             }
         }
+        
+        I2C_idleUntilEvent();
     }
         
-    return (I2C1CNTL == 0);
+    return I2C_endTransfer(I2C1CNTL == 0);
 }
 
-//Attempts to read LEN bytes of DATA from the I2C with address ADDR
+//Attempts to send LEN bytes of DATA to the I2C with address ADDR
 //Returns true if successful, or false if an error occurred
-bool I2C_readBytes(uint8_t addr, uint8_t* data, uint8_t len)
+bool I2C_sendBytes(uint8_t addr, uint8_t* data, uint8_t len)
 {
+    uint8_t attempt = 0;
+    
+    while (!I2C_sendBytesOnce(addr, data, len))
+    {
+        if (!I2C_retryAfterBackoff(&attempt))
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+//Attempts to send LEN bytes of DATA to every device listening to the General Call address
+//Returns true if at least one device ACKed, or false if an error occurred
+bool I2C_sendGeneralCall(uint8_t* data, uint8_t len)
+{
+    //General Call is a write to address 0x00 - every enabled client ACKs in parallel
+    return I2C_sendBytes(I2C_GENERAL_CALL_ADDR, data, len);
+}
+
+//Single attempt of I2C_readBytes
+static bool I2C_readBytesOnce(uint8_t addr, uint8_t* data, uint8_t len)
+{
+    if (!I2C_beginTransfer())
+    {
+        return false;
+    }
+    
     //Load Address
     I2C1ADB1 = ((addr << 1) | 0b1);
+    I2C_wakeOnTransmit(false);
     
     //Set Data Length
     I2C1CNTL = len;
@@ -261,8 +675,59 @@ bool I2C_readBytes(uint8_t addr, uint8_t* data, uint8_t len)
             data[index] = I2C1RXB;
             index++;
         }
+        
+        I2C_idleUntilEvent();
+    }
+    
+    return I2C_endTransfer(I2C1CNTL == 0);
+}
+
+//Attempts to read LEN bytes of DATA from the I2C with address ADDR
+//Returns true if successful, or false if an error occurred
+bool I2C_readBytes(uint8_t addr, uint8_t* data, uint8_t len)
+{
+    uint8_t attempt = 0;
+    
+    while (!I2C_readBytesOnce(addr, data, len))
+    {
+        if (!I2C_retryAfterBackoff(&attempt))
+        {
+            return false;
+        }
     }
     
-    return (I2C1CNTL == 0);
+    return true;
+}
+
+//Returns the number of transactions started since the last clear
+uint16_t I2C_getTransactionCount(void)
+{
+    return transactionCount;
+}
+
+//Returns the number of transactions repeated after a collision or busy bus since the last clear
+uint16_t I2C_getRetryCount(void)
+{
+    return retryCount;
+}
+
+//Clears the transaction and retry counters
+void I2C_clearTransactionCount(void)
+{
+    transactionCount = 0;
+    retryCount = 0;
+}
+
+//Returns the reason the last transaction failed, or I2C_HOST_OK if it succeeded
+I2C_HostError I2C_getLastError(void)
+{
+    return lastError;
+}
+
+//This function is called each time a transfer waits for the I2C module
+void I2C_assignWaitHandler(void (*waitHandler)(void))
+{
+    waitCallback = waitHandler;
 }
 
+#endif	/* I2C_ROLE_HOST */
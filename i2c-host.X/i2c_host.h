@@ -29,30 +29,44 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
     
-//If defined, internal pull-up resistors will be used
-#define USE_INTERNAL_PULLUPS
+//Shared pin and bus timeout setup, role selection
+#include "i2c_core.h"
     
-    //Options for Bus Time Out (BTO) Clock Sources
+//If defined, the CPU idles during transfers and wakes on I2C events (requires power.c)
+//Global interrupts must remain disabled, as no I2C ISRs are provided
+//#define I2C_HOST_LOW_POWER
+    
+//Number of times a transaction is repeated after losing arbitration to another host
+#define I2C_ARBITRATION_RETRIES 3
+    
+//Number of polls to wait for the bus to be free before a Start
+#define I2C_BUS_FREE_POLLS 2000
+    
+//Delay loop iterations per backoff slot (~100us, about 1 byte at 100kHz, with Fosc = 1 MHz)
+#define I2C_BACKOFF_SLOT_LOOPS 5
+    
+//Backoff random seed - use a different non-zero value on each host sharing the bus
+#define I2C_BACKOFF_SEED 0xACE1
+    
+#if I2C_BACKOFF_SEED == 0
+#error "I2C_BACKOFF_SEED must not be 0"
+#endif
+    
+//Largest change map read by I2C_readChanged, in bytes (8 registers per byte)
+#define I2C_CHANGE_MAP_MAX 4
+    
+//Unchanged registers read to join 2 changed ranges, instead of starting a new transaction
+#define I2C_CHANGE_MAX_GAP 2
+    
+    //Reason the last transaction failed
     typedef enum {
-        I2C_BTO_TMR2 = 0b0001, I2C_BTO_TMR4, 
-        I2C_TU16A, I2C_TU16B_OUT, I2C_BTO_LFINTOSC, 
-        I2C_BTO_MFINTOSC, I2C_BTO_SOSC
-    } I2C_BTO_Clock;
+        I2C_HOST_OK = 0, I2C_HOST_NACK, I2C_HOST_COLLISION, I2C_HOST_TIMEOUT, I2C_HOST_BUSY
+    } I2C_HostError;
     
     //Initializes the I2C Module in Host Mode
     //I/O is configured seperately
     void I2C_initHost(void);
     
-    //Initialize the bus timeout feature
-    //Reset - enables whether the I2C module should reset on a timeout
-    //Prescale - enables a 32x clock divider for the timeout
-    //Timeout - the number of clock cycles before a timeout. Must be less than 64
-    //Clock - Select the clock source used
-    void I2C_initBTO(bool reset, bool prescale, uint8_t timeout, I2C_BTO_Clock clock);
-    
-    //Initializes the I/O pins for I2C
-    void I2C_initPins(void);
-
     //Attempts to send 1 byte of DATA to a device at ADDR
     //Returns true if successful, or false if an error occurred
     bool I2C_sendByte(uint8_t addr, uint8_t data);
@@ -68,10 +82,46 @@ extern "C" {
     //Returns true if successful, or false if an error occurred
     bool I2C_registerWriteRead(uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t len);
     
+    //Attempts to send WRITELEN bytes of WRITEDATA to the device at ADDR, then restarts and reads READLEN bytes to READDATA
+    //WRITELEN and READLEN must be at least 1. Returns true if successful, or false if an error occurred
+    bool I2C_writeRead(uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen);
+    
+    //Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads a block
+    //The 1st byte returned is the block length, which the hardware auto-loads into the byte counter (ACNT)
+    //Up to MAXLEN bytes are stored in READDATA, and the block length is returned in LEN
+    //Returns true if successful, or false if an error occurred or the block was larger than MAXLEN
+    bool I2C_registerReadBlock(uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t maxLen, uint8_t* len);
+    
+    //Reads the MAPLEN byte change map at MAPREG of the device at ADDR (read-to-clear), 
+    //then reads only the changed registers into MIRROR, which holds registers 0 to SIZE - 1
+    //The map is copied to CHANGED, if not null. Returns true if successful
+    //If false is returned, the map may have been cleared - read the whole block to resynchronize
+    bool I2C_readChanged(uint8_t addr, uint8_t mapReg, uint8_t mapLen, uint8_t* mirror, uint8_t size, uint8_t* changed);
+    
     //Attempts to send LEN bytes of DATA to a device at ADDR
     //Returns true if successful, or false if an error occurred
     bool I2C_sendBytes(uint8_t addr, uint8_t* data, uint8_t len);
     
+    //Attempts to send LEN bytes of DATA to every device listening to the General Call address
+    //Returns true if at least one device ACKed, or false if an error occurred
+    bool I2C_sendGeneralCall(uint8_t* data, uint8_t len);
+    
+    //Returns the number of transactions (START to STOP) started since the last clear
+    uint16_t I2C_getTransactionCount(void);
+    
+    //Returns the number of transactions repeated after a collision or busy bus since the last clear
+    uint16_t I2C_getRetryCount(void);
+    
+    //Clears the transaction and retry counters
+    void I2C_clearTransactionCount(void);
+    
+    //Returns the reason the last transaction failed, or I2C_HOST_OK if it succeeded
+    I2C_HostError I2C_getLastError(void);
+    
+    //This function is called each time a transfer waits for the I2C module (such as I2C_Soft_service)
+    //It runs between bytes, so it must return quickly
+    void I2C_assignWaitHandler(void (*waitHandler)(void));
+    
     //Attempts to read LEN bytes of DATA from a device at ADDR
     //Returns true if successful, or false if an error occurred
     bool I2C_readBytes(uint8_t addr, uint8_t* data, uint8_t len);
@@ -0,0 +1,141 @@
+#include "i2c_memory.h"
+#include "i2c_host.h"
+#include "i2c_register.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Address bytes followed by 1 page of data
+static uint8_t pageBuffer[I2C_MEMORY_MAX_ADDR_WIDTH + I2C_MEMORY_MAX_PAGE];
+
+//Largest read in one transaction (I2C1CNTL is 8 bits)
+#define I2C_MEMORY_MAX_READ 255
+
+//Writes MEMADDR to BUFFER, MSB first. Returns the number of bytes written
+static uint8_t I2C_Memory_loadAddress(const I2C_MemoryDevice* device, uint32_t memAddr, uint8_t* buffer)
+{
+    return I2C_Register_pack(memAddr, device->addrWidth, I2C_REG_MSB_FIRST, buffer);
+}
+
+//Polls the memory until it ACKs, or until pollLimit polls have been made
+//Returns true if the memory is ready
+bool I2C_Memory_waitReady(const I2C_MemoryDevice* device)
+{
+    uint16_t polls = device->pollLimit;
+    
+    //The memory NACKs its address while a write cycle is in progress
+    //The probe byte only loads the memory's address pointer
+    while (!I2C_sendByte(device->addr, 0x00))
+    {
+        if ((polls == 0) || (I2C_getLastError() != I2C_HOST_NACK))
+        {
+            return false;
+        }
+        polls--;
+    }
+    
+    return true;
+}
+
+//Writes LEN bytes of DATA to the memory at MEMADDR
+//Writes are split at page boundaries, and each page waits for the write cycle by ACK polling
+//Returns true if successful, or false if an error occurred or a write cycle did not finish
+bool I2C_Memory_write(const I2C_MemoryDevice* device, uint32_t memAddr, uint8_t* data, uint16_t len)
+{
+    if ((device->addrWidth == 0) || (device->addrWidth > I2C_MEMORY_MAX_ADDR_WIDTH))
+    {
+        return false;
+    }
+    
+    while (len > 0)
+    {
+        uint16_t chunk = I2C_MEMORY_MAX_PAGE;
+        
+        //Stop at the next page boundary
+        if (device->pageSize != 0)
+        {
+            uint16_t toBoundary = device->pageSize - (uint16_t) (memAddr % device->pageSize);
+            if (toBoundary < chunk)
+            {
+                chunk = toBoundary;
+            }
+        }
+        
+        if (len < chunk)
+        {
+            chunk = len;
+        }
+        
+        //Address, then data, in one transaction
+        uint8_t index = I2C_Memory_loadAddress(device, memAddr, &pageBuffer[0]);
+        
+        for (uint16_t i = 0; i < chunk; i++)
+        {
+            pageBuffer[index] = data[i];
+            index++;
+        }
+        
+        if (!I2C_sendBytes(device->addr, &pageBuffer[0], index))
+        {
+            return false;
+        }
+        
+        //Wait for the write cycle, instead of a fixed delay
+        if ((device->pollLimit != 0) && (!I2C_Memory_waitReady(device)))
+        {
+            return false;
+        }
+        
+        memAddr += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    
+    return true;
+}
+
+//Reads LEN bytes from the memory at MEMADDR to DATA
+//The address is sent once, then the rest is read with current address reads
+//Returns true if successful, or false if an error occurred
+bool I2C_Memory_read(const I2C_MemoryDevice* device, uint32_t memAddr, uint8_t* data, uint16_t len)
+{
+    if ((device->addrWidth == 0) || (device->addrWidth > I2C_MEMORY_MAX_ADDR_WIDTH))
+    {
+        return false;
+    }
+    
+    if (len == 0)
+    {
+        return true;
+    }
+    
+    uint8_t addrBytes[I2C_MEMORY_MAX_ADDR_WIDTH];
+    uint8_t width = I2C_Memory_loadAddress(device, memAddr, &addrBytes[0]);
+    
+    //1st chunk - set the address, Repeated Start, read
+    uint8_t chunk = (len > I2C_MEMORY_MAX_READ) ? I2C_MEMORY_MAX_READ : (uint8_t) len;
+    
+    if (!I2C_writeRead(device->addr, &addrBytes[0], width, data, chunk))
+    {
+        return false;
+    }
+    
+    data += chunk;
+    len -= chunk;
+    
+    //The memory's address pointer continues from the last byte read
+    while (len > 0)
+    {
+        chunk = (len > I2C_MEMORY_MAX_READ) ? I2C_MEMORY_MAX_READ : (uint8_t) len;
+        
+        if (!I2C_readBytes(device->addr, data, chunk))
+        {
+            return false;
+        }
+        
+        data += chunk;
+        len -= chunk;
+    }
+    
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef I2C_MEMORY_H
+#define	I2C_MEMORY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//Largest page written in one transaction. Larger pages are split
+#define I2C_MEMORY_MAX_PAGE 64
+    
+//Largest memory address width, in bytes
+#define I2C_MEMORY_MAX_ADDR_WIDTH 4
+    
+    //Describes an external I2C EEPROM or FRAM
+    typedef struct {
+        uint8_t addr;           //7-bit I2C address
+        uint8_t addrWidth;      //Memory address bytes, sent MSB first (1 to 4)
+        uint16_t pageSize;      //Write page size in bytes, or 0 if writes may cross any boundary (FRAM)
+        uint16_t pollLimit;     //ACK polls to wait for a write cycle, or 0 if there is no write cycle (FRAM)
+    } I2C_MemoryDevice;
+    
+    //Writes LEN bytes of DATA to the memory at MEMADDR
+    //Writes are split at page boundaries, and each page waits for the write cycle by ACK polling
+    //Returns true if successful, or false if an error occurred or a write cycle did not finish
+    bool I2C_Memory_write(const I2C_MemoryDevice* device, uint32_t memAddr, uint8_t* data, uint16_t len);
+    
+    //Reads LEN bytes from the memory at MEMADDR to DATA
+    //The address is sent once, then the rest is read with current address reads
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Memory_read(const I2C_MemoryDevice* device, uint32_t memAddr, uint8_t* data, uint16_t len);
+    
+    //Polls the memory until it ACKs, or until pollLimit polls have been made
+    //Returns true if the memory is ready
+    bool I2C_Memory_waitReady(const I2C_MemoryDevice* device);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_MEMORY_H */
+
@@ -0,0 +1,122 @@
+#include "i2c_register.h"
+#include "i2c_host.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Register address followed by the data of one write
+static uint8_t writeBuffer[I2C_REGISTER_MAX_WIDTH + I2C_REGISTER_MAX_WRITE];
+
+//Returns true if WIDTH is a supported address or value width
+static bool I2C_Register_isValidWidth(uint8_t width)
+{
+    return ((width != 0) && (width <= I2C_REGISTER_MAX_WIDTH));
+}
+
+//Stores the low WIDTH bytes of VALUE in BUFFER, in ORDER. Returns WIDTH
+uint8_t I2C_Register_pack(uint32_t value, uint8_t width, I2C_ByteOrder order, uint8_t* buffer)
+{
+    for (uint8_t i = 0; i < width; i++)
+    {
+        //Least significant byte first
+        if (order == I2C_REG_LSB_FIRST)
+        {
+            buffer[i] = (uint8_t) value;
+        }
+        else
+        {
+            buffer[width - 1 - i] = (uint8_t) value;
+        }
+        value >>= 8;
+    }
+    
+    return width;
+}
+
+//Returns the value of WIDTH bytes in BUFFER, in ORDER
+uint32_t I2C_Register_unpack(const uint8_t* buffer, uint8_t width, I2C_ByteOrder order)
+{
+    uint32_t value = 0;
+    
+    for (uint8_t i = 0; i < width; i++)
+    {
+        //Most significant byte first
+        value <<= 8;
+        if (order == I2C_REG_LSB_FIRST)
+        {
+            value |= buffer[width - 1 - i];
+        }
+        else
+        {
+            value |= buffer[i];
+        }
+    }
+    
+    return value;
+}
+
+//Sends register address REG, then restarts and reads LEN bytes to DATA, in one transaction
+bool I2C_Register_read(const I2C_RegisterDevice* device, uint32_t reg, uint8_t* data, uint8_t len)
+{
+    if ((!I2C_Register_isValidWidth(device->regWidth)) || (len == 0))
+    {
+        return false;
+    }
+    
+    uint8_t regBytes[I2C_REGISTER_MAX_WIDTH];
+    uint8_t width = I2C_Register_pack(reg, device->regWidth, device->regOrder, &regBytes[0]);
+    
+    return I2C_writeRead(device->addr, &regBytes[0], width, data, len);
+}
+
+//Sends register address REG, followed by LEN bytes of DATA, in one transaction
+bool I2C_Register_write(const I2C_RegisterDevice* device, uint32_t reg, uint8_t* data, uint8_t len)
+{
+    if ((!I2C_Register_isValidWidth(device->regWidth)) || (len > I2C_REGISTER_MAX_WRITE))
+    {
+        return false;
+    }
+    
+    uint8_t index = I2C_Register_pack(reg, device->regWidth, device->regOrder, &writeBuffer[0]);
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        writeBuffer[index] = data[i];
+        index++;
+    }
+    
+    return I2C_sendBytes(device->addr, &writeBuffer[0], index);
+}
+
+//Reads the valueWidth byte value of register REG to VALUE
+bool I2C_Register_readValue(const I2C_RegisterDevice* device, uint32_t reg, uint32_t* value)
+{
+    if (!I2C_Register_isValidWidth(device->valueWidth))
+    {
+        return false;
+    }
+    
+    uint8_t valueBytes[I2C_REGISTER_MAX_WIDTH];
+    
+    if (!I2C_Register_read(device, reg, &valueBytes[0], device->valueWidth))
+    {
+        return false;
+    }
+    
+    *value = I2C_Register_unpack(&valueBytes[0], device->valueWidth, device->valueOrder);
+    return true;
+}
+
+//Writes the low valueWidth bytes of VALUE to register REG
+bool I2C_Register_writeValue(const I2C_RegisterDevice* device, uint32_t reg, uint32_t value)
+{
+    if (!I2C_Register_isValidWidth(device->valueWidth))
+    {
+        return false;
+    }
+    
+    uint8_t valueBytes[I2C_REGISTER_MAX_WIDTH];
+    uint8_t width = I2C_Register_pack(value, device->valueWidth, device->valueOrder, &valueBytes[0]);
+    
+    return I2C_Register_write(device, reg, &valueBytes[0], width);
+}
@@ -0,0 +1,58 @@
+#ifndef I2C_REGISTER_H
+#define	I2C_REGISTER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//Largest register address and value width, in bytes
+#define I2C_REGISTER_MAX_WIDTH 4
+    
+//Largest block written by I2C_Register_write in one transaction
+#define I2C_REGISTER_MAX_WRITE 32
+    
+    //Order of the bytes of a multi-byte register address or value on the bus
+    typedef enum {
+        I2C_REG_MSB_FIRST = 0, I2C_REG_LSB_FIRST
+    } I2C_ByteOrder;
+    
+    //Describes the register map of an I2C device
+    typedef struct {
+        uint8_t addr;               //7-bit I2C address
+        uint8_t regWidth;           //Register address bytes (1 to 4)
+        uint8_t valueWidth;         //Register value bytes for the value functions (1 to 4)
+        I2C_ByteOrder regOrder;     //Byte order of the register address
+        I2C_ByteOrder valueOrder;   //Byte order of register values
+    } I2C_RegisterDevice;
+    
+    //Stores the low WIDTH bytes of VALUE in BUFFER, in ORDER. Returns WIDTH
+    uint8_t I2C_Register_pack(uint32_t value, uint8_t width, I2C_ByteOrder order, uint8_t* buffer);
+    
+    //Returns the value of WIDTH bytes in BUFFER, in ORDER
+    uint32_t I2C_Register_unpack(const uint8_t* buffer, uint8_t width, I2C_ByteOrder order);
+    
+    //Sends register address REG, then restarts and reads LEN bytes to DATA, in one transaction
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Register_read(const I2C_RegisterDevice* device, uint32_t reg, uint8_t* data, uint8_t len);
+    
+    //Sends register address REG, followed by LEN bytes of DATA (up to I2C_REGISTER_MAX_WRITE), in one transaction
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Register_write(const I2C_RegisterDevice* device, uint32_t reg, uint8_t* data, uint8_t len);
+    
+    //Reads the valueWidth byte value of register REG to VALUE
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Register_readValue(const I2C_RegisterDevice* device, uint32_t reg, uint32_t* value);
+    
+    //Writes the low valueWidth bytes of VALUE to register REG
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Register_writeValue(const I2C_RegisterDevice* device, uint32_t reg, uint32_t value);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_REGISTER_H */
+
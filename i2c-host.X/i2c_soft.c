@@ -0,0 +1,575 @@
+#include "i2c_soft.h"
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "power.h"
+
+//Steps of a transfer
+#define I2C_SOFT_IDLE 0
+#define I2C_SOFT_START 1
+#define I2C_SOFT_WRITE 2
+#define I2C_SOFT_READ 3
+#define I2C_SOFT_RESTART 4
+#define I2C_SOFT_RESTART_SDA 5
+#define I2C_SOFT_STOP 6
+#define I2C_SOFT_STOP_SDA 7
+
+//Buses stepped by I2C_Soft_service
+static I2C_SoftBus* buses[I2C_SOFT_MAX_BUSES];
+static uint8_t busCount = 0;
+
+//Clears MASK in TRIS (drives the lines low)
+//The read-modify-write through a pointer takes several instructions, so an ISR that writes
+//the same TRIS register must not run in between
+static void I2C_Soft_trisClear(I2C_SoftBus* bus, uint8_t mask)
+{
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    *bus->tris &= (uint8_t) ~mask;
+    
+    INTCON0bits.GIE = enabled;
+}
+
+//Sets MASK in TRIS (releases the lines to the pull-ups)
+static void I2C_Soft_trisSet(I2C_SoftBus* bus, uint8_t mask)
+{
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    *bus->tris |= mask;
+    
+    INTCON0bits.GIE = enabled;
+}
+
+//Drives SDA low, or releases it
+static void I2C_Soft_sda(I2C_SoftBus* bus, bool high)
+{
+    if (high)
+    {
+        I2C_Soft_trisSet(bus, bus->sdaMask);
+    }
+    else
+    {
+        I2C_Soft_trisClear(bus, bus->sdaMask);
+    }
+}
+
+//Releases SCL. Returns false while a client holds it low
+//Sets the error and moves to STOP once I2C_SOFT_STRETCH_TICKS have passed
+static bool I2C_Soft_sclRelease(I2C_SoftBus* bus)
+{
+    I2C_Soft_trisSet(bus, bus->sclMask);
+    
+    if (*bus->port & bus->sclMask)
+    {
+        bus->stretch = I2C_SOFT_STRETCH_TICKS;
+        return true;
+    }
+    
+    bus->stretch--;
+    if (bus->stretch == 0)
+    {
+        //A stuck SCL cannot be fixed here - release SDA regardless
+        bus->error = I2C_HOST_TIMEOUT;
+        bus->state = (bus->state == I2C_SOFT_STOP) ? I2C_SOFT_STOP_SDA : I2C_SOFT_STOP;
+        bus->sclHigh = false;
+        bus->stretch = I2C_SOFT_STRETCH_TICKS;
+    }
+    return false;
+}
+
+//Loads the next byte to send, MSB first
+static void I2C_Soft_loadByte(I2C_SoftBus* bus, uint8_t data)
+{
+    bus->shift = data;
+    bus->bit = 0;
+    bus->sclHigh = false;
+    bus->state = I2C_SOFT_WRITE;
+}
+
+//Ends the transfer
+static void I2C_Soft_finish(I2C_SoftBus* bus)
+{
+    bus->lastError = bus->error;
+    bus->state = I2C_SOFT_IDLE;
+    bus->busy = false;
+}
+
+//Selects the step after the ACK of a byte that was sent
+static void I2C_Soft_afterWrite(I2C_SoftBus* bus, bool nack)
+{
+    if (nack)
+    {
+        bus->error = I2C_HOST_NACK;
+        bus->state = I2C_SOFT_STOP;
+    }
+    else if (bus->reading)
+    {
+        //Read address ACKed
+        bus->index = 0;
+        bus->bit = 0;
+        bus->state = I2C_SOFT_READ;
+    }
+    else if (bus->index < bus->writeLen)
+    {
+        I2C_Soft_loadByte(bus, bus->writeData[bus->index]);
+        bus->index++;
+    }
+    else if (bus->readLen != 0)
+    {
+        bus->state = I2C_SOFT_RESTART;
+    }
+    else
+    {
+        bus->state = I2C_SOFT_STOP;
+    }
+}
+
+//Stores a received byte, and selects its ACK
+static void I2C_Soft_storeByte(I2C_SoftBus* bus, uint8_t data)
+{
+    if (bus->blockHeader)
+    {
+        //The 1st byte sets the number of bytes that follow - NACK it if there are none
+        bus->readLen = data;
+        bus->ack = (data != 0);
+        return;
+    }
+    
+    //Read the whole block, and keep the bytes that fit
+    if (bus->index < bus->maxLen)
+    {
+        bus->readData[bus->index] = data;
+    }
+    
+    bus->ack = ((bus->index + 1) < bus->readLen);
+}
+
+//Selects the step after the ACK of a byte that was read
+static void I2C_Soft_afterRead(I2C_SoftBus* bus)
+{
+    if (bus->blockHeader)
+    {
+        bus->blockHeader = false;
+    }
+    else
+    {
+        bus->index++;
+    }
+    
+    bus->state = (bus->index < bus->readLen) ? I2C_SOFT_READ : I2C_SOFT_STOP;
+}
+
+//Runs one half period of the transfer on BUS
+static void I2C_Soft_step(I2C_SoftBus* bus)
+{
+    switch (bus->state)
+    {
+        case I2C_SOFT_START:
+        {
+            //Both lines must be high
+            uint8_t mask = bus->sclMask | bus->sdaMask;
+            if ((*bus->port & mask) != mask)
+            {
+                bus->error = I2C_HOST_BUSY;
+                I2C_Soft_finish(bus);
+                break;
+            }
+            
+            bus->transactions++;
+            
+            //SDA falls while SCL is high
+            I2C_Soft_sda(bus, false);
+            
+            bus->index = 0;
+            bus->reading = (bus->writeLen == 0);
+            I2C_Soft_loadByte(bus, (uint8_t) ((bus->addr << 1) | bus->reading));
+            break;
+        }
+        case I2C_SOFT_WRITE:
+        {
+            if (!bus->sclHigh)
+            {
+                //SCL low, then the next bit (or release SDA for the ACK)
+                I2C_Soft_trisClear(bus, bus->sclMask);
+                I2C_Soft_sda(bus, (bus->bit == 8) || (bus->shift & 0x80));
+                bus->sclHigh = true;
+                break;
+            }
+            
+            if (!I2C_Soft_sclRelease(bus))
+            {
+                break;
+            }
+            bus->sclHigh = false;
+            
+            if (bus->bit < 8)
+            {
+                bus->shift <<= 1;
+                bus->bit++;
+                break;
+            }
+            
+            //ACK clock - the client drives SDA low
+            I2C_Soft_afterWrite(bus, (*bus->port & bus->sdaMask) != 0);
+            break;
+        }
+        case I2C_SOFT_READ:
+        {
+            if (!bus->sclHigh)
+            {
+                //SCL low, then release SDA for the client (or drive the ACK)
+                I2C_Soft_trisClear(bus, bus->sclMask);
+                I2C_Soft_sda(bus, (bus->bit < 8) || (!bus->ack));
+                bus->sclHigh = true;
+                break;
+            }
+            
+            if (!I2C_Soft_sclRelease(bus))
+            {
+                break;
+            }
+            bus->sclHigh = false;
+            
+            if (bus->bit < 8)
+            {
+                bus->shift <<= 1;
+                if (*bus->port & bus->sdaMask)
+                {
+                    bus->shift |= 0x01;
+                }
+                
+                bus->bit++;
+                if (bus->bit == 8)
+                {
+                    I2C_Soft_storeByte(bus, bus->shift);
+                }
+                break;
+            }
+            
+            bus->bit = 0;
+            I2C_Soft_afterRead(bus);
+            break;
+        }
+        case I2C_SOFT_RESTART:
+        {
+            if (!bus->sclHigh)
+            {
+                I2C_Soft_trisClear(bus, bus->sclMask);
+                I2C_Soft_sda(bus, true);
+                bus->sclHigh = true;
+                break;
+            }
+            
+            if (I2C_Soft_sclRelease(bus))
+            {
+                bus->state = I2C_SOFT_RESTART_SDA;
+            }
+            break;
+        }
+        case I2C_SOFT_RESTART_SDA:
+        {
+            //SDA falls while SCL is high
+            I2C_Soft_sda(bus, false);
+            
+            bus->reading = true;
+            I2C_Soft_loadByte(bus, (uint8_t) ((bus->addr << 1) | 0x01));
+            break;
+        }
+        case I2C_SOFT_STOP:
+        {
+            if (!bus->sclHigh)
+            {
+                I2C_Soft_trisClear(bus, bus->sclMask);
+                I2C_Soft_sda(bus, false);
+                bus->sclHigh = true;
+                break;
+            }
+            
+            if (I2C_Soft_sclRelease(bus))
+            {
+                bus->state = I2C_SOFT_STOP_SDA;
+            }
+            break;
+        }
+        case I2C_SOFT_STOP_SDA:
+        {
+            //SDA rises while SCL is high
+            I2C_Soft_sda(bus, true);
+            I2C_Soft_finish(bus);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+//Starts TMR4 at one period per half clock - HFINTOSC (4 MHz) / 4 = 1 us per count
+//HFINTOSC is not divided by the clock scaling, so the bit rate does not change in a burst
+static void I2C_Soft_initTimer(void)
+{
+    T4CON = 0x00;
+    T4CLKCON = 0b0011;
+    T4CONbits.CKPS = 0b010;
+    T4HLT = 0x00;
+    T4PR = I2C_SOFT_HALF_PERIOD_US - 1;
+    
+    //TMR4 wakes the CPU from IDLE, but does not vector (GIE = 0)
+    PIR11bits.TMR4IF = 0;
+    PIE11bits.TMR4IE = 1;
+}
+
+//Starts a transfer on BUS
+static bool I2C_Soft_begin(I2C_SoftBus* bus, uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen)
+{
+    if ((bus->busy) || ((writeLen == 0) && (readLen == 0)))
+    {
+        return false;
+    }
+    
+    bus->addr = addr;
+    bus->writeData = writeData;
+    bus->writeLen = writeLen;
+    bus->readData = readData;
+    bus->readLen = readLen;
+    bus->maxLen = readLen;
+    bus->blockHeader = false;
+    bus->error = I2C_HOST_OK;
+    bus->stretch = I2C_SOFT_STRETCH_TICKS;
+    bus->sclHigh = false;
+    bus->state = I2C_SOFT_START;
+    bus->busy = true;
+    
+    //The 1st step runs on the next period
+    if (!T4CONbits.ON)
+    {
+        T4TMR = 0x00;
+        PIR11bits.TMR4IF = 0;
+        T4CONbits.ON = 1;
+    }
+    
+    return true;
+}
+
+//Configures the pins of BUS as open-drain (driven low or released) with pull-ups
+void I2C_Soft_init(I2C_SoftBus* bus)
+{
+    uint8_t mask = bus->sclMask | bus->sdaMask;
+    
+    bool enabled = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    
+    //Digital inputs, with weak pull-ups
+    *bus->ansel &= (uint8_t) ~mask;
+    *bus->wpu |= mask;
+    
+    //Released - the pins are only driven low, by clearing TRIS
+    *bus->lat &= (uint8_t) ~mask;
+    *bus->tris |= mask;
+    
+    INTCON0bits.GIE = enabled;
+    
+    bus->lastError = I2C_HOST_OK;
+    bus->transactions = 0;
+    bus->busy = false;
+    bus->state = I2C_SOFT_IDLE;
+    
+    if (busCount == 0)
+    {
+        I2C_Soft_initTimer();
+    }
+    
+    //Add BUS to the buses stepped by the service function, once
+    for (uint8_t i = 0; i < busCount; i++)
+    {
+        if (buses[i] == bus)
+        {
+            return;
+        }
+    }
+    
+    if (busCount < I2C_SOFT_MAX_BUSES)
+    {
+        buses[busCount] = bus;
+        busCount++;
+    }
+}
+
+//Steps every busy bus by one half period, if TMR4 has expired since the last step
+void I2C_Soft_service(void)
+{
+    if (!PIR11bits.TMR4IF)
+    {
+        return;
+    }
+    PIR11bits.TMR4IF = 0;
+    
+    bool active = false;
+    for (uint8_t i = 0; i < busCount; i++)
+    {
+        if (buses[i]->busy)
+        {
+            I2C_Soft_step(buses[i]);
+            active = active || buses[i]->busy;
+        }
+    }
+    
+    //Stop the timer, so the flag does not keep the CPU out of IDLE
+    if (!active)
+    {
+        T4CONbits.ON = 0;
+    }
+}
+
+//Starts sending WRITELEN bytes of WRITEDATA, then reading READLEN bytes to READDATA after a Repeated START
+bool I2C_Soft_startTransfer(I2C_SoftBus* bus, uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen)
+{
+    return I2C_Soft_begin(bus, addr, writeData, writeLen, readData, readLen);
+}
+
+//Returns true while a transfer started on BUS has not ended
+bool I2C_Soft_isBusy(I2C_SoftBus* bus)
+{
+    return bus->busy;
+}
+
+//Idles until the transfer on BUS ends. Returns true if it succeeded
+bool I2C_Soft_waitForTransfer(I2C_SoftBus* bus)
+{
+    while (bus->busy)
+    {
+        //TMR4 ends IDLE once per half period
+        if (!PIR11bits.TMR4IF)
+        {
+            Power_idle();
+        }
+        I2C_Soft_service();
+    }
+    
+    return (bus->lastError == I2C_HOST_OK);
+}
+
+//Runs a transfer on BUS to completion
+static bool I2C_Soft_transfer(I2C_SoftBus* bus, uint8_t addr,
+        uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen)
+{
+    if (!I2C_Soft_begin(bus, addr, writeData, writeLen, readData, readLen))
+    {
+        return false;
+    }
+    
+    return I2C_Soft_waitForTransfer(bus);
+}
+
+//Attempts to send 1 byte of DATA to a device at ADDR
+bool I2C_Soft_sendByte(I2C_SoftBus* bus, uint8_t addr, uint8_t data)
+{
+    return I2C_Soft_transfer(bus, addr, &data, 1, 0, 0);
+}
+
+//Attempts to read 1 byte of DATA from a device at ADDR
+bool I2C_Soft_readByte(I2C_SoftBus* bus, uint8_t addr, uint8_t* data)
+{
+    return I2C_Soft_transfer(bus, addr, 0, 0, data, 1);
+}
+
+//Addresses a device at ADDR and reads 1 byte. Returns 0x00 if an error occurs
+uint8_t I2C_Soft_readByteNoWarn(I2C_SoftBus* bus, uint8_t addr)
+{
+    uint8_t data = 0x00;
+    
+    if (!I2C_Soft_readByte(bus, addr, &data))
+    {
+        return 0x00;
+    }
+    return data;
+}
+
+//Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads LEN bytes to READDATA
+bool I2C_Soft_registerWriteRead(I2C_SoftBus* bus, uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t len)
+{
+    return I2C_Soft_writeRead(bus, addr, &regAddr, 1, readData, len);
+}
+
+//Attempts to send WRITELEN bytes of WRITEDATA to the device at ADDR, then restarts and reads READLEN bytes to READDATA
+bool I2C_Soft_writeRead(I2C_SoftBus* bus, uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen)
+{
+    if ((writeLen == 0) || (readLen == 0))
+    {
+        return false;
+    }
+    
+    return I2C_Soft_transfer(bus, addr, writeData, writeLen, readData, readLen);
+}
+
+//Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads a block
+bool I2C_Soft_registerReadBlock(I2C_SoftBus* bus, uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t maxLen, uint8_t* len)
+{
+    *len = 0;
+    
+    //READLEN is replaced by the length byte
+    if (!I2C_Soft_begin(bus, addr, &regAddr, 1, readData, 1))
+    {
+        return false;
+    }
+    bus->maxLen = maxLen;
+    bus->blockHeader = true;
+    
+    if (!I2C_Soft_waitForTransfer(bus))
+    {
+        return false;
+    }
+    
+    *len = bus->readLen;
+    return (bus->readLen <= maxLen);
+}
+
+//Attempts to send LEN bytes of DATA to a device at ADDR
+bool I2C_Soft_sendBytes(I2C_SoftBus* bus, uint8_t addr, uint8_t* data, uint8_t len)
+{
+    if (len == 0)
+    {
+        return false;
+    }
+    
+    return I2C_Soft_transfer(bus, addr, data, len, 0, 0);
+}
+
+//Attempts to send LEN bytes of DATA to every device listening to the General Call address
+bool I2C_Soft_sendGeneralCall(I2C_SoftBus* bus, uint8_t* data, uint8_t len)
+{
+    return I2C_Soft_sendBytes(bus, I2C_GENERAL_CALL_ADDR, data, len);
+}
+
+//Attempts to read LEN bytes of DATA from a device at ADDR
+bool I2C_Soft_readBytes(I2C_SoftBus* bus, uint8_t addr, uint8_t* data, uint8_t len)
+{
+    if (len == 0)
+    {
+        return false;
+    }
+    
+    return I2C_Soft_transfer(bus, addr, 0, 0, data, len);
+}
+
+//Returns the number of transactions (START to STOP) started on BUS since the last clear
+uint16_t I2C_Soft_getTransactionCount(I2C_SoftBus* bus)
+{
+    return bus->transactions;
+}
+
+//Clears the transaction counter of BUS
+void I2C_Soft_clearTransactionCount(I2C_SoftBus* bus)
+{
+    bus->transactions = 0;
+}
+
+//Returns the reason the last transaction on BUS failed, or I2C_HOST_OK if it succeeded
+I2C_HostError I2C_Soft_getLastError(I2C_SoftBus* bus)
+{
+    return bus->lastError;
+}
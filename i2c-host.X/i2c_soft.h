@@ -0,0 +1,135 @@
+#ifndef I2C_SOFT_H
+#define	I2C_SOFT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//I2C_HostError
+#include "i2c_host.h"
+    
+//Half of the SCL period, in us (TMR4 period, 2 - 256). 50 us = 10 kHz
+//Each half period is one step of the engine - at a 1 MHz CPU clock a step takes longer, and the bus slows down
+#define I2C_SOFT_HALF_PERIOD_US 50
+    
+#if (I2C_SOFT_HALF_PERIOD_US < 2) || (I2C_SOFT_HALF_PERIOD_US > 256)
+#error "I2C_SOFT_HALF_PERIOD_US must be 2 to 256"
+#endif
+    
+//Number of half periods to wait for a client to release SCL (clock stretching, 1 - 255)
+#define I2C_SOFT_STRETCH_TICKS 200
+    
+//Number of buses that can be stepped by I2C_Soft_service
+#define I2C_SOFT_MAX_BUSES 2
+    
+    //A bit-banged I2C bus. SCL and SDA must be on the same port
+    typedef struct {
+        volatile uint8_t* tris;
+        volatile uint8_t* lat;
+        volatile uint8_t* port;
+        volatile uint8_t* ansel;
+        volatile uint8_t* wpu;
+        uint8_t sclMask;
+        uint8_t sdaMask;
+        I2C_HostError lastError;
+        uint16_t transactions;
+        
+        //Transfer in progress - stepped once per half period by I2C_Soft_service
+        volatile bool busy;
+        uint8_t state;
+        uint8_t bit;            //Data bit (0 - 7), or 8 for the ACK
+        bool sclHigh;           //The next step releases SCL
+        uint8_t shift;
+        uint8_t stretch;
+        bool reading;
+        bool ack;
+        bool blockHeader;       //The next byte read is a block length
+        uint8_t addr;
+        uint8_t* writeData;
+        uint8_t writeLen;
+        uint8_t* readData;
+        uint8_t readLen;
+        uint8_t maxLen;
+        uint8_t index;
+        I2C_HostError error;
+    } I2C_SoftBus;
+    
+//Initializer for a bus on port X (A, B, ...), with SCL and SDA on pins SCL and SDA (0 to 7)
+//The transfer state is left at 0
+#define I2C_SOFT_BUS(x, scl, sda) \
+    { &TRIS##x, &LAT##x, &PORT##x, &ANSEL##x, &WPU##x, \
+      (uint8_t) (1 << (scl)), (uint8_t) (1 << (sda)), I2C_HOST_OK, 0 }
+    
+    //Configures the pins of BUS as open-drain (driven low or released) with pull-ups
+    //Adds BUS to the buses stepped by I2C_Soft_service, and sets up TMR4 on the first call
+    void I2C_Soft_init(I2C_SoftBus* bus);
+    
+    //Steps every busy bus by one half period, if TMR4 has expired since the last step
+    //Assign as the I2C wait handler, so a software transfer runs while I2C1 transfers
+    void I2C_Soft_service(void);
+    
+    //Starts sending WRITELEN bytes of WRITEDATA, then reading READLEN bytes to READDATA after a Repeated START
+    //Either length may be 0, but not both. Returns false if BUS is busy
+    //The buffers must stay valid until the transfer ends (I2C_Soft_isBusy returns false)
+    bool I2C_Soft_startTransfer(I2C_SoftBus* bus, uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen);
+    
+    //Returns true while a transfer started on BUS has not ended
+    bool I2C_Soft_isBusy(I2C_SoftBus* bus);
+    
+    //Idles until the transfer on BUS ends. Returns true if it succeeded
+    bool I2C_Soft_waitForTransfer(I2C_SoftBus* bus);
+    
+    //Attempts to send 1 byte of DATA to a device at ADDR
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Soft_sendByte(I2C_SoftBus* bus, uint8_t addr, uint8_t data);
+    
+    //Attempts to read 1 byte of DATA from a device at ADDR
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Soft_readByte(I2C_SoftBus* bus, uint8_t addr, uint8_t* data);
+    
+    //Addresses a device at ADDR and reads 1 byte. Returns 0x00 if an error occurs
+    uint8_t I2C_Soft_readByteNoWarn(I2C_SoftBus* bus, uint8_t addr);
+    
+    //Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads LEN bytes to READDATA
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Soft_registerWriteRead(I2C_SoftBus* bus, uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t len);
+    
+    //Attempts to send WRITELEN bytes of WRITEDATA to the device at ADDR, then restarts and reads READLEN bytes to READDATA
+    //WRITELEN and READLEN must be at least 1. Returns true if successful, or false if an error occurred
+    bool I2C_Soft_writeRead(I2C_SoftBus* bus, uint8_t addr, uint8_t* writeData, uint8_t writeLen, uint8_t* readData, uint8_t readLen);
+    
+    //Attempts to send 1 byte of data REGADDR to the device at ADDR, then restarts and reads a block
+    //The 1st byte returned is the block length. Up to MAXLEN bytes are stored in READDATA, and the block length is returned in LEN
+    //Returns true if successful, or false if an error occurred or the block was larger than MAXLEN
+    bool I2C_Soft_registerReadBlock(I2C_SoftBus* bus, uint8_t addr, uint8_t regAddr, uint8_t* readData, uint8_t maxLen, uint8_t* len);
+    
+    //Attempts to send LEN bytes of DATA to a device at ADDR
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Soft_sendBytes(I2C_SoftBus* bus, uint8_t addr, uint8_t* data, uint8_t len);
+    
+    //Attempts to send LEN bytes of DATA to every device listening to the General Call address
+    //Returns true if at least one device ACKed, or false if an error occurred
+    bool I2C_Soft_sendGeneralCall(I2C_SoftBus* bus, uint8_t* data, uint8_t len);
+    
+    //Attempts to read LEN bytes of DATA from a device at ADDR
+    //Returns true if successful, or false if an error occurred
+    bool I2C_Soft_readBytes(I2C_SoftBus* bus, uint8_t addr, uint8_t* data, uint8_t len);
+    
+    //Returns the number of transactions (START to STOP) started on BUS since the last clear
+    uint16_t I2C_Soft_getTransactionCount(I2C_SoftBus* bus);
+    
+    //Clears the transaction counter of BUS
+    void I2C_Soft_clearTransactionCount(I2C_SoftBus* bus);
+    
+    //Returns the reason the last transaction on BUS failed, or I2C_HOST_OK if it succeeded
+    I2C_HostError I2C_Soft_getLastError(I2C_SoftBus* bus);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* I2C_SOFT_H */
+
@@ -0,0 +1,340 @@
+#include "loopback.h"
+#include "i2c_host.h"
+#include "power.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+static uint8_t txBlock[LOOPBACK_BUFFER_SIZE + 1];
+
+//Storm reads can run past the end of the client buffer
+static uint8_t rxBlock[LOOPBACK_STORM_MAX_READ];
+
+//Expected contents of the client buffer
+static uint8_t model[LOOPBACK_BUFFER_SIZE];
+
+//Returns the elapsed time counter, and the active part in ACTIVE
+//TMR1 wraps every 131 ms, and a sweep or storm runs far longer. The counters only stay right if the
+//time is accumulated more often, so every transaction samples the timer (Loopback_sample)
+static uint32_t Loopback_now(uint32_t* active)
+{
+    Power_Stats stats;
+    Power_getStats(&stats);
+    
+    *active = stats.activeTicks;
+    return stats.activeTicks + stats.idleTicks;
+}
+
+//Accumulates the time since the last sample, so a TMR1 rollover is not lost
+static void Loopback_sample(void)
+{
+    Power_getTicks();
+}
+
+//Writes LEN bytes at OFFSET, reads them back and compares
+//Returns the number of errors found
+static uint8_t Loopback_transfer(uint8_t offset, uint8_t len, uint8_t seed, Loopback_Results* results)
+{
+    uint8_t errors = 0;
+    uint8_t* payload = &txBlock[0];
+    uint8_t sendLen = len;
+    
+    Loopback_sample();
+    
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+    //1st byte selects the index in the client
+    txBlock[0] = offset;
+    payload = &txBlock[1];
+    sendLen++;
+#endif
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        payload[i] = (uint8_t) (seed + (i * 7));
+        model[offset + i] = payload[i];
+    }
+    
+    if (!I2C_sendBytes(LOOPBACK_CLIENT_ADDR, &txBlock[0], sendLen))
+    {
+        errors++;
+    }
+    
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+    //Register select, Repeated Start, read
+    if (!I2C_registerWriteRead(LOOPBACK_CLIENT_ADDR, offset, &rxBlock[0], len))
+    {
+        errors++;
+    }
+#else
+    //Index restarts at 0 on every transaction
+    if (!I2C_readBytes(LOOPBACK_CLIENT_ADDR, &rxBlock[0], len))
+    {
+        errors++;
+    }
+#endif
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (rxBlock[i] != payload[i])
+        {
+            errors++;
+        }
+    }
+    
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+    //The client index must continue right after the last byte read
+    if ((offset + len) < LOOPBACK_BUFFER_SIZE)
+    {
+        uint8_t next = 0x00;
+        if (!I2C_readByte(LOOPBACK_CLIENT_ADDR, &next))
+        {
+            errors++;
+        }
+        
+        if (next != model[offset + len])
+        {
+            errors++;
+        }
+        
+        results->transfers++;
+        results->bytes++;
+    }
+#endif
+    
+    results->transfers += 2;
+    results->bytes += (uint32_t) sendLen + len;
+    
+    return errors;
+}
+
+//Runs a correctness and throughput sweep against the i2c-client.X example
+bool Loopback_runSweep(Loopback_Results* results)
+{
+    results->transfers = 0;
+    results->errors = 0;
+    results->bytes = 0;
+    
+    uint32_t activeStart;
+    uint32_t start = Loopback_now(&activeStart);
+    uint8_t seed = 0x11;
+    
+    //Fill the whole client buffer, so the model starts in a known state
+    results->errors += Loopback_transfer(0, LOOPBACK_BUFFER_SIZE, 0xA0, results);
+    
+    for (uint8_t offset = 0; offset < LOOPBACK_BUFFER_SIZE; offset++)
+    {
+        for (uint8_t len = 1; (offset + len) <= LOOPBACK_BUFFER_SIZE; len++)
+        {
+            results->errors += Loopback_transfer(offset, len, seed, results);
+            seed += 0x35;
+        }
+        
+#ifndef LOOPBACK_FIRST_BYTE_ADDR
+        //Offsets are not supported without FIRST_BYTE_ADDR
+        break;
+#endif
+    }
+    
+    uint32_t activeEnd;
+    results->ticks = Loopback_now(&activeEnd) - start;
+    results->activeTicks = activeEnd - activeStart;
+    
+    return (results->errors == 0);
+}
+
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+//Client index expected after the last transaction
+static uint8_t modelIndex = 0;
+
+static uint16_t stormState = 1;
+
+//Returns the next value of a 16-bit xorshift sequence
+static uint8_t Loopback_random(void)
+{
+    stormState ^= stormState << 7;
+    stormState ^= stormState >> 9;
+    stormState ^= stormState << 8;
+    return (uint8_t) stormState;
+}
+
+//Returns a random value from 0 to LIMIT - 1
+static uint8_t Loopback_randomBelow(uint8_t limit)
+{
+    return Loopback_random() % limit;
+}
+
+//Stores LEN random bytes at OFFSET in txBlock and in the model
+static void Loopback_fillBlock(uint8_t offset, uint8_t len)
+{
+    txBlock[0] = offset;
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        txBlock[i + 1] = Loopback_random();
+        model[offset + i] = txBlock[i + 1];
+    }
+    
+    modelIndex = offset + len;
+}
+
+//Compares LEN bytes read at the model index, then advances the index like the client
+//Returns the number of errors found
+static uint8_t Loopback_checkRead(uint8_t len)
+{
+    uint8_t errors = 0;
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        uint8_t expected = 0x00;
+        if (modelIndex < LOOPBACK_BUFFER_SIZE)
+        {
+            expected = model[modelIndex];
+        }
+        
+        if (rxBlock[i] != expected)
+        {
+            errors++;
+        }
+        
+        //The client index stops at 0xFF
+        if (modelIndex < 0xFF)
+        {
+            modelIndex++;
+        }
+    }
+    
+    return errors;
+}
+
+//Runs one random transaction. Returns the number of errors found
+static uint8_t Loopback_stormTransaction(Loopback_StormResults* results)
+{
+    uint8_t errors = 0;
+    uint8_t offset = Loopback_randomBelow(LOOPBACK_BUFFER_SIZE);
+    uint8_t writeLen = 1 + Loopback_randomBelow(LOOPBACK_BUFFER_SIZE - offset);
+    uint8_t readLen = 1 + Loopback_randomBelow(LOOPBACK_STORM_MAX_READ);
+    
+    Loopback_sample();
+    
+    switch (Loopback_randomBelow(5))
+    {
+        case 0:
+        {
+            //Block write
+            Loopback_fillBlock(offset, writeLen);
+            if (!I2C_sendBytes(LOOPBACK_CLIENT_ADDR, &txBlock[0], writeLen + 1))
+            {
+                errors++;
+            }
+            results->bytes += writeLen + 1;
+            break;
+        }
+        case 1:
+        {
+            //Read from the current index
+            if (!I2C_readBytes(LOOPBACK_CLIENT_ADDR, &rxBlock[0], readLen))
+            {
+                errors++;
+            }
+            errors += Loopback_checkRead(readLen);
+            results->bytes += readLen;
+            break;
+        }
+        case 2:
+        {
+            //Register select, Repeated Start, read
+            modelIndex = offset;
+            if (!I2C_registerWriteRead(LOOPBACK_CLIENT_ADDR, offset, &rxBlock[0], readLen))
+            {
+                errors++;
+            }
+            errors += Loopback_checkRead(readLen);
+            results->bytes += readLen + 1;
+            break;
+        }
+        case 3:
+        {
+            //Block write, Repeated Start, read from the index after the last byte written
+            Loopback_fillBlock(offset, writeLen);
+            if (!I2C_writeRead(LOOPBACK_CLIENT_ADDR, &txBlock[0], writeLen + 1, &rxBlock[0], readLen))
+            {
+                errors++;
+            }
+            errors += Loopback_checkRead(readLen);
+            results->bytes += writeLen + 1 + readLen;
+            break;
+        }
+        default:
+        {
+            //Register select with no data, possibly past the end of the buffer
+            modelIndex = Loopback_randomBelow(LOOPBACK_STORM_MAX_SELECT + 1);
+            if (!I2C_sendByte(LOOPBACK_CLIENT_ADDR, modelIndex))
+            {
+                errors++;
+            }
+            results->bytes++;
+            break;
+        }
+    }
+    
+    return errors;
+}
+
+//Writes the model to the whole client buffer
+static bool Loopback_resync(void)
+{
+    txBlock[0] = 0;
+    for (uint8_t i = 0; i < LOOPBACK_BUFFER_SIZE; i++)
+    {
+        txBlock[i + 1] = model[i];
+    }
+    
+    modelIndex = LOOPBACK_BUFFER_SIZE;
+    return I2C_sendBytes(LOOPBACK_CLIENT_ADDR, &txBlock[0], LOOPBACK_BUFFER_SIZE + 1);
+}
+
+//Runs COUNT random transactions, checked against a model of the client buffer and index
+bool Loopback_runStorm(uint32_t count, uint16_t seed, Loopback_StormResults* results)
+{
+    results->transactions = 0;
+    results->errors = 0;
+    results->firstError = 0;
+    results->bytes = 0;
+    
+    //An all-zero state never changes
+    stormState = (seed != 0) ? seed : 1;
+    
+    uint32_t active;
+    uint32_t start = Loopback_now(&active);
+    
+    //Known starting state
+    Loopback_fillBlock(0, LOOPBACK_BUFFER_SIZE);
+    if (!Loopback_resync())
+    {
+        results->errors++;
+        results->firstError = 1;
+    }
+    
+    while (results->transactions < count)
+    {
+        results->transactions++;
+        
+        uint8_t errors = Loopback_stormTransaction(results);
+        if (errors != 0)
+        {
+            if (results->firstError == 0)
+            {
+                results->firstError = results->transactions;
+            }
+            results->errors += errors;
+            
+            //Later checks are only meaningful if the client matches the model again
+            Loopback_resync();
+        }
+    }
+    
+    results->ticks = Loopback_now(&active) - start;
+    
+    return (results->errors == 0);
+}
+#endif
@@ -0,0 +1,62 @@
+#ifndef LOOPBACK_H
+#define	LOOPBACK_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+    
+//Address and buffer size of the i2c-client.X example
+#define LOOPBACK_CLIENT_ADDR 0x64
+#define LOOPBACK_BUFFER_SIZE 16
+    
+//Must match FIRST_BYTE_ADDR in the client's i2c_blockData.h
+#define LOOPBACK_FIRST_BYTE_ADDR
+    
+//Number of random transactions in the storm run by the example
+#define LOOPBACK_STORM_TRANSACTIONS 100000UL
+    
+//Longest storm read - reads past the end of the client buffer return 0x00
+#define LOOPBACK_STORM_MAX_READ (LOOPBACK_BUFFER_SIZE + 4)
+    
+//Highest index selected by the storm (below the client's MAILBOX_COMMAND_REG)
+#define LOOPBACK_STORM_MAX_SELECT 0x7F
+    
+    //Results of a sweep
+    typedef struct {
+        uint16_t transfers;
+        uint16_t errors;
+        uint32_t bytes;
+        uint32_t ticks;         //Elapsed time in 2us ticks (see power.h)
+        uint32_t activeTicks;   //CPU time (not in IDLE) in 2us ticks
+    } Loopback_Results;
+    
+    //Results of a storm
+    typedef struct {
+        uint32_t transactions;
+        uint32_t errors;
+        uint32_t firstError;    //Number of the 1st failed transaction (0 if none)
+        uint32_t bytes;
+        uint32_t ticks;         //Elapsed time in 2us ticks (see power.h)
+    } Loopback_StormResults;
+    
+    //Runs a correctness and throughput sweep against the i2c-client.X example
+    //Every transfer size and offset is written, read back and compared
+    //Requires Power_init() for timing. Returns true if no errors occurred
+    bool Loopback_runSweep(Loopback_Results* results);
+    
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+    //Runs COUNT random writes, reads, Repeated Start and register select transactions
+    //Every byte read is checked against a model of the client buffer and index
+    //The same SEED repeats the same sequence. Returns true if no errors occurred
+    bool Loopback_runStorm(uint32_t count, uint16_t seed, Loopback_StormResults* results);
+#endif
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* LOOPBACK_H */
+
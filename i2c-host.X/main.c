@@ -87,12 +87,20 @@
 
 #include "advanced_IO.h"
 #include "i2c_host.h"
+#include "power.h"
+#include "loopback.h"
 
 #include <stdint.h>
 #include <stdbool.h>
 
+//If defined, the host runs a loopback sweep against the i2c-client.X example instead of the I/O Expander demo
+//#define RUN_LOOPBACK_SWEEP
+
 void main(void) {
     
+    //Init low-power delays and duty-cycle accounting
+    Power_init();
+    
     //Init the IO Expander
     advancedIO_init();
     
@@ -104,6 +112,34 @@ void main(void) {
     TRISF5 = 0;
     LATF5 = 0;
     
+#ifdef RUN_LOOPBACK_SWEEP
+    Loopback_Results results;
+    bool passed = Loopback_runSweep(&results);
+    
+#ifdef POWER_CLOCK_SCALING
+    //Same workload at 4 MHz - compare bytes per active tick (see README)
+    Loopback_Results fastResults;
+    
+    Power_beginBurst();
+    passed &= Loopback_runSweep(&fastResults);
+    Power_endBurst();
+#endif
+    
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+    //Random back-to-back traffic, checked against a model of the client
+    Loopback_StormResults stormResults;
+    passed &= Loopback_runStorm(LOOPBACK_STORM_TRANSACTIONS, 0xACE1, &stormResults);
+#endif
+    
+    //LED0 (active LOW) turns on if every transfer passed
+    LATC7 = !passed;
+    
+    while (1)
+    {
+        Power_delayMs(1000);
+    }
+#endif
+    
     bool good = false;
     
     while (!good)
@@ -116,9 +152,9 @@ void main(void) {
         {
             //Toggles the reset line
             LATF5 = 1;
-            for (uint32_t i = 0; i < 0xFFFF; i++);
+            Power_delayMs(500);
             LATF5 = 0;
-            for (uint32_t i = 0; i < 0xFFFF; i++);
+            Power_delayMs(500);
         }
     }
     
@@ -132,7 +168,7 @@ void main(void) {
     {
         advancedIO_getRegister(ADV_IO_IOCxN);
         advancedIO_toggleBitsInRegister(ADV_IO_LATx, 0xFF);
-        for (uint32_t i = 0; i < 0xFFF; i++) { ; }
+        Power_delayMs(250);
     }
     
     return;
@@ -0,0 +1,233 @@
+#include "power.h"
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//TMR2 period for 1 ms from LFINTOSC (31 kHz)
+#define POWER_TMR2_1MS_PERIOD 30
+
+static uint16_t lastStamp = 0;
+static uint32_t activeTicks = 0;
+static uint32_t idleTicks = 0;
+
+//Total time since Power_init - not reset by Power_clearStats
+static uint32_t elapsedTicks = 0;
+
+#ifdef POWER_CLOCK_SCALING
+//OSCCON1 values - HFINTOSC (4 MHz) with a 4:1 or 1:1 divider
+#define POWER_OSC_SLOW 0x62
+#define POWER_OSC_FAST 0x60
+
+static uint8_t burstDepth = 0;
+static uint32_t fastTicks = 0;
+static uint32_t switchTicks = 0;
+static uint16_t clockSwitches = 0;
+#endif
+
+//Returns the current TMR1 count
+static uint16_t Power_readTimer(void)
+{
+    //Reading TMR1L latches TMR1H (RD16 = 1)
+    uint8_t low = TMR1L;
+    return ((uint16_t) TMR1H << 8) | low;
+}
+
+//Adds the time since the last update to TOTAL, and to the fast clock time during a burst
+//Every function that reads TMR1 calls this, so a rollover is only lost if none runs for 131 ms
+static void Power_accumulate(uint16_t now, uint32_t* total)
+{
+    uint16_t elapsed = now - lastStamp;
+    lastStamp = now;
+    
+    *total += elapsed;
+    elapsedTicks += elapsed;
+    
+#ifdef POWER_CLOCK_SCALING
+    if (burstDepth != 0)
+    {
+        fastTicks += elapsed;
+    }
+#endif
+}
+
+#ifdef POWER_CLOCK_SCALING
+//Selects the CPU clock and waits for the switch to complete
+static void Power_switchClock(uint8_t osc)
+{
+    uint16_t start = Power_readTimer();
+    
+    OSCCON1 = osc;
+    
+    //OSCCON2 shows the current source and divider
+    while (OSCCON2 != osc);
+    
+    switchTicks += (uint16_t) (Power_readTimer() - start);
+    clockSwitches++;
+}
+#endif
+
+//Initializes TMR1 (duty-cycle accounting) and TMR2 (1 ms delays)
+void Power_init(void)
+{
+    //TMR1: HFINTOSC (4 MHz) / 8 = 2 us per tick, 16-bit reads
+    T1CON = 0x00;
+    T1CLK = 0b00011;
+    T1CONbits.CKPS = 0b11;
+    T1CONbits.RD16 = 1;
+    TMR1H = 0x00;
+    TMR1L = 0x00;
+    T1CONbits.ON = 1;
+    
+    //TMR2: LFINTOSC, 1:1, ~1 ms period
+    T2CON = 0x00;
+    T2CLKCON = 0b0100;
+    T2HLT = 0x00;
+    T2PR = POWER_TMR2_1MS_PERIOD;
+    
+    //TMR2 wakes the CPU from IDLE, but does not vector (GIE = 0)
+    PIR3bits.TMR2IF = 0;
+    PIE3bits.TMR2IE = 1;
+    
+    Power_clearStats();
+}
+
+//Enters IDLE until any enabled peripheral interrupt flag is set
+void Power_idle(void)
+{
+    Power_accumulate(Power_readTimer(), &activeTicks);
+    
+    //IDLE - CPU stops, peripherals keep running
+    CPUDOZEbits.IDLEN = 1;
+    SLEEP();
+    NOP();
+    
+    Power_accumulate(Power_readTimer(), &idleTicks);
+}
+
+//Idles for MS milliseconds
+void Power_delayMs(uint16_t ms)
+{
+    T2TMR = 0x00;
+    PIR3bits.TMR2IF = 0;
+    T2CONbits.ON = 1;
+    
+    while (ms > 0)
+    {
+        //Other peripherals may also wake the CPU
+        while (!PIR3bits.TMR2IF)
+        {
+            Power_idle();
+        }
+        
+        PIR3bits.TMR2IF = 0;
+        ms--;
+    }
+    
+    T2CONbits.ON = 0;
+}
+
+#ifdef POWER_CLOCK_SCALING
+//Switches the CPU to 4 MHz for a burst of transactions
+void Power_beginBurst(void)
+{
+    if (burstDepth == 0)
+    {
+        Power_switchClock(POWER_OSC_FAST);
+        
+        //Time before the switch is not at the fast clock
+        Power_accumulate(Power_readTimer(), &activeTicks);
+    }
+    
+    burstDepth++;
+}
+
+//Ends a burst. The CPU returns to 1 MHz when the outermost burst ends
+void Power_endBurst(void)
+{
+    if (burstDepth == 0)
+    {
+        return;
+    }
+    
+    if (burstDepth == 1)
+    {
+        //Close the burst's fast clock time before switching back
+        Power_accumulate(Power_readTimer(), &activeTicks);
+        Power_switchClock(POWER_OSC_SLOW);
+    }
+    
+    burstDepth--;
+}
+#endif
+
+//Copies the accumulated active and idle time to STATS
+void Power_getStats(Power_Stats* stats)
+{
+    Power_accumulate(Power_readTimer(), &activeTicks);
+    
+    stats->activeTicks = activeTicks;
+    stats->idleTicks = idleTicks;
+    
+#ifdef POWER_CLOCK_SCALING
+    stats->fastTicks = fastTicks;
+    stats->switchTicks = switchTicks;
+    stats->clockSwitches = clockSwitches;
+#else
+    stats->fastTicks = 0;
+    stats->switchTicks = 0;
+    stats->clockSwitches = 0;
+#endif
+}
+
+//Returns the free-running TMR1 count, in 2us ticks
+uint16_t Power_getTicks(void)
+{
+    uint16_t now = Power_readTimer();
+    
+    //Callers that poll the timer also keep the accounting up to date
+    Power_accumulate(now, &activeTicks);
+    
+    return now;
+}
+
+//Returns the time since Power_init, in 2us ticks
+uint32_t Power_getTime(void)
+{
+    Power_accumulate(Power_readTimer(), &activeTicks);
+    
+    return elapsedTicks;
+}
+
+//Returns the percentage of time spent in IDLE since the last clear
+uint8_t Power_getIdlePercent(void)
+{
+    Power_Stats stats;
+    Power_getStats(&stats);
+    
+    //Scale down first to keep the multiply in 32 bits
+    uint32_t idle = stats.idleTicks >> 4;
+    uint32_t total = (stats.activeTicks >> 4) + idle;
+    
+    if (total == 0)
+    {
+        return 0;
+    }
+    
+    return (uint8_t) ((idle * 100) / total);
+}
+
+//Clears the accumulated active and idle time
+void Power_clearStats(void)
+{
+    lastStamp = Power_readTimer();
+    activeTicks = 0;
+    idleTicks = 0;
+    
+#ifdef POWER_CLOCK_SCALING
+    fastTicks = 0;
+    switchTicks = 0;
+    clockSwitches = 0;
+#endif
+}
@@ -0,0 +1,69 @@
+#ifndef POWER_H
+#define	POWER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+    
+//If defined, Power_beginBurst and Power_endBurst raise the CPU clock from 1 MHz to 4 MHz
+//Only the HFINTOSC divider (NDIV) changes, so TMR1 and the I2C clock are not affected
+#define POWER_CLOCK_SCALING
+    
+//Number of TMR1 ticks in 1 ms
+#define POWER_TICKS_PER_MS 500
+    
+    //Time spent running and idling, in 2us ticks of TMR1
+    typedef struct {
+        uint32_t activeTicks;
+        uint32_t idleTicks;
+        uint32_t fastTicks;         //Time (active and idle) at the fast clock
+        uint32_t switchTicks;       //Time spent waiting for clock switches
+        uint16_t clockSwitches;
+    } Power_Stats;
+    
+    //Initializes TMR1 (duty-cycle accounting) and TMR2 (1 ms delays)
+    //TMR1 runs from HFINTOSC and TMR2 from LFINTOSC, so both are independent of the CPU clock
+    void Power_init(void);
+    
+    //Enters IDLE until any enabled peripheral interrupt flag is set
+    //Global interrupts are not required (or used) to wake
+    void Power_idle(void);
+    
+    //Idles for MS milliseconds
+    void Power_delayMs(uint16_t ms);
+    
+#ifdef POWER_CLOCK_SCALING
+    //Switches the CPU to 4 MHz for a burst of transactions. Calls can be nested
+    //Loop-based timing (such as I2C_BUS_FREE_POLLS) runs 4x faster during a burst
+    void Power_beginBurst(void);
+    
+    //Ends a burst. The CPU returns to 1 MHz when the outermost burst ends
+    void Power_endBurst(void);
+#endif
+    
+    //Copies the accumulated active and idle time to STATS
+    //Time is accumulated by Power_idle, Power_getTicks, Power_getTime, Power_getStats and the burst functions
+    //One of them must run at least every 130 ms, or a TMR1 rollover is lost
+    void Power_getStats(Power_Stats* stats);
+    
+    //Returns the free-running TMR1 count, in 2us ticks, and accumulates the time since the last call
+    uint16_t Power_getTicks(void);
+    
+    //Returns the time since Power_init, in 2us ticks (wraps after ~2.4 hours)
+    //Not reset by Power_clearStats, so it can be used as a 32-bit timebase
+    uint32_t Power_getTime(void);
+    
+    //Returns the percentage of time spent in IDLE since the last clear
+    uint8_t Power_getIdlePercent(void);
+    
+    //Clears the accumulated active and idle time
+    void Power_clearStats(void);
+    
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* POWER_H */
+
@@ -0,0 +1,195 @@
+//Client CPU of the simulated board - the setup of i2c-client.X/main.c
+//Built with the client's sources (-DSIM_CPU=1). The main loop is not run, the client works from its ISRs
+
+#include <xc.h>
+
+#include <stdint.h>
+
+#include "sim.h"
+#include "sim_client.h"
+
+#include "i2c_client.h"
+#include "i2c_blockData.h"
+#include "timebase.h"
+
+#define BUFFER_SIZE 16
+#define FIFO_SIZE 16
+
+static volatile uint8_t buffer[BUFFER_SIZE];
+static volatile uint8_t fifo[FIFO_SIZE];
+
+//Extra instruction cycles of the read handler (see SimClient_setReadDelay)
+static uint16_t readDelay = 0;
+
+//Arguments and result of a call made on the client CPU
+static uint8_t callIndex = 0;
+static uint8_t callValue = 0;
+static bool callResult = false;
+
+//Vectors of i2c_client.c (declared with __interrupt, so not in its header)
+void I2C_writeISR(void);
+void I2C_readISR(void);
+void I2C_stopISR(void);
+
+static void SimClient_setup(void)
+{
+    //Timebase for stretch measurements
+    Timebase_init();
+    
+    //Init I/O
+    I2C_initPins();
+    
+    //Init I2C Client
+    I2C_initClient(0x64);
+    
+    //Block Mode Driver Configuration
+    I2C_assignByteWriteHandler(&I2C_BlockData_StoreByte);
+    I2C_assignByteReadHandler(&I2C_BlockData_RequestByte);
+    I2C_assignStopHandler(&I2C_BlockData_onStop);
+    I2C_assignByteUnreadHandler(&I2C_BlockData_UnreadBytes);
+    I2C_assignGeneralCallWriteHandler(&I2C_BlockData_StoreGeneralCallByte);
+    
+    I2C_BlockData_setupReadBuffer(&buffer[0], BUFFER_SIZE);
+    I2C_BlockData_setupWriteBuffer(&buffer[0], BUFFER_SIZE);
+    I2C_BlockData_setupGeneralCallBuffer(&buffer[0], BUFFER_SIZE);
+}
+
+//Read handler that takes readDelay more cycles, like one that computes each byte
+static uint8_t SimClient_slowRequestByte(void)
+{
+    for (uint16_t i = 0; i < readDelay; i++)
+    {
+        NOP();
+    }
+    
+    return I2C_BlockData_RequestByte();
+}
+
+static void SimClient_assignSlowRead(void)
+{
+    I2C_assignByteReadHandler(&SimClient_slowRequestByte);
+}
+
+static void SimClient_assignRead(void)
+{
+    I2C_assignByteReadHandler(&I2C_BlockData_RequestByte);
+}
+
+//Runs the client's setup and connects it to the bus
+void SimClient_init(void)
+{
+    static const Sim_ClientVectors vectors = {
+        .rx = &I2C_readISR,
+        .tx = &I2C_writeISR,
+        .general = &I2C_stopISR,
+        .error = 0
+    };
+    
+    Sim_runOnClient(&SimClient_setup);
+    Sim_attachClient(&vectors);
+}
+
+//Makes the read handler take TCY more instruction cycles (0 restores the handler of main.c)
+void SimClient_setReadDelay(uint16_t tcy)
+{
+    readDelay = tcy;
+    Sim_runOnClient((tcy != 0) ? &SimClient_assignSlowRead : &SimClient_assignRead);
+}
+
+//Returns the longest TX stretch of the client, in ns
+uint32_t SimClient_getWorstTxStretch(void)
+{
+    //Timebase ticks are Fosc / 4 (62.5 ns)
+    return ((uint32_t) I2C_getWorstTxStretch() * 1000) / TIMEBASE_TICKS_PER_US;
+}
+
+//Returns the longest address stretch of the client, in ns
+uint32_t SimClient_getWorstAddressStretch(void)
+{
+    return ((uint32_t) I2C_getWorstAddressStretch() * 1000) / TIMEBASE_TICKS_PER_US;
+}
+
+//Copies the ISR time measured by the client itself (in ns) and its number of STOPs
+//Returns false if the client is built without I2C_CLIENT_ISR_STATS
+bool SimClient_getISRLoad(uint64_t* ns, uint32_t* transactions)
+{
+#ifdef I2C_CLIENT_ISR_STATS
+    uint32_t ticks;
+    I2C_getISRLoad(&ticks, transactions);
+    
+    *ns = ((uint64_t) ticks * 1000) / TIMEBASE_TICKS_PER_US;
+    return true;
+#else
+    return false;
+#endif
+}
+
+//Returns true if the client is built with I2C_TX_PREFETCH
+bool SimClient_hasTxPrefetch(void)
+{
+#ifdef I2C_TX_PREFETCH
+    return true;
+#else
+    return false;
+#endif
+}
+
+//Returns a byte of the client's register buffer
+uint8_t SimClient_peek(uint8_t index)
+{
+    return buffer[index];
+}
+
+static void SimClient_callSetupFifo(void)
+{
+    I2C_BlockData_setupFifo(callIndex, &fifo[0], FIFO_SIZE);
+}
+
+static void SimClient_callPushFifo(void)
+{
+    callResult = I2C_BlockData_pushFifo(callValue);
+}
+
+//Sets up a FIFO register at REG (fill level at REG - 1), holding up to 15 entries
+void SimClient_setupFifo(uint8_t reg)
+{
+    callIndex = reg;
+    Sim_runOnClient(&SimClient_callSetupFifo);
+}
+
+//Adds an entry to the FIFO from the client's main loop. Returns false if it is full
+bool SimClient_pushFifo(uint8_t data)
+{
+    callValue = data;
+    Sim_runOnClient(&SimClient_callPushFifo);
+    return callResult;
+}
+
+//Returns the number of entries in the FIFO
+uint8_t SimClient_getFifoLevel(void)
+{
+    return I2C_BlockData_getFifoLevel();
+}
+
+#ifdef BLOCKDATA_CHANGE_MAP
+static void SimClient_callWriteRegister(void)
+{
+    callResult = I2C_BlockData_writeRegister(callIndex, callValue);
+}
+#endif
+
+//Writes VALUE to byte INDEX of the register buffer from the client's main loop, setting its change bit
+//Returns false if the client is built without BLOCKDATA_CHANGE_MAP, or INDEX is not in the map
+bool SimClient_writeRegister(uint8_t index, uint8_t value)
+{
+#ifdef BLOCKDATA_CHANGE_MAP
+    callIndex = index;
+    callValue = value;
+    Sim_runOnClient(&SimClient_callWriteRegister);
+    return callResult;
+#else
+    (void) index;
+    (void) value;
+    return false;
+#endif
+}
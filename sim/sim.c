@@ -0,0 +1,1707 @@
+//I2C1 and CPU model for building the drivers on a PC
+//
+//Each driver file is built for one CPU. Its SFR accesses call sim_reg(), which
+//  1. completes the previous access of that CPU (a changed value is a write),
+//  2. charges the access to the CPU's time (see the cost model in sim.h),
+//  3. on the host, runs the bus up to the host's time,
+//  4. remembers the register, so the next access can see what was written.
+//Client interrupts run as soon as the bus sets an enabled flag, in vector order,
+//and their writes take effect at the client's own time.
+//
+//The bus moves one phase at a time (START, address, data byte, ACK, Repeated Start,
+//STOP), with the bit time set by the host's I2C1BAUD, I2C1CLK and FME. SCL is held
+//whenever the host or the client must service its buffers first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "sim.h"
+
+//Bits of the registers the model acts on (positions match xc.h)
+#define CON0_EN     0x80
+#define CON0_RSEN   0x40
+#define CON0_S      0x20
+#define CON0_CSTR   0x10
+#define CON0_MDR    0x08
+#define CON0_MODE   0x07
+#define CON1_ACKCNT 0x80
+#define CON1_ACKDT  0x40
+#define CON1_ACKSTAT 0x20
+#define CON2_ACNT   0x80
+#define CON2_GCEN   0x40
+#define CON2_FME    0x20
+#define STAT0_BFRE  0x80
+#define STAT0_SMA   0x40
+#define STAT0_MMA   0x20
+#define STAT0_R     0x10
+#define STAT1_TXBE  0x20
+#define STAT1_CLRBF 0x04
+#define STAT1_RXBF  0x01
+#define PIR_CNTIF   0x80
+#define PIR_WRIF    0x10
+#define PIR_ADRIF   0x08
+#define PIR_PCIF    0x04
+#define PIR_RSCIF   0x02
+#define PIR_SCIF    0x01
+#define ERR_BCLIF   0x20
+#define ERR_NACKIF  0x10
+#define PIR7_RXIF   0x01
+#define PIR7_TXIF   0x02
+#define PIR7_IF     0x04
+#define PIR7_EIF    0x08
+#define PIR3_TMR2IF 0x08
+#define PIR11_TMR4IF 0x08
+#define T2CON_ON    0x80
+#define T4CON_ON    0x80
+
+#define MODE_HOST   0b100
+
+#define SIM_NEVER UINT64_MAX
+
+typedef enum {
+    BUS_IDLE, BUS_START, BUS_START_DONE, BUS_ADDR_DONE, BUS_ADDR_ACK,
+    BUS_TX_NEED, BUS_TX_DONE, BUS_TX_ACK, BUS_RX_NEED, BUS_RX_DONE, BUS_RX_ACK_DONE,
+    BUS_RESTART_WAIT, BUS_RESTART_DONE, BUS_STOP, BUS_STOP_DONE, BUS_LOST
+} BusState;
+
+typedef enum {
+    SOFT_IDLE, SOFT_ADDR, SOFT_RX, SOFT_TX, SOFT_IGNORE
+} SoftState;
+
+typedef struct {
+    uint8_t reg[SIM_REG_COUNT];
+    uint64_t t;                 //Current time (ps)
+    uint64_t tcy;               //Instruction cycle (ps)
+    bool pending;               //An access has not been completed yet
+    Sim_Register last;
+    uint8_t snap;
+    uint64_t lastTime;          //Time of the pending access
+    uint16_t depth;             //Driver calls in progress
+    uint16_t lastDepth;         //Call depth of the pending access
+} Cpu;
+
+static Cpu cpus[SIM_CPU_COUNT];
+static uint8_t current = SIM_HOST;
+
+static struct {
+    BusState state;
+    uint64_t now;
+    uint64_t next;
+    bool waiting;               //Held until a CPU writes a register
+    Sim_Hold hold;              //Reason for the current hold
+    uint64_t holdStart;
+    uint64_t kickAt;            //Time of the latest client register write
+    uint64_t freeAt;            //Bus free time after the last STOP
+    uint8_t shift;
+    bool read;
+    bool first;                 //Next byte is the 1st of the segment (ACNT)
+    bool ack;
+    bool signalled;             //Client TXIF already set for this byte
+    bool delivered;
+    bool clientSelected;
+    bool clientInvolved;
+    bool clientNacked;
+    uint8_t devSelected;        //Bit mask of models addressed in this segment
+    uint8_t devTouched;         //Bit mask of models addressed in this transaction
+    bool contended;             //The other host started with this START
+} bus;
+
+//Pending transaction of the other host (Sim_requestOtherHost)
+static struct {
+    Sim_Timer timer;
+    bool pending;
+    bool withStart;             //Starts with the host's next START
+    uint8_t addrByte;
+    uint8_t bytes;
+} other;
+
+//Software bus on port B of the host (Sim_setupSoftBus)
+static struct {
+    bool enabled;
+    uint8_t sclMask;
+    uint8_t sdaMask;
+    bool scl;                   //Line levels at the last update
+    bool sda;
+    SoftState state;
+    uint8_t shift;
+    uint8_t bits;               //SCL rising edges in the current byte (9 with the ACK)
+    bool read;
+    bool ack;                   //ACK of the current byte (by the model, or by the host on a read)
+    bool sdaLow;                //The model pulls SDA low
+    uint64_t holdUntil;         //The model holds SCL low until then
+    uint64_t stretch;
+    Sim_Device* selected;       //Model addressed in this transaction
+    Sim_Device* devices[SIM_MAX_DEVICES];
+    uint8_t deviceCount;
+} soft;
+
+static bool clientAttached = false;
+static Sim_ClientVectors clientVectors;
+static Sim_Device* devices[SIM_MAX_DEVICES];
+static uint8_t deviceCount = 0;
+
+#define SIM_MAX_TIMERS 8
+static Sim_Timer* timers[SIM_MAX_TIMERS];
+static uint8_t timerCount = 0;
+
+//Host TMR2 (Power_delayMs) and TMR4 (i2c_soft.c)
+static Sim_Timer hostTmr2;
+static Sim_Timer hostTmr4;
+
+static Sim_Stats stats;
+
+static void Sim_commit(Cpu* c, uint8_t cpu);
+static void Bus_advance(uint64_t limit);
+
+void Sim_fail(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "sim: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(2);
+}
+
+//Instruction cycle of the host, from the HFINTOSC divider in OSCCON1 (NDIV)
+static uint64_t Sim_hostTcy(uint8_t osccon1)
+{
+    uint8_t ndiv = osccon1 & 0x0F;
+    uint64_t fosc = SIM_HOST_HFINTOSC_HZ >> ((ndiv > 9) ? 9 : ndiv);
+    return (4ULL * 1000000000000ULL) / fosc;
+}
+
+//Time of one SCL period, from the host's clock settings
+static uint64_t Bus_bitTime(void)
+{
+    Cpu* h = &cpus[SIM_HOST];
+    uint64_t clk;
+    
+    //I2C1CLK: 0b00001 = Fosc, otherwise HFINTOSC
+    if (h->reg[SIM_I2C1CLK] == 0b00001)
+    {
+        clk = (4ULL * 1000000000000ULL) / h->tcy;
+    }
+    else
+    {
+        clk = SIM_HOST_HFINTOSC_HZ;
+    }
+    
+    uint64_t clocks = (h->reg[SIM_I2C1CON2] & CON2_FME) ? 4 : 5;
+    return ((uint64_t) (h->reg[SIM_I2C1BAUD] + 1) * clocks * 1000000000000ULL) / clk;
+}
+
+//Timers
+
+static void Sim_hostTmr2Expire(Sim_Timer* timer)
+{
+    Cpu* h = &cpus[SIM_HOST];
+    h->reg[SIM_PIR3] |= PIR3_TMR2IF;
+    
+    //LFINTOSC (31.25 kHz), period of T2PR + 1 counts
+    uint64_t period = (uint64_t) (h->reg[SIM_T2PR] + 1) * 32 * SIM_PS_PER_US;
+    Sim_startTimer(timer, timer->at + period);
+}
+
+//Period of the host's TMR4 - HFINTOSC (4 MHz) through the T4CON prescaler, T4PR + 1 counts
+static uint64_t Sim_hostTmr4Period(void)
+{
+    Cpu* h = &cpus[SIM_HOST];
+    uint64_t prescale = 1 << ((h->reg[SIM_T4CON] >> 4) & 0x07);
+    
+    return (uint64_t) (h->reg[SIM_T4PR] + 1) * prescale * SIM_PS_PER_US / 4;
+}
+
+static void Sim_hostTmr4Expire(Sim_Timer* timer)
+{
+    cpus[SIM_HOST].reg[SIM_PIR11] |= PIR11_TMR4IF;
+    Sim_startTimer(timer, timer->at + Sim_hostTmr4Period());
+}
+
+void Sim_startTimer(Sim_Timer* timer, uint64_t at)
+{
+    timer->at = at;
+    
+    if (!timer->armed)
+    {
+        if (timerCount >= SIM_MAX_TIMERS)
+        {
+            Sim_fail("too many timers");
+        }
+        timers[timerCount++] = timer;
+        timer->armed = true;
+    }
+}
+
+void Sim_stopTimer(Sim_Timer* timer)
+{
+    for (uint8_t i = 0; i < timerCount; i++)
+    {
+        if (timers[i] == timer)
+        {
+            timers[i] = timers[--timerCount];
+            break;
+        }
+    }
+    
+    timer->armed = false;
+}
+
+//Returns the timer that expires first, or 0
+static Sim_Timer* Sim_nextTimer(void)
+{
+    Sim_Timer* next = 0;
+    
+    for (uint8_t i = 0; i < timerCount; i++)
+    {
+        if ((next == 0) || (timers[i]->at < next->at))
+        {
+            next = timers[i];
+        }
+    }
+    
+    return next;
+}
+
+//Client interrupts
+
+//Flags of the general and error vectors are not latched - they follow the module
+static uint8_t Sim_derivedPir7(Cpu* c, bool host)
+{
+    uint8_t value = 0;
+    
+    if (host)
+    {
+        //Host RX and TX flags are levels
+        if (c->reg[SIM_I2C1STAT1] & STAT1_RXBF)
+        {
+            value |= PIR7_RXIF;
+        }
+        
+        if ((c->reg[SIM_I2C1STAT1] & STAT1_TXBE) && (c->reg[SIM_I2C1CNTL] != 0)
+                && (c->reg[SIM_I2C1STAT0] & STAT0_MMA))
+        {
+            value |= PIR7_TXIF;
+        }
+    }
+    else
+    {
+        //Client RX and TX flags are set by the bus and cleared by software
+        value |= c->reg[SIM_PIR7] & (PIR7_RXIF | PIR7_TXIF);
+    }
+    
+    if (c->reg[SIM_I2C1PIR] & c->reg[SIM_I2C1PIE])
+    {
+        value |= PIR7_IF;
+    }
+    
+    uint8_t err = c->reg[SIM_I2C1ERR];
+    if ((err >> 4) & err & 0x07)
+    {
+        value |= PIR7_EIF;
+    }
+    
+    return value;
+}
+
+//Runs the client ISRs that are pending after a bus event at time AT
+static void Sim_dispatchClient(uint64_t at)
+{
+    Cpu* c = &cpus[SIM_CLIENT];
+    uint16_t runs = 0;
+    
+    if (!clientAttached || !(c->reg[SIM_I2C1CON0] & CON0_EN))
+    {
+        return;
+    }
+    
+    while (1)
+    {
+        uint8_t pending = Sim_derivedPir7(c, false) & c->reg[SIM_PIE7];
+        void (*isr)(void) = 0;
+        
+        if (pending & PIR7_RXIF)
+        {
+            isr = clientVectors.rx;
+        }
+        else if (pending & PIR7_TXIF)
+        {
+            isr = clientVectors.tx;
+        }
+        else if (pending & PIR7_IF)
+        {
+            isr = clientVectors.general;
+        }
+        else if (pending & PIR7_EIF)
+        {
+            isr = clientVectors.error;
+        }
+        
+        if (isr == 0)
+        {
+            return;
+        }
+        
+        if (++runs > 1000)
+        {
+            Sim_fail("client ISR does not clear its flag (PIR7 = 0x%02X)", pending);
+        }
+        
+        if (c->t < at)
+        {
+            stats.idleTime[SIM_CLIENT] += at - c->t;
+            c->t = at;
+        }
+        
+        uint64_t entry = c->t;
+        c->t += SIM_ISR_ENTRY_TCY * c->tcy;
+        
+        uint8_t previous = current;
+        current = SIM_CLIENT;
+        isr();
+        Sim_flush(SIM_CLIENT);
+        current = previous;
+        
+        c->t += SIM_ISR_EXIT_TCY * c->tcy;
+        stats.isrCalls++;
+        stats.isrTime += c->t - entry;
+    }
+}
+
+//Bus
+
+//SCL is held until a register write from a CPU (Bus_kick)
+static void Bus_hold(Sim_Hold reason)
+{
+    if (bus.hold != reason)
+    {
+        bus.hold = reason;
+        bus.holdStart = bus.now;
+    }
+    
+    bus.waiting = true;
+}
+
+//Ends a hold once its condition is met, and counts its length
+//Client ISRs run to completion when their flag is set, so a write can be seen before the
+//client's time reaches it. The phase then waits for the write (returns false), as a hold for REASON
+static bool Bus_release(Sim_Hold reason)
+{
+    if ((reason != SIM_HOLD_HOST) && (bus.kickAt > bus.now))
+    {
+        if (bus.hold == SIM_HOLD_NONE)
+        {
+            bus.hold = reason;
+            bus.holdStart = bus.now;
+        }
+        
+        bus.next = bus.kickAt;
+        return false;
+    }
+    
+    if (bus.hold == SIM_HOLD_NONE)
+    {
+        return true;
+    }
+    
+    uint64_t length = bus.now - bus.holdStart;
+    stats.holds[bus.hold]++;
+    stats.holdTime[bus.hold] += length;
+    if (length > stats.holdWorst[bus.hold])
+    {
+        stats.holdWorst[bus.hold] = length;
+    }
+    
+    bus.hold = SIM_HOLD_NONE;
+    return true;
+}
+
+//Re-checks a hold after a register write at time T
+static void Bus_kick(uint64_t t)
+{
+    if ((current == SIM_CLIENT) && (t > bus.kickAt))
+    {
+        bus.kickAt = t;
+    }
+    
+    if (!bus.waiting)
+    {
+        return;
+    }
+    
+    bus.waiting = false;
+    bus.next = (t > bus.now) ? t : bus.now;
+}
+
+static bool Bus_clientActive(void)
+{
+    Cpu* c = &cpus[SIM_CLIENT];
+    return clientAttached && (c->reg[SIM_I2C1CON0] & CON0_EN) && ((c->reg[SIM_I2C1CON0] & CON0_MODE) != MODE_HOST);
+}
+
+//Matches the address byte against the client and the models
+static void Bus_address(uint8_t byte)
+{
+    Cpu* c = &cpus[SIM_CLIENT];
+    bool read = (byte & 0x01);
+    
+    bus.read = read;
+    bus.clientSelected = false;
+    bus.clientNacked = false;
+    bus.devSelected = 0;
+    
+    if (Bus_clientActive())
+    {
+        bool match = ((byte & 0xFE) == (c->reg[SIM_I2C1ADR0] & 0xFE));
+        bool generalCall = ((byte == 0x00) && (c->reg[SIM_I2C1CON2] & CON2_GCEN));
+        
+        if (match || generalCall)
+        {
+            bus.clientSelected = true;
+            bus.clientInvolved = true;
+            
+            c->reg[SIM_I2C1STAT0] |= STAT0_SMA;
+            c->reg[SIM_I2C1STAT0] = (c->reg[SIM_I2C1STAT0] & ~STAT0_R) | (read ? STAT0_R : 0);
+            c->reg[SIM_I2C1ADB0] = byte;
+            c->reg[SIM_I2C1PIR] |= PIR_ADRIF;
+            
+            //Address hold - SCL stays low until software clears CSTR
+            if (c->reg[SIM_I2C1PIE] & 0x08)
+            {
+                c->reg[SIM_I2C1CON0] |= CON0_CSTR;
+            }
+        }
+        else
+        {
+            c->reg[SIM_I2C1STAT0] &= ~(STAT0_SMA | STAT0_R);
+        }
+    }
+    
+    for (uint8_t i = 0; i < deviceCount; i++)
+    {
+        Sim_Device* dev = devices[i];
+        bool match = ((byte >> 1) == dev->addr) || ((byte == 0x00) && dev->generalCall);
+        
+        if (match && dev->start(dev, read))
+        {
+            bus.devSelected |= (1 << i);
+            bus.devTouched |= (1 << i);
+        }
+    }
+}
+
+//Bus time of the other host's transaction, START to STOP
+static uint64_t Other_duration(void)
+{
+    return (2 + 9 * ((uint64_t) other.bytes + 1)) * Bus_bitTime();
+}
+
+//The other host's transaction runs from AT - the bus is busy until it ends
+static void Other_run(uint64_t at)
+{
+    uint64_t end = at + Other_duration();
+    
+    if (end + Bus_bitTime() / 2 > bus.freeAt)
+    {
+        bus.freeAt = end + Bus_bitTime() / 2;
+    }
+    
+    other.pending = false;
+    stats.otherHost++;
+    stats.otherTime += end - at;
+}
+
+//The other host wants to start. Like the host's module, it waits for the bus to be free
+static void Other_start(Sim_Timer* timer)
+{
+    uint64_t at = timer->at;
+    
+    if (bus.state == BUS_START)
+    {
+        if (bus.next <= at + SIM_START_WINDOW)
+        {
+            //Both STARTs are on the bus at once
+            other.withStart = true;
+        }
+        else if (at < bus.freeAt)
+        {
+            Sim_startTimer(timer, bus.freeAt);
+        }
+        else
+        {
+            //The other host is first - the host's START waits until its STOP
+            Other_run(at);
+            bus.next = bus.freeAt;
+        }
+        return;
+    }
+    
+    if (bus.state == BUS_IDLE)
+    {
+        if (at < bus.freeAt)
+        {
+            Sim_startTimer(timer, bus.freeAt);
+        }
+        else
+        {
+            Other_run(at);
+        }
+        return;
+    }
+    
+    //The host's transaction is running - check again after each bit
+    Sim_startTimer(timer, at + Bus_bitTime());
+}
+
+//Returns the bit (0 = MSB) where the host's address byte HOST loses to OTHER, or -1 if the host wins
+//Open drain: the 1st host to send a 1 where the other sends a 0 loses
+static int8_t Bus_arbitrate(uint8_t host, uint8_t otherByte)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        uint8_t mask = 0x80 >> i;
+        
+        if ((host & mask) != (otherByte & mask))
+        {
+            return (host & mask) ? (int8_t) i : -1;
+        }
+    }
+    
+    //Same address byte - neither sees a difference here. The model lets the host continue
+    return -1;
+}
+
+//Returns the ACK the client sends for a received byte (CNT already decremented)
+static bool Bus_clientAck(void)
+{
+    Cpu* c = &cpus[SIM_CLIENT];
+    uint8_t bit = (c->reg[SIM_I2C1CNTL] != 0) ? CON1_ACKDT : CON1_ACKCNT;
+    return !(c->reg[SIM_I2C1CON1] & bit);
+}
+
+//Runs the phase that is due at bus.next
+static void Bus_step(void)
+{
+    Cpu* h = &cpus[SIM_HOST];
+    Cpu* c = &cpus[SIM_CLIENT];
+    uint64_t bit = Bus_bitTime();
+    
+    bus.now = bus.next;
+    
+    switch (bus.state)
+    {
+        case BUS_IDLE:
+        {
+            return;
+        }
+        case BUS_START:
+        {
+            h->reg[SIM_I2C1STAT0] |= STAT0_MMA;
+            h->reg[SIM_I2C1PIR] |= PIR_SCIF;
+            bus.devTouched = 0;
+            bus.clientInvolved = false;
+            stats.starts++;
+            
+            bus.contended = other.pending && other.withStart;
+            if (bus.contended)
+            {
+                Sim_stopTimer(&other.timer);
+                other.pending = false;
+            }
+            
+            bus.state = BUS_START_DONE;
+            bus.next = bus.now + bit;
+            return;
+        }
+        case BUS_START_DONE:
+        case BUS_RESTART_DONE:
+        {
+            if (bus.state == BUS_RESTART_DONE)
+            {
+                h->reg[SIM_I2C1PIR] |= PIR_RSCIF;
+                if (bus.clientSelected)
+                {
+                    c->reg[SIM_I2C1PIR] |= PIR_RSCIF;
+                }
+            }
+            else if (Bus_clientActive())
+            {
+                c->reg[SIM_I2C1PIR] |= PIR_SCIF;
+            }
+            
+            h->reg[SIM_I2C1CON0] &= ~CON0_S;
+            bus.shift = h->reg[SIM_I2C1ADB1];
+            bus.first = true;
+            
+            if (bus.contended)
+            {
+                //Both hosts send their address byte
+                bus.contended = false;
+                int8_t lost = Bus_arbitrate(bus.shift, other.addrByte);
+                
+                if (lost >= 0)
+                {
+                    //The other host keeps the bus from its START (1 bit ago)
+                    Other_run(bus.now - bit);
+                    bus.state = BUS_LOST;
+                    bus.next = bus.now + (lost + 1) * bit;
+                    return;
+                }
+                
+                //The other host lost, and backs off (it is not retried)
+            }
+            
+            bus.state = BUS_ADDR_DONE;
+            bus.next = bus.now + 8 * bit;
+            return;
+        }
+        case BUS_ADDR_DONE:
+        {
+            Bus_address(bus.shift);
+            bus.state = BUS_ADDR_ACK;
+            return;
+        }
+        case BUS_ADDR_ACK:
+        {
+            if (bus.clientSelected && (c->reg[SIM_I2C1PIE] & 0x08))
+            {
+                if (c->reg[SIM_I2C1CON0] & CON0_CSTR)
+                {
+                    Bus_hold(SIM_HOLD_CLIENT_ADDRESS);
+                    return;
+                }
+                
+                if (!Bus_release(SIM_HOLD_CLIENT_ADDRESS))
+                {
+                    return;
+                }
+            }
+            
+            if (bus.clientSelected && (c->reg[SIM_I2C1CON1] & CON1_ACKDT))
+            {
+                //Client NACKs its address
+                bus.clientSelected = false;
+            }
+            
+            bool ack = bus.clientSelected || (bus.devSelected != 0);
+            h->reg[SIM_I2C1CON1] = (h->reg[SIM_I2C1CON1] & ~CON1_ACKSTAT) | (ack ? 0 : CON1_ACKSTAT);
+            bus.next = bus.now + bit;
+            bus.signalled = false;
+            
+            if (!ack)
+            {
+                h->reg[SIM_I2C1ERR] |= ERR_NACKIF;
+                stats.nacks++;
+                bus.state = BUS_STOP;
+            }
+            else
+            {
+                bus.state = (bus.read) ? BUS_RX_NEED : BUS_TX_NEED;
+            }
+            return;
+        }
+        case BUS_TX_NEED:
+        {
+            if (h->reg[SIM_I2C1STAT1] & STAT1_TXBE)
+            {
+                h->reg[SIM_I2C1CON0] |= CON0_MDR;
+                Bus_hold(SIM_HOLD_HOST);
+                return;
+            }
+            if (!Bus_release(SIM_HOLD_HOST))
+            {
+                return;
+            }
+            
+            h->reg[SIM_I2C1CON0] &= ~CON0_MDR;
+            bus.shift = h->reg[SIM_I2C1TXB];
+            h->reg[SIM_I2C1STAT1] |= STAT1_TXBE;
+            bus.delivered = false;
+            
+            bus.state = BUS_TX_DONE;
+            bus.next = bus.now + 8 * bit;
+            return;
+        }
+        case BUS_TX_DONE:
+        {
+            if (!bus.delivered)
+            {
+                //The client must read the previous byte before it can take this one
+                if (bus.clientSelected && (c->reg[SIM_I2C1STAT1] & STAT1_RXBF))
+                {
+                    Bus_hold(SIM_HOLD_CLIENT_RX);
+                    return;
+                }
+                if (!Bus_release(SIM_HOLD_CLIENT_RX))
+            {
+                return;
+            }
+                
+                bus.ack = false;
+                bus.delivered = true;
+                stats.bytes++;
+                
+                if (bus.clientSelected)
+                {
+                    c->reg[SIM_I2C1RXB] = bus.shift;
+                    c->reg[SIM_I2C1STAT1] |= STAT1_RXBF;
+                    c->reg[SIM_PIR7] |= PIR7_RXIF;
+                    c->reg[SIM_I2C1CNTL]--;
+                    
+                    //Hold before the ACK, so software can set ACKDT
+                    if (c->reg[SIM_I2C1PIE] & PIR_WRIF)
+                    {
+                        c->reg[SIM_I2C1PIR] |= PIR_WRIF;
+                        c->reg[SIM_I2C1CON0] |= CON0_CSTR;
+                    }
+                }
+                
+                for (uint8_t i = 0; i < deviceCount; i++)
+                {
+                    if ((bus.devSelected & (1 << i)) && devices[i]->write(devices[i], bus.shift))
+                    {
+                        bus.ack = true;
+                    }
+                }
+            }
+            
+            bus.state = BUS_TX_ACK;
+            return;
+        }
+        case BUS_TX_ACK:
+        {
+            if (bus.clientSelected && (c->reg[SIM_I2C1PIE] & PIR_WRIF))
+            {
+                if (c->reg[SIM_I2C1CON0] & CON0_CSTR)
+                {
+                    Bus_hold(SIM_HOLD_CLIENT_WRITE);
+                    return;
+                }
+                
+                if (!Bus_release(SIM_HOLD_CLIENT_WRITE))
+                {
+                    return;
+                }
+            }
+            
+            bool ack = bus.ack || (bus.clientSelected && Bus_clientAck());
+            h->reg[SIM_I2C1CON1] = (h->reg[SIM_I2C1CON1] & ~CON1_ACKSTAT) | (ack ? 0 : CON1_ACKSTAT);
+            
+            h->reg[SIM_I2C1CNTL]--;
+            if (h->reg[SIM_I2C1CNTL] == 0)
+            {
+                h->reg[SIM_I2C1PIR] |= PIR_CNTIF;
+            }
+            
+            bus.next = bus.now + bit;
+            
+            if (!ack)
+            {
+                h->reg[SIM_I2C1ERR] |= ERR_NACKIF;
+                stats.nacks++;
+                bus.state = BUS_STOP;
+            }
+            else if (h->reg[SIM_I2C1CNTL] != 0)
+            {
+                bus.state = BUS_TX_NEED;
+            }
+            else
+            {
+                bus.state = (h->reg[SIM_I2C1CON0] & CON0_RSEN) ? BUS_RESTART_WAIT : BUS_STOP;
+            }
+            return;
+        }
+        case BUS_RX_NEED:
+        {
+            if (bus.clientSelected)
+            {
+                //TXIF requests the byte - SCL is held until I2C1TXB is written
+                if (!bus.signalled)
+                {
+                    bus.signalled = true;
+                    c->reg[SIM_PIR7] |= PIR7_TXIF;
+                    return;
+                }
+                
+                if (c->reg[SIM_I2C1STAT1] & STAT1_TXBE)
+                {
+                    Bus_hold(SIM_HOLD_CLIENT_TX);
+                    return;
+                }
+                
+                if (!Bus_release(SIM_HOLD_CLIENT_TX))
+                {
+                    return;
+                }
+            }
+            
+            //The host cannot take another byte until I2C1RXB is read
+            if (h->reg[SIM_I2C1STAT1] & STAT1_RXBF)
+            {
+                h->reg[SIM_I2C1CON0] |= CON0_MDR;
+                Bus_hold(SIM_HOLD_HOST);
+                return;
+            }
+            if (!Bus_release(SIM_HOLD_HOST))
+            {
+                return;
+            }
+            
+            h->reg[SIM_I2C1CON0] &= ~CON0_MDR;
+            
+            if (bus.clientSelected)
+            {
+                bus.shift = c->reg[SIM_I2C1TXB];
+                c->reg[SIM_I2C1STAT1] |= STAT1_TXBE;
+            }
+            else
+            {
+                for (uint8_t i = 0; i < deviceCount; i++)
+                {
+                    if (bus.devSelected & (1 << i))
+                    {
+                        bus.shift = devices[i]->read(devices[i]);
+                        break;
+                    }
+                }
+            }
+            
+            bus.state = BUS_RX_DONE;
+            bus.next = bus.now + 8 * bit;
+            return;
+        }
+        case BUS_RX_DONE:
+        {
+            h->reg[SIM_I2C1RXB] = bus.shift;
+            h->reg[SIM_I2C1STAT1] |= STAT1_RXBF;
+            stats.bytes++;
+            
+            //ACNT loads the count from the 1st byte of the read
+            if (bus.first && (h->reg[SIM_I2C1CON2] & CON2_ACNT))
+            {
+                h->reg[SIM_I2C1CNTL] = bus.shift;
+            }
+            else
+            {
+                h->reg[SIM_I2C1CNTL]--;
+            }
+            bus.first = false;
+            
+            if (h->reg[SIM_I2C1CNTL] == 0)
+            {
+                h->reg[SIM_I2C1PIR] |= PIR_CNTIF;
+            }
+            
+            if (bus.clientSelected)
+            {
+                c->reg[SIM_I2C1CNTL]--;
+            }
+            
+            uint8_t ackBit = (h->reg[SIM_I2C1CNTL] != 0) ? CON1_ACKDT : CON1_ACKCNT;
+            bus.ack = !(h->reg[SIM_I2C1CON1] & ackBit);
+            
+            bus.state = BUS_RX_ACK_DONE;
+            bus.next = bus.now + bit;
+            return;
+        }
+        case BUS_RX_ACK_DONE:
+        {
+            bus.signalled = false;
+            
+            if (bus.clientSelected)
+            {
+                c->reg[SIM_I2C1CON1] = (c->reg[SIM_I2C1CON1] & ~CON1_ACKSTAT) | (bus.ack ? 0 : CON1_ACKSTAT);
+            }
+            
+            if (bus.ack)
+            {
+                bus.state = BUS_RX_NEED;
+                return;
+            }
+            
+            if (bus.clientSelected)
+            {
+                //A byte is still requested after the final NACK, but SCL is not held for it
+                bus.clientNacked = true;
+                c->reg[SIM_PIR7] |= PIR7_TXIF;
+            }
+            
+            bus.state = (h->reg[SIM_I2C1CON0] & CON0_RSEN) ? BUS_RESTART_WAIT : BUS_STOP;
+            return;
+        }
+        case BUS_RESTART_WAIT:
+        {
+            if (!(h->reg[SIM_I2C1CON0] & CON0_S))
+            {
+                h->reg[SIM_I2C1CON0] |= CON0_MDR;
+                Bus_hold(SIM_HOLD_HOST);
+                return;
+            }
+            if (!Bus_release(SIM_HOLD_HOST))
+            {
+                return;
+            }
+            
+            h->reg[SIM_I2C1CON0] &= ~CON0_MDR;
+            stats.restarts++;
+            
+            bus.state = BUS_RESTART_DONE;
+            bus.next = bus.now + bit;
+            return;
+        }
+        case BUS_STOP:
+        {
+            bus.state = BUS_STOP_DONE;
+            bus.next = bus.now + bit;
+            return;
+        }
+        case BUS_STOP_DONE:
+        {
+            h->reg[SIM_I2C1STAT0] &= ~STAT0_MMA;
+            h->reg[SIM_I2C1CON0] &= ~(CON0_MDR | CON0_S);
+            h->reg[SIM_I2C1PIR] |= PIR_PCIF;
+            
+            if (bus.clientInvolved)
+            {
+                c->reg[SIM_I2C1STAT0] &= ~(STAT0_SMA | STAT0_R);
+                c->reg[SIM_I2C1PIR] |= PIR_PCIF;
+            }
+            
+            for (uint8_t i = 0; i < deviceCount; i++)
+            {
+                if ((bus.devTouched & (1 << i)) && (devices[i]->stop != 0))
+                {
+                    devices[i]->stop(devices[i]);
+                }
+            }
+            
+            bus.clientSelected = false;
+            bus.devSelected = 0;
+            bus.freeAt = bus.now + bit / 2;
+            bus.state = BUS_IDLE;
+            stats.stops++;
+            return;
+        }
+        case BUS_LOST:
+        {
+            //Arbitration lost: the host's module leaves host mode and flags the collision
+            h->reg[SIM_I2C1STAT0] &= ~STAT0_MMA;
+            h->reg[SIM_I2C1CON0] &= ~(CON0_MDR | CON0_S);
+            h->reg[SIM_I2C1ERR] |= ERR_BCLIF;
+            
+            bus.state = BUS_IDLE;
+            stats.arbitrationLost++;
+            return;
+        }
+    }
+}
+
+//Runs bus phases and timers that are due up to LIMIT
+static void Bus_advance(uint64_t limit)
+{
+    while (1)
+    {
+        uint64_t busAt = ((bus.state != BUS_IDLE) && !bus.waiting) ? bus.next : SIM_NEVER;
+        Sim_Timer* timer = Sim_nextTimer();
+        uint64_t timerAt = (timer != 0) ? timer->at : SIM_NEVER;
+        
+        if ((busAt > limit) && (timerAt > limit))
+        {
+            return;
+        }
+        
+        uint64_t at;
+        
+        if (timerAt <= busAt)
+        {
+            at = timerAt;
+            Sim_stopTimer(timer);
+            timer->expire(timer);
+        }
+        else
+        {
+            at = busAt;
+            Bus_step();
+        }
+        
+        Sim_dispatchClient(at);
+    }
+}
+
+//Time of the next bus phase or timer, or SIM_NEVER
+static uint64_t Bus_nextEvent(void)
+{
+    uint64_t at = ((bus.state != BUS_IDLE) && !bus.waiting) ? bus.next : SIM_NEVER;
+    Sim_Timer* timer = Sim_nextTimer();
+    
+    if ((timer != 0) && (timer->at < at))
+    {
+        at = timer->at;
+    }
+    
+    return at;
+}
+
+//A START (S set by the host) begins once the bus is free
+static void Bus_requestStart(uint64_t t)
+{
+    if (bus.state == BUS_IDLE)
+    {
+        bus.state = BUS_START;
+        bus.waiting = false;
+        bus.next = (t > bus.freeAt) ? t : bus.freeAt;
+    }
+    else if (bus.state == BUS_RESTART_WAIT)
+    {
+        Bus_kick(t);
+    }
+}
+
+//Software bus
+//The models on it see the lines change as the host writes TRISB, and decode them bit by bit
+
+//START or Repeated START - the models listen for an address
+static void Soft_start(void)
+{
+    soft.state = SOFT_ADDR;
+    soft.bits = 0;
+    soft.sdaLow = false;
+    stats.softStarts++;
+}
+
+//STOP - the model addressed in the transaction sees the end
+static void Soft_stop(void)
+{
+    if (soft.selected != 0)
+    {
+        soft.selected->stop(soft.selected);
+    }
+    
+    soft.state = SOFT_IDLE;
+    soft.selected = 0;
+    soft.sdaLow = false;
+}
+
+//Matches an address byte against the models. Returns the ACK
+static bool Soft_address(uint8_t byte)
+{
+    soft.read = (byte & 0x01);
+    
+    for (uint8_t i = 0; i < soft.deviceCount; i++)
+    {
+        Sim_Device* dev = soft.devices[i];
+        bool match = ((byte >> 1) == dev->addr) || ((byte == 0x00) && dev->generalCall);
+        
+        if (match && dev->start(dev, soft.read))
+        {
+            soft.selected = dev;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+//SCL rising edge - the receiver samples SDA
+static void Soft_rise(void)
+{
+    if ((soft.state == SOFT_IDLE) || (soft.state == SOFT_IGNORE))
+    {
+        return;
+    }
+    
+    soft.bits++;
+    
+    if (soft.state == SOFT_TX)
+    {
+        //ACK clock of a byte sent by the model - the host ACKs (SDA low) for more
+        if (soft.bits == 9)
+        {
+            soft.ack = !soft.sda;
+        }
+        return;
+    }
+    
+    if (soft.bits <= 8)
+    {
+        soft.shift = (uint8_t) ((soft.shift << 1) | (soft.sda ? 0x01 : 0x00));
+    }
+    
+    if (soft.bits == 8)
+    {
+        if (soft.state == SOFT_ADDR)
+        {
+            soft.ack = Soft_address(soft.shift);
+        }
+        else
+        {
+            soft.ack = soft.selected->write(soft.selected, soft.shift);
+            stats.softBytes++;
+        }
+    }
+}
+
+//SCL falling edge at time T - the transmitter sets up SDA
+static void Soft_fall(uint64_t t)
+{
+    if ((soft.state == SOFT_IDLE) || (soft.state == SOFT_IGNORE))
+    {
+        return;
+    }
+    
+    if (soft.bits == 8)
+    {
+        //ACK clock - a receiving model drives the ACK, a sending one releases SDA for the host
+        soft.sdaLow = (soft.state != SOFT_TX) && soft.ack;
+        return;
+    }
+    
+    if (soft.bits == 9)
+    {
+        soft.bits = 0;
+        soft.sdaLow = false;
+        
+        //NACK - wait for a STOP or Repeated START
+        if (!soft.ack)
+        {
+            soft.state = SOFT_IGNORE;
+            return;
+        }
+        
+        if (soft.state == SOFT_ADDR)
+        {
+            soft.state = (soft.read) ? SOFT_TX : SOFT_RX;
+        }
+        
+        if (soft.state == SOFT_TX)
+        {
+            soft.shift = soft.selected->read(soft.selected);
+            stats.softBytes++;
+        }
+        
+        //Clock stretch before the next byte
+        soft.holdUntil = (soft.stretch == SIM_SOFT_STUCK) ? SIM_NEVER : t + soft.stretch;
+    }
+    
+    //Next data bit of a byte sent by the model, MSB first
+    if (soft.state == SOFT_TX)
+    {
+        soft.sdaLow = !(soft.shift & (0x80 >> soft.bits));
+    }
+}
+
+//Updates the lines at time T, after the host's pins may have changed, and shows them in PORTB
+static void Soft_update(uint64_t t)
+{
+    if (!soft.enabled)
+    {
+        return;
+    }
+    
+    Cpu* h = &cpus[SIM_HOST];
+    uint8_t driven = (uint8_t) (~h->reg[SIM_TRISB] & ~h->reg[SIM_LATB]);
+    
+    bool scl = !(driven & soft.sclMask) && (t >= soft.holdUntil);
+    if (scl != soft.scl)
+    {
+        soft.scl = scl;
+        if (scl)
+        {
+            Soft_rise();
+        }
+        else
+        {
+            Soft_fall(t);
+        }
+    }
+    
+    //SDA changing while SCL is high is a START (falling) or a STOP (rising)
+    bool sda = !(driven & soft.sdaMask) && !soft.sdaLow;
+    if (sda != soft.sda)
+    {
+        soft.sda = sda;
+        if (soft.scl)
+        {
+            if (sda)
+            {
+                Soft_stop();
+            }
+            else
+            {
+                Soft_start();
+            }
+        }
+    }
+    
+    uint8_t lines = (scl ? soft.sclMask : 0) | (sda ? soft.sdaMask : 0);
+    h->reg[SIM_PORTB] = (h->reg[SIM_PORTB] & ~(soft.sclMask | soft.sdaMask)) | lines;
+}
+
+//CPU side
+
+//Updates the bits that the hardware drives, before software reads REG
+static void Sim_publish(Cpu* c, uint8_t cpu, Sim_Register reg)
+{
+    bool host = (cpu == SIM_HOST);
+    
+    switch (reg)
+    {
+        case SIM_I2C1STAT0:
+        {
+            bool free = host && (bus.state == BUS_IDLE) && (c->t >= bus.freeAt);
+            c->reg[reg] = (c->reg[reg] & ~STAT0_BFRE) | (free ? STAT0_BFRE : 0);
+            break;
+        }
+        case SIM_PIR7:
+        {
+            c->reg[reg] = (c->reg[reg] & 0xF0) | Sim_derivedPir7(c, host);
+            break;
+        }
+        case SIM_TMR1L:
+        {
+            //Host: HFINTOSC / 8 (2 us). Client: Fosc / 4. Reading TMR1L latches TMR1H
+            uint64_t ticks = c->t / (host ? (2 * SIM_PS_PER_US) : c->tcy);
+            c->reg[SIM_TMR1L] = (uint8_t) ticks;
+            c->reg[SIM_TMR1H] = (uint8_t) (ticks >> 8);
+            break;
+        }
+        case SIM_OSCCON2:
+        {
+            c->reg[reg] = c->reg[SIM_OSCCON1];
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+//Applies a software write of VALUE over OLD
+static void Sim_write(Cpu* c, uint8_t cpu, Sim_Register reg, uint8_t old, uint8_t value, uint64_t t)
+{
+    bool host = (cpu == SIM_HOST);
+    
+    switch (reg)
+    {
+        case SIM_I2C1CON0:
+        {
+            uint8_t keep = CON0_MDR;
+            
+            //The client can only clear CSTR
+            if (host || !(old & CON0_CSTR))
+            {
+                keep |= CON0_CSTR;
+            }
+            
+            value = (value & ~keep) | (old & keep);
+            c->reg[reg] = value;
+            
+            if (host && (value & CON0_S) && !(old & CON0_S) && (value & CON0_EN))
+            {
+                Bus_requestStart(t);
+            }
+            
+            Bus_kick(t);
+            break;
+        }
+        case SIM_I2C1CON1:
+        {
+            c->reg[reg] = (value & ~CON1_ACKSTAT) | (old & CON1_ACKSTAT);
+            break;
+        }
+        case SIM_I2C1STAT0:
+        case SIM_I2C1ADB0:
+        case SIM_PORTB:
+        case SIM_OSCCON2:
+        case SIM_TMR1H:
+        case SIM_TMR1L:
+        {
+            //Read only for software (TMR1 free-runs from the CPU's time)
+            c->reg[reg] = old;
+            break;
+        }
+        case SIM_I2C1STAT1:
+        {
+            value = (value & ~(STAT1_RXBF | STAT1_TXBE)) | (old & (STAT1_RXBF | STAT1_TXBE));
+            
+            if (value & STAT1_CLRBF)
+            {
+                value = (value & ~(STAT1_CLRBF | STAT1_RXBF)) | STAT1_TXBE;
+                
+                if (!host)
+                {
+                    c->reg[SIM_PIR7] &= ~PIR7_RXIF;
+                }
+            }
+            
+            c->reg[reg] = value;
+            Bus_kick(t);
+            break;
+        }
+        case SIM_PIR7:
+        {
+            //Host flags and the client's general flags follow the module
+            uint8_t keep = host ? 0x0F : (PIR7_IF | PIR7_EIF);
+            c->reg[reg] = (value & ~keep) | (old & keep);
+            break;
+        }
+        case SIM_OSCCON1:
+        {
+            if (host)
+            {
+                c->tcy = Sim_hostTcy(value);
+            }
+            break;
+        }
+        case SIM_T4CON:
+        case SIM_T4TMR:
+        {
+            //Writing TMR4 restarts the period
+            if (host)
+            {
+                if (c->reg[SIM_T4CON] & T4CON_ON)
+                {
+                    Sim_startTimer(&hostTmr4, t + Sim_hostTmr4Period());
+                }
+                else
+                {
+                    Sim_stopTimer(&hostTmr4);
+                }
+            }
+            break;
+        }
+        case SIM_T2CON:
+        case SIM_T2TMR:
+        {
+            if (host)
+            {
+                if (c->reg[SIM_T2CON] & T2CON_ON)
+                {
+                    uint64_t period = (uint64_t) (c->reg[SIM_T2PR] + 1) * 32 * SIM_PS_PER_US;
+                    Sim_startTimer(&hostTmr2, t + period);
+                }
+                else
+                {
+                    Sim_stopTimer(&hostTmr2);
+                }
+            }
+            break;
+        }
+        default:
+        {
+            Bus_kick(t);
+            break;
+        }
+    }
+}
+
+//Completes the pending access of a CPU
+static void Sim_commit(Cpu* c, uint8_t cpu)
+{
+    if (!c->pending)
+    {
+        return;
+    }
+    
+    c->pending = false;
+    Sim_Register reg = c->last;
+    
+    if (reg == SIM_I2C1TXB)
+    {
+        //Every I2C1TXB access in the drivers is a write
+        c->reg[SIM_I2C1STAT1] &= ~STAT1_TXBE;
+        Bus_kick(c->lastTime);
+    }
+    else if (reg == SIM_I2C1RXB)
+    {
+        //Every I2C1RXB access in the drivers is a read
+        c->reg[SIM_I2C1STAT1] &= ~STAT1_RXBF;
+        if (cpu != SIM_HOST)
+        {
+            c->reg[SIM_PIR7] &= ~PIR7_RXIF;
+        }
+        Bus_kick(c->lastTime);
+    }
+    else if (c->reg[reg] != c->snap)
+    {
+        Sim_write(c, cpu, reg, c->snap, c->reg[reg], c->lastTime);
+    }
+}
+
+volatile uint8_t* sim_reg(uint8_t cpu, Sim_Register reg)
+{
+    Cpu* c = &cpus[cpu];
+    
+    Sim_commit(c, cpu);
+    
+    c->t += SIM_ACCESS_TCY * c->tcy;
+    stats.accesses[cpu]++;
+    
+    if (cpu == SIM_HOST)
+    {
+        Bus_advance(c->t);
+        Soft_update(c->t);
+    }
+    
+    Sim_publish(c, cpu, reg);
+    
+    c->pending = true;
+    c->last = reg;
+    c->snap = c->reg[reg];
+    c->lastTime = c->t;
+    c->lastDepth = c->depth;
+    
+    return &c->reg[reg];
+}
+
+//Returns true if an enabled peripheral flag is set (wakes the CPU from SLEEP or IDLE)
+static bool Sim_wakeFlag(Cpu* c, uint8_t cpu)
+{
+    uint8_t pir7 = Sim_derivedPir7(c, cpu == SIM_HOST);
+    
+    return ((pir7 & c->reg[SIM_PIE7]) != 0)
+            || ((c->reg[SIM_PIR3] & c->reg[SIM_PIE3]) != 0)
+            || ((c->reg[SIM_PIR11] & c->reg[SIM_PIE11]) != 0);
+}
+
+void sim_sleep(uint8_t cpu)
+{
+    Cpu* c = &cpus[cpu];
+    
+    if (cpu != SIM_HOST)
+    {
+        Sim_fail("only the host CPU can sleep (the client runs from its ISRs)");
+    }
+    
+    Sim_commit(c, cpu);
+    Bus_advance(c->t);
+    
+    while (!Sim_wakeFlag(c, cpu))
+    {
+        uint64_t at = Bus_nextEvent();
+        
+        if (at == SIM_NEVER)
+        {
+            Sim_fail("host sleeps with no wake-up source");
+        }
+        
+        if (at > c->t)
+        {
+            stats.idleTime[cpu] += at - c->t;
+            c->t = at;
+        }
+        
+        Bus_advance(c->t);
+    }
+}
+
+void sim_nop(uint8_t cpu)
+{
+    cpus[cpu].t += cpus[cpu].tcy;
+}
+
+//Called on entry to every function of the drivers (-finstrument-functions)
+void __cyg_profile_func_enter(void* fn, void* site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void* fn, void* site) __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void* fn, void* site)
+{
+    (void) fn;
+    (void) site;
+    
+    cpus[current].t += SIM_CALL_TCY * cpus[current].tcy;
+    cpus[current].depth++;
+    stats.calls[current]++;
+}
+
+void __cyg_profile_func_exit(void* fn, void* site)
+{
+    (void) fn;
+    (void) site;
+    
+    Cpu* c = &cpus[current];
+    c->depth--;
+    
+    //GCC may look up the register before calling the function that computes its value
+    //(I2C1TXB = handler()). A call that returns to the pending access's code ran before the store
+    if (c->pending && (c->depth == c->lastDepth))
+    {
+        c->lastTime = c->t;
+    }
+}
+
+//Harness API
+
+void Sim_reset(void)
+{
+    memset(cpus, 0, sizeof(cpus));
+    memset(&bus, 0, sizeof(bus));
+    memset(&stats, 0, sizeof(stats));
+    memset(&hostTmr2, 0, sizeof(hostTmr2));
+    memset(&hostTmr4, 0, sizeof(hostTmr4));
+    memset(&other, 0, sizeof(other));
+    memset(&soft, 0, sizeof(soft));
+    
+    for (uint8_t i = 0; i < SIM_CPU_COUNT; i++)
+    {
+        Cpu* c = &cpus[i];
+        c->reg[SIM_TRISB] = 0xFF;
+        c->reg[SIM_TRISC] = 0xFF;
+        c->reg[SIM_ANSELB] = 0xFF;
+        c->reg[SIM_ANSELC] = 0xFF;
+        c->reg[SIM_PORTB] = 0xFF;
+        c->reg[SIM_PORTC] = 0xFF;
+        c->reg[SIM_I2C1STAT1] = STAT1_TXBE;
+    }
+    
+    //Host starts at 1 MHz (HFINTOSC 4 MHz / 4), client at 64 MHz
+    cpus[SIM_HOST].reg[SIM_OSCCON1] = 0x62;
+    cpus[SIM_HOST].tcy = Sim_hostTcy(0x62);
+    cpus[SIM_CLIENT].reg[SIM_OSCCON1] = 0x60;
+    cpus[SIM_CLIENT].tcy = (4ULL * 1000000000000ULL) / SIM_CLIENT_FOSC_HZ;
+    
+    hostTmr2.expire = &Sim_hostTmr2Expire;
+    hostTmr4.expire = &Sim_hostTmr4Expire;
+    other.timer.expire = &Other_start;
+    
+    bus.state = BUS_IDLE;
+    clientAttached = false;
+    deviceCount = 0;
+    timerCount = 0;
+    current = SIM_HOST;
+}
+
+void Sim_runOnClient(void (*fn)(void))
+{
+    Cpu* c = &cpus[SIM_CLIENT];
+    uint8_t previous = current;
+    
+    //Client code runs at the host's time
+    if (c->t < cpus[SIM_HOST].t)
+    {
+        c->t = cpus[SIM_HOST].t;
+    }
+    
+    current = SIM_CLIENT;
+    fn();
+    Sim_flush(SIM_CLIENT);
+    current = previous;
+}
+
+void Sim_attachClient(const Sim_ClientVectors* vectors)
+{
+    clientVectors = *vectors;
+    clientAttached = true;
+}
+
+void Sim_attachDevice(Sim_Device* dev)
+{
+    if (deviceCount >= SIM_MAX_DEVICES)
+    {
+        Sim_fail("too many devices");
+    }
+    
+    devices[deviceCount++] = dev;
+}
+
+bool Sim_requestOtherHost(uint64_t at, uint8_t addrByte, uint8_t bytes)
+{
+    if (other.pending)
+    {
+        return false;
+    }
+    
+    other.pending = true;
+    other.withStart = (at == SIM_WITH_NEXT_START);
+    other.addrByte = addrByte;
+    other.bytes = bytes;
+    
+    if (!other.withStart)
+    {
+        Sim_startTimer(&other.timer, at);
+    }
+    return true;
+}
+
+void Sim_setupSoftBus(uint8_t sclPin, uint8_t sdaPin)
+{
+    soft.enabled = true;
+    soft.sclMask = (1 << sclPin);
+    soft.sdaMask = (1 << sdaPin);
+    soft.scl = true;
+    soft.sda = true;
+    soft.state = SOFT_IDLE;
+    
+    Soft_update(cpus[SIM_HOST].t);
+}
+
+void Sim_attachSoftDevice(Sim_Device* dev)
+{
+    if (soft.deviceCount >= SIM_MAX_DEVICES)
+    {
+        Sim_fail("too many devices on the software bus");
+    }
+    
+    soft.devices[soft.deviceCount++] = dev;
+}
+
+void Sim_setSoftStretch(uint64_t time)
+{
+    soft.stretch = time;
+    soft.holdUntil = 0;
+}
+
+void Sim_setHostPin(Sim_Register port, uint8_t pin, bool level)
+{
+    Cpu* h = &cpus[SIM_HOST];
+    uint8_t mask = (1 << pin);
+    bool was = (h->reg[port] & mask);
+    
+    h->reg[port] = (h->reg[port] & ~mask) | (level ? mask : 0);
+    
+    //Interrupt-on-Change (port B only)
+    if (port == SIM_PORTB)
+    {
+        bool fall = was && !level && (h->reg[SIM_IOCBN] & mask);
+        bool rise = !was && level && (h->reg[SIM_IOCBP] & mask);
+        
+        if (fall || rise)
+        {
+            h->reg[SIM_IOCBF] |= mask;
+        }
+    }
+}
+
+uint64_t Sim_now(uint8_t cpu)
+{
+    return cpus[cpu].t;
+}
+
+uint64_t Sim_busTime(void)
+{
+    return bus.now;
+}
+
+void Sim_flush(uint8_t cpu)
+{
+    Sim_commit(&cpus[cpu], cpu);
+    
+    if (cpu == SIM_HOST)
+    {
+        Bus_advance(cpus[cpu].t);
+    }
+}
+
+void Sim_getStats(Sim_Stats* copy)
+{
+    *copy = stats;
+}
+
+void Sim_clearStats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
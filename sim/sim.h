@@ -0,0 +1,161 @@
+#ifndef SIM_H
+#define	SIM_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim_regs.h"
+
+//CPUs on the simulated board - each driver file is built for one of them (-DSIM_CPU=n)
+#define SIM_HOST 0
+#define SIM_CLIENT 1
+#define SIM_CPU_COUNT 2
+
+//Time is counted in picoseconds
+#define SIM_PS_PER_US 1000000ULL
+#define SIM_PS_PER_MS 1000000000ULL
+
+//CPU cost model, in instruction cycles (Tcy = 4 / Fosc)
+//The drivers run as native code, so only SFR accesses, calls and NOPs take simulated time
+#define SIM_ACCESS_TCY 2
+#define SIM_CALL_TCY 4
+#define SIM_ISR_ENTRY_TCY 5
+#define SIM_ISR_EXIT_TCY 2
+
+//Clocks of the two boards
+#define SIM_HOST_HFINTOSC_HZ 4000000UL
+#define SIM_CLIENT_FOSC_HZ 64000000UL
+
+//Most models that can be attached to the bus besides the client CPU
+#define SIM_MAX_DEVICES 4
+
+//A START by the other host this close to the host's START is not seen in time, so both arbitrate
+#define SIM_START_WINDOW (SIM_PS_PER_US / 4)
+
+//Time for Sim_requestOtherHost - start together with the host's next START
+#define SIM_WITH_NEXT_START UINT64_MAX
+
+//Stretch for Sim_setSoftStretch - SCL is held until the next call
+#define SIM_SOFT_STUCK UINT64_MAX
+    
+    //Reasons the bus can be held (SCL low)
+    typedef enum {
+        SIM_HOLD_NONE = 0,
+        SIM_HOLD_HOST,              //Host waits for I2C1TXB, I2C1RXB or a Repeated Start
+        SIM_HOLD_CLIENT_ADDRESS,    //Client holds SCL after an address match (CSTR)
+        SIM_HOLD_CLIENT_TX,         //Client has not loaded I2C1TXB for the host's read
+        SIM_HOLD_CLIENT_RX,         //Client has not read the previous byte from I2C1RXB
+        SIM_HOLD_CLIENT_WRITE,      //Client holds SCL before the ACK of a received byte (WRIF)
+        SIM_HOLD_COUNT
+    } Sim_Hold;
+    
+    //Bus and CPU counters since the last Sim_clearStats
+    typedef struct {
+        uint32_t starts;
+        uint32_t restarts;
+        uint32_t stops;
+        uint32_t bytes;             //Data bytes, without address bytes
+        uint32_t nacks;             //Address or data bytes NACKed (not the final NACK of a read)
+        uint32_t holds[SIM_HOLD_COUNT];
+        uint64_t holdTime[SIM_HOLD_COUNT];
+        uint64_t holdWorst[SIM_HOLD_COUNT];
+        uint32_t accesses[SIM_CPU_COUNT];   //SFR accesses
+        uint32_t calls[SIM_CPU_COUNT];      //Function calls
+        uint64_t idleTime[SIM_CPU_COUNT];   //Time in SLEEP / IDLE
+        uint32_t isrCalls;                  //Client ISRs run
+        uint64_t isrTime;                   //Client time from ISR entry to exit
+        uint32_t otherHost;                 //Transactions of the other host
+        uint64_t otherTime;                 //Bus time used by the other host
+        uint32_t arbitrationLost;           //Host transactions lost to the other host
+        uint32_t softStarts;                //STARTs and Repeated STARTs on the software bus
+        uint32_t softBytes;                 //Data bytes on the software bus
+    } Sim_Stats;
+    
+    //Behavioral model of a client device
+    typedef struct Sim_Device {
+        uint8_t addr;               //7-bit address
+        bool generalCall;           //Also responds to the General Call address
+        bool (*start)(struct Sim_Device* dev, bool read);   //Address matched - returns the ACK
+        bool (*write)(struct Sim_Device* dev, uint8_t data); //Returns the ACK
+        uint8_t (*read)(struct Sim_Device* dev);
+        void (*stop)(struct Sim_Device* dev);
+        void* context;
+    } Sim_Device;
+    
+    //One-shot event at a simulated time
+    typedef struct Sim_Timer {
+        uint64_t at;
+        bool armed;
+        void (*expire)(struct Sim_Timer* timer);
+        void* context;
+    } Sim_Timer;
+    
+    //Interrupt vectors of the client, in the order they are served
+    typedef struct {
+        void (*rx)(void);
+        void (*tx)(void);
+        void (*general)(void);
+        void (*error)(void);
+    } Sim_ClientVectors;
+    
+    //Resets both CPUs, the bus and the counters
+    void Sim_reset(void);
+    
+    //Runs FN as code of the client CPU (e.g. its initialization)
+    void Sim_runOnClient(void (*fn)(void));
+    
+    //Connects the client CPU's I2C1 to the bus and sets its interrupt vectors
+    void Sim_attachClient(const Sim_ClientVectors* vectors);
+    
+    //Connects a behavioral model to the bus
+    void Sim_attachDevice(Sim_Device* dev);
+    
+    //Arms TIMER to expire at AT (simulated time in ps)
+    void Sim_startTimer(Sim_Timer* timer, uint64_t at);
+    void Sim_stopTimer(Sim_Timer* timer);
+    
+    //Another host on the bus (multi-host contention). At AT, or once the bus is free, it sends a START,
+    //ADDRBYTE (7-bit address << 1 | R/W), BYTES data bytes and a STOP. The client does not take part
+    //With AT = SIM_WITH_NEXT_START it starts together with the host's next START, and the two arbitrate
+    //Returns false if a request is still pending
+    bool Sim_requestOtherHost(uint64_t at, uint8_t addrByte, uint8_t bytes);
+    
+    //Software bus (i2c_soft.c) on pins SCLPIN and SDAPIN of the host's port B. A line is low if the host
+    //drives it (TRIS and LAT bits clear) or a model on the bus pulls it low. i2c_soft.c reaches TRIS and
+    //PORT through pointers, so the model sees its pin writes at the host's next SFR access, and they take no time
+    void Sim_setupSoftBus(uint8_t sclPin, uint8_t sdaPin);
+    
+    //Connects a behavioral model to the software bus
+    void Sim_attachSoftDevice(Sim_Device* dev);
+    
+    //Models on the software bus hold SCL low for TIME (ps) after each byte they ACK or send
+    //(SIM_SOFT_STUCK: until the next call). Ends any hold in progress
+    void Sim_setSoftStretch(uint64_t time);
+    
+    //Drives an input pin of the host, e.g. the expander's !INT on RB4
+    //A falling edge sets the IOC flag if the negative edge detector is enabled
+    void Sim_setHostPin(Sim_Register port, uint8_t pin, bool level);
+    
+    //Current time of a CPU, and the time of the bus
+    uint64_t Sim_now(uint8_t cpu);
+    uint64_t Sim_busTime(void);
+    
+    //Completes the last SFR access of the CPU (call before checking its results)
+    void Sim_flush(uint8_t cpu);
+    
+    //Copies or clears the counters
+    void Sim_getStats(Sim_Stats* stats);
+    void Sim_clearStats(void);
+    
+    //Reports a model error and exits
+    void Sim_fail(const char* format, ...);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SIM_H */
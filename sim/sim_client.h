@@ -0,0 +1,48 @@
+#ifndef SIM_CLIENT_H
+#define	SIM_CLIENT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+    
+    //Runs the setup of i2c-client.X/main.c on the client CPU and connects it to the bus
+    void SimClient_init(void);
+    
+    //Makes the client's read handler take TCY more instruction cycles (0 restores the handler of main.c)
+    void SimClient_setReadDelay(uint16_t tcy);
+    
+    //Returns the longest TX and address stretches measured by the client, in ns
+    uint32_t SimClient_getWorstTxStretch(void);
+    uint32_t SimClient_getWorstAddressStretch(void);
+    
+    //Copies the ISR time measured by the client itself (in ns) and its number of STOPs
+    //Returns false if the client is built without I2C_CLIENT_ISR_STATS
+    bool SimClient_getISRLoad(uint64_t* ns, uint32_t* transactions);
+    
+    //Returns true if the client is built with I2C_TX_PREFETCH
+    bool SimClient_hasTxPrefetch(void);
+    
+    //Returns a byte of the client's register buffer
+    uint8_t SimClient_peek(uint8_t index);
+    
+    //Sets up a FIFO register at REG (fill level at REG - 1), holding up to 15 entries
+    void SimClient_setupFifo(uint8_t reg);
+    
+    //Adds an entry to the FIFO from the client's main loop. Returns false if it is full
+    bool SimClient_pushFifo(uint8_t data);
+    
+    //Returns the number of entries in the FIFO
+    uint8_t SimClient_getFifoLevel(void);
+    
+    //Writes VALUE to byte INDEX of the register buffer from the client's main loop, setting its change bit
+    //Returns false if the client is built without BLOCKDATA_CHANGE_MAP, or INDEX is not in the map
+    bool SimClient_writeRegister(uint8_t index, uint8_t value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SIM_CLIENT_H */
@@ -0,0 +1,216 @@
+//Behavioral model of the I/O expander used by advanced_IO.c
+//
+//The 1st byte of a write sets the register pointer, and later bytes are written from there.
+//Reads start at the pointer. Both auto-increment. PORTx returns LATx on outputs and the
+//input levels on inputs. Writing the memory operation register (0xA0) with an opcode and
+//the two unlock keys starts the operation at STOP. The expander NACKs its address until
+//the operation completes, then pulses !INT (RB4 of the host) low.
+
+#include <string.h>
+
+#include "sim_expander.h"
+
+//Registers that can be written (ERROR and PORTx are read only, 0x07 is not implemented)
+static bool SimExpander_isWritable(uint8_t reg)
+{
+    return (reg < SIM_EXP_REG_COUNT) && (reg != SIM_EXP_ERROR) && (reg != SIM_EXP_PORT) && (reg != SIM_EXP_RESERVED);
+}
+
+//Power-on and "reset to default" values
+static void SimExpander_defaults(SimExpander* x)
+{
+    memset(x->reg, 0, sizeof(x->reg));
+    x->reg[SIM_EXP_TRIS] = 0xFF;
+}
+
+static bool SimExpander_start(Sim_Device* dev, bool read)
+{
+    SimExpander* x = (SimExpander*) dev->context;
+    
+    if (x->busy)
+    {
+        return false;
+    }
+    
+    if (!read)
+    {
+        x->pointerSet = false;
+        x->memCount = 0;
+    }
+    
+    return true;
+}
+
+static bool SimExpander_write(Sim_Device* dev, uint8_t data)
+{
+    SimExpander* x = (SimExpander*) dev->context;
+    
+    if (!x->pointerSet)
+    {
+        x->pointer = data;
+        x->pointerSet = true;
+        return true;
+    }
+    
+    if (x->pointer == SIM_EXP_MEM_OP)
+    {
+        //Opcode and keys - the pointer does not move
+        if (x->memCount < sizeof(x->memBytes))
+        {
+            x->memBytes[x->memCount] = data;
+        }
+        x->memCount++;
+        return true;
+    }
+    
+    if (SimExpander_isWritable(x->pointer))
+    {
+        x->reg[x->pointer] = data;
+        
+        if (x->logCount < SIM_EXP_LOG_SIZE)
+        {
+            x->logReg[x->logCount] = x->pointer;
+            x->logValue[x->logCount] = data;
+            x->logCount++;
+        }
+    }
+    
+    x->pointer++;
+    return true;
+}
+
+static uint8_t SimExpander_read(Sim_Device* dev)
+{
+    SimExpander* x = (SimExpander*) dev->context;
+    uint8_t value = 0x00;
+    
+    if (x->pointer == SIM_EXP_PORT)
+    {
+        uint8_t tris = x->reg[SIM_EXP_TRIS];
+        value = (x->reg[SIM_EXP_LAT] & ~tris) | (x->inputs & tris);
+    }
+    else if (x->pointer < SIM_EXP_REG_COUNT)
+    {
+        value = x->reg[x->pointer];
+    }
+    
+    x->pointer++;
+    return value;
+}
+
+static void SimExpander_stop(Sim_Device* dev)
+{
+    SimExpander* x = (SimExpander*) dev->context;
+    
+    //Opcode followed by both keys, and nothing else
+    bool unlocked = (x->pointerSet) && (x->pointer == SIM_EXP_MEM_OP) && (x->memCount == 3)
+            && (x->memBytes[1] == SIM_EXP_UNLOCK_1) && (x->memBytes[2] == SIM_EXP_UNLOCK_2);
+    
+    x->memCount = 0;
+    
+    if (!unlocked)
+    {
+        return;
+    }
+    
+    x->opCode = x->memBytes[0];
+    x->busy = true;
+    
+    //Saves write the expander's memory, and take longer
+    uint8_t op = (x->opCode >> 4) & 0b11;
+    uint64_t time = (op & 0b01) ? SIM_EXP_SAVE_TIME : SIM_EXP_LOAD_TIME;
+    Sim_startTimer(&x->done, Sim_busTime() + time);
+}
+
+//Memory operation complete
+static void SimExpander_done(Sim_Timer* timer)
+{
+    SimExpander* x = (SimExpander*) timer->context;
+    uint8_t op = (x->opCode >> 4) & 0b11;
+    
+    switch (op)
+    {
+        case 0b00:
+        {
+            SimExpander_defaults(x);
+            break;
+        }
+        case 0b01:
+        {
+            memcpy(x->saved, x->reg, sizeof(x->saved));
+            break;
+        }
+        case 0b10:
+        {
+            memcpy(x->reg, x->saved, sizeof(x->reg));
+            break;
+        }
+        default:
+        {
+            memcpy(x->saved, x->reg, sizeof(x->saved));
+            memcpy(x->reg, x->saved, sizeof(x->reg));
+            break;
+        }
+    }
+    
+    x->busy = false;
+    x->memOps++;
+    
+    if (x->intConnected && !x->intStuck)
+    {
+        Sim_setHostPin(SIM_PORTB, 4, false);
+        Sim_startTimer(&x->release, timer->at + SIM_EXP_INT_TIME);
+    }
+}
+
+//End of the !INT pulse
+static void SimExpander_release(Sim_Timer* timer)
+{
+    (void) timer;
+    Sim_setHostPin(SIM_PORTB, 4, true);
+}
+
+//Resets X to its defaults and attaches it to the bus
+void SimExpander_init(SimExpander* x, uint8_t addr, bool generalCall)
+{
+    memset(x, 0, sizeof(*x));
+    SimExpander_defaults(x);
+    memcpy(x->saved, x->reg, sizeof(x->saved));
+    
+    x->intConnected = true;
+    
+    x->dev.addr = addr;
+    x->dev.generalCall = generalCall;
+    x->dev.start = &SimExpander_start;
+    x->dev.write = &SimExpander_write;
+    x->dev.read = &SimExpander_read;
+    x->dev.stop = &SimExpander_stop;
+    x->dev.context = x;
+    
+    x->done.expire = &SimExpander_done;
+    x->done.context = x;
+    x->release.expire = &SimExpander_release;
+    x->release.context = x;
+    
+    Sim_attachDevice(&x->dev);
+}
+
+//Clears the write log
+void SimExpander_clearLog(SimExpander* x)
+{
+    x->logCount = 0;
+}
+
+//Returns the position of the 1st write to REG in the log, or -1
+int8_t SimExpander_findWrite(const SimExpander* x, uint8_t reg)
+{
+    for (uint8_t i = 0; i < x->logCount; i++)
+    {
+        if (x->logReg[i] == reg)
+        {
+            return (int8_t) i;
+        }
+    }
+    
+    return -1;
+}
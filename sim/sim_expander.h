@@ -0,0 +1,80 @@
+#ifndef SIM_EXPANDER_H
+#define	SIM_EXPANDER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim.h"
+
+//Registers of the I/O expander (see advanced_IO.h)
+#define SIM_EXP_REG_COUNT 12
+#define SIM_EXP_ERROR 0x00
+#define SIM_EXP_IOC 0x01
+#define SIM_EXP_PORT 0x02
+#define SIM_EXP_TRIS 0x03
+#define SIM_EXP_LAT 0x04
+#define SIM_EXP_RESERVED 0x07
+#define SIM_EXP_WPU 0x08
+
+//Memory operation register and unlock keys
+#define SIM_EXP_MEM_OP 0xA0
+#define SIM_EXP_UNLOCK_1 0xA5
+#define SIM_EXP_UNLOCK_2 0xF0
+
+//Time the expander is busy (address NACKed) during a memory operation
+#define SIM_EXP_LOAD_TIME (2 * SIM_PS_PER_MS)
+#define SIM_EXP_SAVE_TIME (10 * SIM_PS_PER_MS)
+
+//Length of the !INT pulse at the end of a memory operation
+#define SIM_EXP_INT_TIME (50 * SIM_PS_PER_US)
+
+//Most register writes kept in the log
+#define SIM_EXP_LOG_SIZE 32
+    
+    //Behavioral model of the I/O expander
+    typedef struct {
+        Sim_Device dev;
+        uint8_t reg[SIM_EXP_REG_COUNT];
+        uint8_t saved[SIM_EXP_REG_COUNT];   //Registers saved in the expander's memory
+        uint8_t inputs;                     //Level on the pins that are inputs
+        bool intConnected;                  //!INT drives the host's RB4
+        bool intStuck;                      //!INT never asserts (for timeout tests)
+        
+        //Register pointer - set by the 1st byte of each write
+        uint8_t pointer;
+        bool pointerSet;
+        
+        //Memory operation - the unlock sequence is checked at STOP
+        uint8_t memBytes[3];
+        uint8_t memCount;
+        bool busy;
+        uint8_t opCode;
+        uint16_t memOps;                    //Memory operations completed
+        Sim_Timer done;
+        Sim_Timer release;
+        
+        //Register writes, in bus order
+        uint8_t logReg[SIM_EXP_LOG_SIZE];
+        uint8_t logValue[SIM_EXP_LOG_SIZE];
+        uint8_t logCount;
+    } SimExpander;
+    
+    //Resets X to its defaults and attaches it to the bus at 7-bit address ADDR
+    //GENERALCALL selects if it also responds to the General Call address
+    void SimExpander_init(SimExpander* x, uint8_t addr, bool generalCall);
+    
+    //Clears the write log
+    void SimExpander_clearLog(SimExpander* x);
+    
+    //Returns the position of the 1st write to REG in the log, or -1
+    int8_t SimExpander_findWrite(const SimExpander* x, uint8_t reg);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SIM_EXPANDER_H */
@@ -0,0 +1,61 @@
+//Host CPU of the simulated board - the setup of i2c-host.X/main.c, and result printing
+
+#include <stdio.h>
+
+#include "sim.h"
+#include "sim_host.h"
+
+#include "i2c_host.h"
+#include "power.h"
+
+//Resets the simulation and sets up the host like main.c
+void SimHost_init(void)
+{
+    Sim_reset();
+    
+    //Init I/O
+    I2C_initPins();
+    
+    //Init I2C Host
+    I2C_initHost();
+    
+    //TMR1 and TMR2
+    Power_init();
+}
+
+//Prints the bus and CPU counters since the last Sim_clearStats
+void SimHost_printStats(void)
+{
+    static const char* const names[SIM_HOLD_COUNT] = {
+        "", "host", "client address", "client TX", "client RX", "client write"
+    };
+    
+    Sim_Stats stats;
+    Sim_getStats(&stats);
+    
+    printf("  bus: %u starts, %u restarts, %u stops, %u data bytes, %u NACKs\n",
+            stats.starts, stats.restarts, stats.stops, stats.bytes, stats.nacks);
+    
+    for (uint8_t i = SIM_HOLD_HOST; i < SIM_HOLD_COUNT; i++)
+    {
+        if (stats.holds[i] == 0)
+        {
+            continue;
+        }
+        
+        printf("  SCL held by %s: %u times, avg %.2f us, worst %.2f us\n", names[i], stats.holds[i],
+                (double) stats.holdTime[i] / stats.holds[i] / SIM_PS_PER_US,
+                (double) stats.holdWorst[i] / SIM_PS_PER_US);
+    }
+    
+    if (stats.otherHost != 0)
+    {
+        printf("  other host: %u transactions, %.1f ms of bus time, won arbitration %u times\n",
+                stats.otherHost, (double) stats.otherTime / SIM_PS_PER_MS, stats.arbitrationLost);
+    }
+    
+    printf("  host: %u SFR accesses, %u calls, %.1f ms idle\n", stats.accesses[SIM_HOST],
+            stats.calls[SIM_HOST], (double) stats.idleTime[SIM_HOST] / SIM_PS_PER_MS);
+    printf("  client: %u SFR accesses, %u calls, %u ISRs (%.1f ms)\n", stats.accesses[SIM_CLIENT],
+            stats.calls[SIM_CLIENT], stats.isrCalls, (double) stats.isrTime / SIM_PS_PER_MS);
+}
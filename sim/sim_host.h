@@ -0,0 +1,19 @@
+#ifndef SIM_HOST_H
+#define	SIM_HOST_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+    //Resets the simulation and runs the setup of i2c-host.X/main.c on the host CPU
+    //(pins, I2C1 in host mode, TMR1 and TMR2). The client is connected separately
+    void SimHost_init(void);
+    
+    //Prints the bus and CPU counters since the last Sim_clearStats
+    void SimHost_printStats(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SIM_HOST_H */
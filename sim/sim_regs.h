@@ -0,0 +1,38 @@
+#ifndef SIM_REGS_H
+#define	SIM_REGS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+//Special function registers of one simulated CPU (each CPU has its own copy)
+#define SIM_REGISTERS(X) \
+    X(I2C1CON0) X(I2C1CON1) X(I2C1CON2) X(I2C1CON3) \
+    X(I2C1STAT0) X(I2C1STAT1) X(I2C1PIR) X(I2C1PIE) X(I2C1ERR) \
+    X(I2C1CNTL) X(I2C1CNTH) X(I2C1ADB0) X(I2C1ADB1) \
+    X(I2C1ADR0) X(I2C1ADR1) X(I2C1ADR2) X(I2C1ADR3) \
+    X(I2C1TXB) X(I2C1RXB) X(I2C1BAUD) X(I2C1CLK) X(I2C1BTO) X(I2C1BTOC) \
+    X(I2C1SCLPPS) X(I2C1SDAPPS) \
+    X(PIR3) X(PIE3) X(IPR3) X(PIR7) X(PIE7) X(IPR7) X(PIR11) X(PIE11) X(IPR11) \
+    X(INTCON0) X(CPUDOZE) X(OSCCON1) X(OSCCON2) \
+    X(T1CON) X(T1CLK) X(TMR1H) X(TMR1L) \
+    X(T2CON) X(T2CLKCON) X(T2HLT) X(T2PR) X(T2TMR) \
+    X(T4CON) X(T4CLKCON) X(T4HLT) X(T4PR) X(T4TMR) \
+    X(ANSELB) X(TRISB) X(PORTB) X(LATB) X(WPUB) X(IOCBN) X(IOCBP) X(IOCBF) \
+    X(ANSELC) X(TRISC) X(PORTC) X(LATC) X(ODCONC) \
+    X(RC3I2C) X(RC4I2C) X(RC3PPS) X(RC4PPS)
+
+#define SIM_REG_ID(name) SIM_##name,
+    
+    typedef enum {
+        SIM_REGISTERS(SIM_REG_ID)
+        SIM_REG_COUNT
+    } Sim_Register;
+
+#undef SIM_REG_ID
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SIM_REGS_H */
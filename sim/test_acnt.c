@@ -0,0 +1,207 @@
+//Length-prefixed block reads (user guide: "I2C_registerReadBlock") on the simulated bus
+//Compares I2C_registerReadBlock, where Auto-Load (ACNT) takes the count from the length byte,
+//with 2 I2C_registerWriteRead calls (read the length, then the length and the block).
+//The host's SFR accesses, calls and bus time are counted for each
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_host.h"
+
+#include "i2c_host.h"
+
+#define DEVICE_ADDR 0x40
+#define BLOCK_REG 0x10
+#define MAX_BLOCK 32
+#define READS 50
+
+//Device with a length-prefixed block at BLOCK_REG, like an SMBus Block Read
+typedef struct {
+    Sim_Device dev;
+    uint8_t length;
+    uint8_t data[MAX_BLOCK];
+    uint8_t pointer;
+    uint8_t index;
+    bool pointerSet;
+} BlockDevice;
+
+//Cost of one method, per read
+typedef struct {
+    uint32_t accesses;
+    uint32_t calls;
+    uint32_t transactions;
+    uint64_t time;
+    uint32_t errors;
+} Cost;
+
+static BlockDevice device;
+
+static bool Block_start(Sim_Device* dev, bool read)
+{
+    BlockDevice* d = (BlockDevice*) dev->context;
+    
+    if (!read)
+    {
+        d->pointerSet = false;
+    }
+    d->index = 0;
+    return true;
+}
+
+static bool Block_write(Sim_Device* dev, uint8_t data)
+{
+    BlockDevice* d = (BlockDevice*) dev->context;
+    
+    if (!d->pointerSet)
+    {
+        d->pointer = data;
+        d->pointerSet = true;
+    }
+    return true;
+}
+
+static uint8_t Block_read(Sim_Device* dev)
+{
+    BlockDevice* d = (BlockDevice*) dev->context;
+    uint8_t index = d->index++;
+    
+    if (d->pointer != BLOCK_REG)
+    {
+        return 0xFF;
+    }
+    
+    //Length, then the block
+    if (index == 0)
+    {
+        return d->length;
+    }
+    return (index <= d->length) ? d->data[index - 1] : 0xFF;
+}
+
+static void Block_stop(Sim_Device* dev)
+{
+    (void) dev;
+}
+
+//Checks the block read into DATA
+static bool Test_checkBlock(const uint8_t* data, uint8_t len)
+{
+    if (len != device.length)
+    {
+        return false;
+    }
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] != device.data[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Reads the block READS times, with I2C_registerReadBlock if AUTOLOAD, else with 2 reads
+static void Test_run(bool autoLoad, Cost* cost)
+{
+    uint8_t data[MAX_BLOCK + 1];
+    Sim_Stats stats;
+    
+    Sim_clearStats();
+    I2C_clearTransactionCount();
+    uint64_t start = Sim_now(SIM_HOST);
+    
+    for (uint16_t n = 0; n < READS; n++)
+    {
+        if (autoLoad)
+        {
+            uint8_t len;
+            
+            if (!I2C_registerReadBlock(DEVICE_ADDR, BLOCK_REG, &data[0], MAX_BLOCK, &len)
+                    || !Test_checkBlock(&data[0], len))
+            {
+                cost->errors++;
+            }
+        }
+        else
+        {
+            //Length first, then the length again with the block
+            if (!I2C_registerWriteRead(DEVICE_ADDR, BLOCK_REG, &data[0], 1)
+                    || (data[0] > MAX_BLOCK)
+                    || !I2C_registerWriteRead(DEVICE_ADDR, BLOCK_REG, &data[0], data[0] + 1)
+                    || !Test_checkBlock(&data[1], data[0]))
+            {
+                cost->errors++;
+            }
+        }
+    }
+    
+    Sim_flush(SIM_HOST);
+    Sim_getStats(&stats);
+    
+    cost->time = (Sim_now(SIM_HOST) - start) / READS;
+    cost->accesses = stats.accesses[SIM_HOST] / READS;
+    cost->calls = stats.calls[SIM_HOST] / READS;
+    cost->transactions = I2C_getTransactionCount() / READS;
+}
+
+int main(void)
+{
+    static const uint8_t lengths[] = {1, 4, 16, 32};
+    uint32_t errors = 0;
+    bool faster = true;
+    
+    SimHost_init();
+    
+    device.dev.addr = DEVICE_ADDR;
+    device.dev.start = &Block_start;
+    device.dev.write = &Block_write;
+    device.dev.read = &Block_read;
+    device.dev.stop = &Block_stop;
+    device.dev.context = &device;
+    Sim_attachDevice(&device.dev);
+    
+    for (uint8_t i = 0; i < MAX_BLOCK; i++)
+    {
+        device.data[i] = (uint8_t) (0x30 + i);
+    }
+    
+    printf("length-prefixed block read, per read (%u reads)\n", READS);
+    printf("  %-6s | %-36s | %-36s\n", "length", "I2C_registerReadBlock (ACNT)", "2x I2C_registerWriteRead");
+    
+    for (uint8_t i = 0; i < sizeof(lengths); i++)
+    {
+        Cost block = {0};
+        Cost split = {0};
+        
+        device.length = lengths[i];
+        Test_run(true, &block);
+        Test_run(false, &split);
+        
+        printf("  %6u | %u trans, %4u SFR, %3u calls, %6.1f us | %u trans, %4u SFR, %3u calls, %6.1f us\n", lengths[i],
+                block.transactions, block.accesses, block.calls, (double) block.time / SIM_PS_PER_US,
+                split.transactions, split.accesses, split.calls, (double) split.time / SIM_PS_PER_US);
+        
+        errors += block.errors + split.errors;
+        if ((block.accesses >= split.accesses) || (block.time >= split.time))
+        {
+            faster = false;
+        }
+    }
+    
+    if (errors != 0)
+    {
+        printf("FAIL: %u errors\n", errors);
+        return 1;
+    }
+    
+    if (!faster)
+    {
+        printf("FAIL: I2C_registerReadBlock is not cheaper than 2 reads\n");
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,331 @@
+//Urgent request latency of the bus arbiter (i2c_arbiter.c) on the simulated bus
+//A bulk register write to a memory device runs without a break, while urgent writes to the
+//I/O expander arrive at random times. Each urgent write is timed from its arrival to its completion,
+//once without the arbiter (after the whole bulk write) and once with it (after 1 bulk chunk)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "sim_expander.h"
+#include "sim_host.h"
+
+#include "i2c_arbiter.h"
+#include "i2c_host.h"
+#include "power.h"
+
+#define EXPANDER_ADDR 0x60
+#define MEMORY_ADDR 0x50
+#define BULK_SIZE 240
+#define URGENT_EVENTS 200
+
+//Urgent deadline, in Power_getTime ticks (2 us)
+#define URGENT_DEADLINE (5 * POWER_TICKS_PER_MS)
+
+//Arrival times are random, between these (ps)
+#define ARRIVAL_MIN (20 * SIM_PS_PER_MS)
+#define ARRIVAL_RANGE (40 * SIM_PS_PER_MS)
+
+//256 byte memory with an auto-incrementing address (set by the 1st byte of a write)
+typedef struct {
+    Sim_Device dev;
+    uint8_t data[256];
+    uint8_t pointer;
+    bool pointerSet;
+} Memory;
+
+//Latency of the urgent writes (ps)
+typedef struct {
+    uint32_t count;
+    uint64_t total;
+    uint64_t worst;
+    uint64_t worstBulk;         //Longest single bulk transaction
+    uint64_t worstUrgent;       //Longest urgent transaction
+    uint32_t bulkTransfers;
+    uint32_t errors;
+} Latency;
+
+static Memory memory;
+static SimExpander expander;
+static uint8_t bulkBlock[BULK_SIZE + 1];
+
+//Urgent request arrivals - set by the timer, like an interrupt flag
+static Sim_Timer arrival;
+static volatile bool urgentDue = false;
+static uint64_t urgentAt = 0;
+static uint16_t lfsr = 0xACE1;
+
+static bool Memory_start(Sim_Device* dev, bool read)
+{
+    Memory* m = (Memory*) dev->context;
+    
+    if (!read)
+    {
+        m->pointerSet = false;
+    }
+    return true;
+}
+
+static bool Memory_write(Sim_Device* dev, uint8_t data)
+{
+    Memory* m = (Memory*) dev->context;
+    
+    if (!m->pointerSet)
+    {
+        m->pointer = data;
+        m->pointerSet = true;
+        return true;
+    }
+    
+    m->data[m->pointer++] = data;
+    return true;
+}
+
+static uint8_t Memory_read(Sim_Device* dev)
+{
+    Memory* m = (Memory*) dev->context;
+    return m->data[m->pointer++];
+}
+
+static void Memory_stop(Sim_Device* dev)
+{
+    (void) dev;
+}
+
+//16-bit Galois LFSR
+static uint16_t Test_random(void)
+{
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    return lfsr;
+}
+
+//Raises the urgent request and schedules the next one
+static void Test_arrive(Sim_Timer* timer)
+{
+    urgentDue = true;
+    urgentAt = timer->at;
+    
+    uint64_t next = ARRIVAL_MIN + (ARRIVAL_RANGE * Test_random()) / 0x10000;
+    Sim_startTimer(timer, timer->at + next);
+}
+
+//Records the completion of the urgent write that arrived at urgentAt
+static void Test_complete(Latency* latency)
+{
+    uint64_t time = Sim_now(SIM_HOST) - urgentAt;
+    
+    latency->count++;
+    latency->total += time;
+    if (time > latency->worst)
+    {
+        latency->worst = time;
+    }
+}
+
+//Checks the memory holds the bulk data
+static void Test_checkBulk(Latency* latency)
+{
+    if (memcmp(&memory.data[0], &bulkBlock[1], BULK_SIZE) != 0)
+    {
+        latency->errors++;
+    }
+    memset(memory.data, 0, sizeof(memory.data));
+    latency->bulkTransfers++;
+}
+
+//Without the arbiter: the main loop runs the bulk write as 1 transaction
+static void Test_runDirect(Latency* latency)
+{
+    uint8_t urgentBlock[2];
+    
+    while (latency->count < URGENT_EVENTS)
+    {
+        if (urgentDue)
+        {
+            urgentDue = false;
+            
+            urgentBlock[0] = SIM_EXP_LAT;
+            urgentBlock[1] = (uint8_t) latency->count;
+            
+            uint64_t start = Sim_now(SIM_HOST);
+            if (!I2C_sendBytes(EXPANDER_ADDR, &urgentBlock[0], 2))
+            {
+                latency->errors++;
+            }
+            uint64_t time = Sim_now(SIM_HOST) - start;
+            latency->worstUrgent = (time > latency->worstUrgent) ? time : latency->worstUrgent;
+            
+            Test_complete(latency);
+        }
+        
+        uint64_t start = Sim_now(SIM_HOST);
+        if (!I2C_sendBytes(MEMORY_ADDR, &bulkBlock[0], BULK_SIZE + 1))
+        {
+            latency->errors++;
+        }
+        uint64_t time = Sim_now(SIM_HOST) - start;
+        latency->worstBulk = (time > latency->worstBulk) ? time : latency->worstBulk;
+        
+        Test_checkBulk(latency);
+    }
+}
+
+//With the arbiter: urgent writes are queued, and run at the next transaction boundary
+static void Test_runArbiter(Latency* latency)
+{
+    static volatile I2C_ArbiterStatus bulkStatus = I2C_ARB_DONE;
+    static volatile I2C_ArbiterStatus urgentStatus = I2C_ARB_DONE;
+    static uint8_t urgentData;
+    bool urgentQueued = false;
+    
+    I2C_ArbiterRequest bulk = {
+        .op = I2C_ARB_REG_WRITE,
+        .addr = MEMORY_ADDR,
+        .regAddr = 0x00,
+        .data = &bulkBlock[1],
+        .len = BULK_SIZE,
+        .deadline = 0xFFFFFFFF,
+        .status = &bulkStatus
+    };
+    
+    I2C_ArbiterRequest urgent = {
+        .op = I2C_ARB_REG_WRITE,
+        .addr = EXPANDER_ADDR,
+        .regAddr = SIM_EXP_LAT,
+        .data = &urgentData,
+        .len = 1,
+        .deadline = URGENT_DEADLINE,
+        .status = &urgentStatus
+    };
+    
+    while (latency->count < URGENT_EVENTS)
+    {
+        if (bulkStatus != I2C_ARB_PENDING)
+        {
+            if (bulkStatus == I2C_ARB_FAILED)
+            {
+                latency->errors++;
+            }
+            if (!I2C_Arbiter_submit(I2C_ARB_BULK, &bulk))
+            {
+                latency->errors++;
+            }
+        }
+        
+        //The request is submitted where an ISR would, at the next check of the flag
+        if (urgentDue && !urgentQueued)
+        {
+            urgentDue = false;
+            urgentData = (uint8_t) latency->count;
+            
+            if (!I2C_Arbiter_submit(I2C_ARB_URGENT, &urgent))
+            {
+                latency->errors++;
+            }
+            urgentQueued = true;
+        }
+        
+        bool wasUrgent = (urgentStatus == I2C_ARB_PENDING);
+        uint64_t start = Sim_now(SIM_HOST);
+        I2C_Arbiter_service();
+        uint64_t time = Sim_now(SIM_HOST) - start;
+        
+        if (wasUrgent && (urgentStatus != I2C_ARB_PENDING))
+        {
+            latency->worstUrgent = (time > latency->worstUrgent) ? time : latency->worstUrgent;
+        }
+        else
+        {
+            latency->worstBulk = (time > latency->worstBulk) ? time : latency->worstBulk;
+        }
+        
+        if (urgentQueued && (urgentStatus != I2C_ARB_PENDING))
+        {
+            if (urgentStatus == I2C_ARB_FAILED)
+            {
+                latency->errors++;
+            }
+            urgentQueued = false;
+            Test_complete(latency);
+        }
+        
+        if (bulkStatus == I2C_ARB_DONE)
+        {
+            Test_checkBulk(latency);
+        }
+    }
+}
+
+//Prints one result line
+static void Test_print(const char* name, const Latency* latency)
+{
+    printf("  %-16s urgent avg %7.1f us, worst %7.1f us | bulk transaction %7.1f us, urgent %5.1f us | %u transfers, %u errors\n",
+            name, (double) latency->total / latency->count / SIM_PS_PER_US, (double) latency->worst / SIM_PS_PER_US,
+            (double) latency->worstBulk / SIM_PS_PER_US, (double) latency->worstUrgent / SIM_PS_PER_US,
+            latency->bulkTransfers, latency->errors);
+}
+
+int main(void)
+{
+    SimHost_init();
+    SimExpander_init(&expander, EXPANDER_ADDR, false);
+    
+    memory.dev.addr = MEMORY_ADDR;
+    memory.dev.start = &Memory_start;
+    memory.dev.write = &Memory_write;
+    memory.dev.read = &Memory_read;
+    memory.dev.stop = &Memory_stop;
+    memory.dev.context = &memory;
+    Sim_attachDevice(&memory.dev);
+    
+    //Register address, then the data
+    bulkBlock[0] = 0x00;
+    for (uint16_t i = 0; i < BULK_SIZE; i++)
+    {
+        bulkBlock[1 + i] = (uint8_t) (i * 7 + 1);
+    }
+    
+    arrival.expire = &Test_arrive;
+    Sim_startTimer(&arrival, Sim_now(SIM_HOST) + ARRIVAL_MIN);
+    
+    printf("arbiter: %u urgent writes during a %u byte bulk register write\n", URGENT_EVENTS, BULK_SIZE);
+    
+    Latency direct = {0};
+    Test_runDirect(&direct);
+    Test_print("no arbiter", &direct);
+    
+    Latency arbiter = {0};
+    I2C_Arbiter_init(&Power_getTime);
+    urgentDue = false;
+    Test_runArbiter(&arbiter);
+    Test_print("arbiter", &arbiter);
+    
+    uint32_t worstTicks = I2C_Arbiter_getWorstUrgentLatency();
+    uint16_t misses = I2C_Arbiter_getDeadlineMisses();
+    printf("  arbiter worst urgent latency %.1f us (submit to completion), deadline misses %u\n",
+            (double) worstTicks * 2, misses);
+    
+    if ((direct.errors != 0) || (arbiter.errors != 0) || (misses != 0))
+    {
+        printf("FAIL: errors or deadline misses\n");
+        return 1;
+    }
+    
+    //An urgent write waits for at most 1 bulk transaction - allow 250 us for the main loop and
+    //the submit (a call is 16 us on the 1 MHz host)
+    if (arbiter.worst > arbiter.worstBulk + arbiter.worstUrgent + 250 * SIM_PS_PER_US)
+    {
+        printf("FAIL: urgent write waited longer than 1 bulk transaction\n");
+        return 1;
+    }
+    
+    if (expander.reg[SIM_EXP_LAT] != (uint8_t) (URGENT_EVENTS - 1))
+    {
+        printf("FAIL: last urgent write not in the expander\n");
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,178 @@
+//Change map and FIFO register of the BlockData driver (user guide: "Change Map", "Streaming FIFO Register")
+//on the simulated bus. The client is built with BLOCKDATA_CHANGE_MAP. Registers are changed by the client's
+//main loop, and the host reads the map from BLOCKDATA_CHANGE_REG or from its 2nd byte. Every change must be
+//reported once - bits are only cleared in the map bytes the host received.
+//Reads of the buffer that run on into the FIFO or the map must not take entries or clear bits
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_client.h"
+#include "sim_host.h"
+
+#include "i2c_host.h"
+
+#define CLIENT_ADDR 0x64
+#define BUFFER_SIZE 16
+
+//Copied from i2c-client.X/i2c_blockData.h
+#define CHANGE_REG 0x90
+#define CHANGE_MAP_SIZE 2
+
+#define RANDOM_STEPS 2000
+
+//FIFO register, with the fill level at FIFO_REG - 1
+#define FIFO_REG 0x20
+#define FIFO_ENTRIES 8
+
+static uint16_t failures = 0;
+
+//Change bits the host has not received yet
+static uint8_t expected[CHANGE_MAP_SIZE];
+
+static uint16_t lfsr = 0xACE1;
+
+//Reports one check
+static void Test_check(const char* name, bool ok)
+{
+    printf("  %-58s %s\n", name, (ok) ? "ok" : "FAIL");
+    
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+//16-bit Galois LFSR
+static uint16_t Test_random(void)
+{
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    return lfsr;
+}
+
+//Changes register INDEX on the client, and records its change bit
+static bool Test_change(uint8_t index)
+{
+    uint8_t value = (uint8_t) (SimClient_peek(index) + 1);
+    
+    expected[index >> 3] |= (uint8_t) (1 << (index & 0x07));
+    return SimClient_writeRegister(index, value);
+}
+
+//Reads LEN map bytes from map byte FIRST. Returns true if they hold the bits not yet received
+static bool Test_readMap(uint8_t first, uint8_t len)
+{
+    uint8_t data[CHANGE_MAP_SIZE];
+    bool ok = I2C_registerWriteRead(CLIENT_ADDR, CHANGE_REG + first, &data[0], len);
+    
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] != expected[first + i])
+        {
+            ok = false;
+        }
+        expected[first + i] = 0x00;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    SimHost_init();
+    SimClient_init();
+    
+    printf("change map (read from 0x%02X and 0x%02X) and FIFO register (0x%02X)\n", CHANGE_REG, CHANGE_REG + 1, FIFO_REG);
+    
+    if (!SimClient_writeRegister(0, 0x00))
+    {
+        printf("FAIL: client built without BLOCKDATA_CHANGE_MAP\n");
+        return 1;
+    }
+    
+    //Start from a clear map
+    I2C_registerWriteRead(CLIENT_ADDR, CHANGE_REG, &expected[0], CHANGE_MAP_SIZE);
+    expected[0] = 0x00;
+    expected[1] = 0x00;
+    
+    Test_check("  changes in both map bytes", Test_change(2) && Test_change(9));
+    Test_check("  read from 0x90 reports both", Test_readMap(0, 2));
+    
+    //A read of the 2nd map byte must not clear the 1st with its bits from the read above
+    Test_check("  same registers change again", Test_change(2) && Test_change(10));
+    Test_check("  read from 0x91 reports byte 1", Test_readMap(1, 1));
+    Test_check("  byte 0 is still set", Test_readMap(0, 1));
+    Test_check("  map is clear", Test_readMap(0, 2));
+    
+    //Random changes and reads
+    bool ok = true;
+    for (uint16_t n = 0; n < RANDOM_STEPS; n++)
+    {
+        uint16_t r = Test_random();
+        
+        if (r & 0x01)
+        {
+            ok &= Test_change((uint8_t) ((r >> 1) % BUFFER_SIZE));
+        }
+        else
+        {
+            uint8_t first = (uint8_t) ((r >> 1) & 0x01);
+            ok &= Test_readMap(first, (first != 0) ? 1 : (uint8_t) (1 + ((r >> 2) & 0x01)));
+        }
+    }
+    Test_check("  random changes and reads, each change reported once", ok);
+    Test_check("  map is clear", Test_readMap(0, 2));
+    
+    //Over-long reads from the buffer run on through the fill level, the FIFO and the map
+    uint8_t data[0xA0];
+    
+    SimClient_setupFifo(FIFO_REG);
+    for (uint8_t i = 0; i < FIFO_ENTRIES; i++)
+    {
+        SimClient_pushFifo((uint8_t) (0xC0 + i));
+    }
+    Test_change(3);
+    
+    bool zero = I2C_registerWriteRead(CLIENT_ADDR, 0x00, &data[0], sizeof(data));
+    for (uint8_t i = BUFFER_SIZE; i < sizeof(data); i++)
+    {
+        zero &= (data[i] == 0x00);
+    }
+    Test_check("  read of 0x00 to 0x9F returns 0x00 after the buffer", zero);
+    Test_check("  FIFO entries are not taken", SimClient_getFifoLevel() == FIFO_ENTRIES);
+    
+    zero = I2C_registerWriteRead(CLIENT_ADDR, 0x40, &data[0], 0x60);
+    for (uint8_t i = 0; i < 0x60; i++)
+    {
+        zero &= (data[i] == 0x00);
+    }
+    Test_check("  read of 0x40 to 0x9F returns 0x00", zero);
+    Test_check("  change bit is not cleared", Test_readMap(0, 2));
+    
+    //Reads that select the FIFO
+    uint8_t count;
+    bool entries = I2C_registerReadBlock(CLIENT_ADDR, FIFO_REG - 1, &data[0], sizeof(data), &count)
+            && (count == FIFO_ENTRIES);
+    for (uint8_t i = 0; i < FIFO_ENTRIES; i++)
+    {
+        entries &= (data[i] == (uint8_t) (0xC0 + i));
+    }
+    Test_check("  read from the fill level returns the entries", entries);
+    Test_check("  FIFO is empty", SimClient_getFifoLevel() == 0);
+    
+    SimClient_pushFifo(0xD0);
+    SimClient_pushFifo(0xD1);
+    SimClient_pushFifo(0xD2);
+    Test_check("  read of the FIFO register returns the next entry",
+            I2C_registerWriteRead(CLIENT_ADDR, FIFO_REG, &data[0], 1) && (data[0] == 0xD0));
+    Test_check("  and takes 1 entry", SimClient_getFifoLevel() == 2);
+    
+    if (failures != 0)
+    {
+        printf("FAIL: %u checks\n", failures);
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+//Two hosts on one bus (user guide: "Multiple Hosts") on the simulated bus
+//The host writes and reads back the client's buffer while another host takes the bus.
+//Forced collisions check that a lost arbitration is retried. Random traffic from the other host,
+//at 0 - 50 % of the bus time, shows the throughput left to the host and the retries it needs
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_client.h"
+#include "sim_host.h"
+
+#include "i2c_host.h"
+
+#define CLIENT_ADDR 0x64
+#define TRANSFER_SIZE 8
+#define TRANSFERS 500
+
+//Address bytes of the other host - lower than the host's (0xC8) wins arbitration, higher loses
+#define OTHER_WINS (0x20 << 1)
+#define OTHER_LOSES (0x70 << 1)
+#define OTHER_BYTES 8
+
+//Bit time of the host's bus (I2C1BAUD = 8, 11.25 us)
+#define BIT_TIME (11250 * SIM_PS_PER_US / 1000)
+
+//Results of one run
+typedef struct {
+    uint32_t errors;
+    uint32_t failed;
+    uint16_t retries;
+    uint64_t time;
+    Sim_Stats stats;
+} Run;
+
+//Random traffic of the other host
+static Sim_Timer traffic;
+static uint64_t trafficMean = 0;
+static uint16_t lfsr = 0xACE1;
+
+//16-bit Galois LFSR
+static uint16_t Test_random(void)
+{
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    return lfsr;
+}
+
+//Requests a transaction of the other host, and schedules the next one (0 - 2x the mean interval)
+static void Test_traffic(Sim_Timer* timer)
+{
+    Sim_requestOtherHost(timer->at, OTHER_WINS, OTHER_BYTES);
+    Sim_startTimer(timer, timer->at + 1 + (2 * trafficMean * Test_random()) / 0x10000);
+}
+
+//Writes and reads back the client's buffer COUNT times
+//If FORCED is not 0, the other host starts together with each write, with that address byte
+static void Test_run(uint16_t count, uint8_t forced, Run* run)
+{
+    uint8_t block[TRANSFER_SIZE + 1];
+    uint8_t data[TRANSFER_SIZE];
+    
+    Sim_clearStats();
+    I2C_clearTransactionCount();
+    uint64_t start = Sim_now(SIM_HOST);
+    
+    for (uint16_t n = 0; n < count; n++)
+    {
+        uint8_t offset = (uint8_t) (n % (16 - TRANSFER_SIZE + 1));
+        
+        block[0] = offset;
+        for (uint8_t i = 0; i < TRANSFER_SIZE; i++)
+        {
+            block[1 + i] = (uint8_t) (n + i * 31);
+        }
+        
+        if (forced != 0)
+        {
+            Sim_requestOtherHost(SIM_WITH_NEXT_START, forced, OTHER_BYTES);
+        }
+        
+        if (!I2C_sendBytes(CLIENT_ADDR, &block[0], TRANSFER_SIZE + 1)
+                || !I2C_registerWriteRead(CLIENT_ADDR, offset, &data[0], TRANSFER_SIZE))
+        {
+            run->failed++;
+            continue;
+        }
+        
+        for (uint8_t i = 0; i < TRANSFER_SIZE; i++)
+        {
+            if (data[i] != block[1 + i])
+            {
+                run->errors++;
+                break;
+            }
+        }
+    }
+    
+    run->time = Sim_now(SIM_HOST) - start;
+    run->retries = I2C_getRetryCount();
+    Sim_getStats(&run->stats);
+}
+
+int main(void)
+{
+    static const uint8_t loads[] = {0, 10, 25, 50};
+    uint32_t errors = 0;
+    
+    SimHost_init();
+    SimClient_init();
+    
+    printf("two hosts, %u byte write and read back per transfer\n", TRANSFER_SIZE);
+    
+    //The other host starts with every write, and wins
+    Run lost = {0};
+    Test_run(100, OTHER_WINS, &lost);
+    printf("  forced collision, other host wins:  %u lost, %u retries, %u failed, %u errors\n",
+            lost.stats.arbitrationLost, lost.retries, lost.failed, lost.errors);
+    if ((lost.stats.arbitrationLost != 100) || (lost.retries != 100) || (lost.failed != 0) || (lost.errors != 0))
+    {
+        errors++;
+    }
+    
+    //The other host starts with every write, and loses
+    Run won = {0};
+    Test_run(100, OTHER_LOSES, &won);
+    printf("  forced collision, other host loses: %u lost, %u retries, %u failed, %u errors\n",
+            won.stats.arbitrationLost, won.retries, won.failed, won.errors);
+    if ((won.stats.arbitrationLost != 0) || (won.retries != 0) || (won.failed != 0) || (won.errors != 0))
+    {
+        errors++;
+    }
+    
+    //Random traffic. Each transaction of the other host is about 0.9 ms
+    traffic.expire = &Test_traffic;
+    
+    for (uint8_t i = 0; i < sizeof(loads); i++)
+    {
+        Run run = {0};
+        
+        if (loads[i] != 0)
+        {
+            uint64_t duration = (2 + 9 * (OTHER_BYTES + 1)) * BIT_TIME;
+            trafficMean = (duration * 100) / loads[i];
+            Sim_startTimer(&traffic, Sim_now(SIM_HOST) + 1);
+        }
+        
+        Test_run(TRANSFERS, 0, &run);
+        Sim_stopTimer(&traffic);
+        
+        double seconds = (double) run.time / (SIM_PS_PER_MS * 1000);
+        printf("  other host %2u%%: %5.1f%% of bus time, %6.0f bytes/s, %u retries, %u lost, %u failed, %u errors\n",
+                loads[i], 100.0 * run.stats.otherTime / run.time, 2.0 * TRANSFER_SIZE * TRANSFERS / seconds,
+                run.retries, run.stats.arbitrationLost, run.failed, run.errors);
+        
+        errors += run.errors + run.failed;
+    }
+    
+    if (errors != 0)
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
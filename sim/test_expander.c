@@ -0,0 +1,218 @@
+//I/O expander API (advanced_IO.c) against a behavioral model of the expander
+//Checks the result of each call, and its transaction count against the table in README.md
+//("I/O Expander Transaction Counts")
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_expander.h"
+#include "sim_host.h"
+
+#include "advanced_IO.h"
+#include "i2c_host.h"
+#include "power.h"
+
+static SimExpander expander;
+static SimExpander expander2;
+static uint16_t failures = 0;
+
+//Reports one check
+static void Test_check(const char* name, bool ok)
+{
+    printf("  %-58s %s\n", name, (ok) ? "ok" : "FAIL");
+    
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+//Reports the transactions since the last clear against EXPECTED
+static void Test_count(const char* name, uint16_t expected)
+{
+    uint16_t count = I2C_getTransactionCount();
+    printf("  %-50s %2u (%2u) %s\n", name, count, expected, (count == expected) ? "ok" : "FAIL");
+    
+    if (count != expected)
+    {
+        failures++;
+    }
+    
+    I2C_clearTransactionCount();
+}
+
+//Polls the memory operation status until it is no longer pending
+//Returns the final status, and the number of checks in CHECKS
+static ADVANCED_IO_MEMORY_STATUS Test_waitMemoryOP(uint16_t* checks)
+{
+    ADVANCED_IO_MEMORY_STATUS status;
+    *checks = 0;
+    
+    do
+    {
+        status = advancedIO_getMemoryOPStatus();
+        (*checks)++;
+    } while (status == ADV_IO_MEM_PENDING);
+    
+    return status;
+}
+
+int main(void)
+{
+    SimHost_init();
+    SimExpander_init(&expander, ADVANCED_IO_I2C_ADDR, true);
+    SimExpander_init(&expander2, ADVANCED_IO_I2C_ADDR + 1, true);
+    
+    advancedIO_init();
+    I2C_clearTransactionCount();
+
+#ifdef ADV_IO_USE_INT_PIN
+    printf("I/O expander API (!INT on RB4)\n");
+#else
+    printf("I/O expander API (polled memory operations)\n");
+#endif
+    printf("  %-50s count (README)\n", "");
+    
+    //Single register access
+    advancedIO_setRegister(ADV_IO_LATx, 0x5A);
+    Test_count("advancedIO_setRegister", 1);
+    Test_check("  LATx written", expander.reg[SIM_EXP_LAT] == 0x5A);
+    
+    Test_check("  advancedIO_getRegister returns LATx", advancedIO_getRegister(ADV_IO_LATx) == 0x5A);
+    Test_count("advancedIO_getRegister", 1);
+    
+    advancedIO_setRegister(ADV_IO_TRISx, 0xF0);
+    expander.inputs = 0xC0;
+    I2C_clearTransactionCount();
+    Test_check("  advancedIO_getPinState = LATx outputs, input levels", advancedIO_getPinState() == 0xCA);
+    Test_count("advancedIO_getPinState", 1);
+    
+    //Both expanders latch the broadcast in the same transaction
+    Test_check("  advancedIO_setRegisterBroadcast ACKed", advancedIO_setRegisterBroadcast(ADV_IO_WPUx, 0x81));
+    Test_count("advancedIO_setRegisterBroadcast", 1);
+    Test_check("  both expanders updated", (expander.reg[SIM_EXP_WPU] == 0x81) && (expander2.reg[SIM_EXP_WPU] == 0x81));
+    
+    //Read-modify-write helpers
+    advancedIO_toggleBitsInRegister(ADV_IO_LATx, 0xFF);
+    Test_count("advancedIO_toggleBitsInRegister", 2);
+    Test_check("  LATx inverted", expander.reg[SIM_EXP_LAT] == 0xA5);
+    
+    advancedIO_setOutputsHigh(0x0A);
+    Test_count("advancedIO_setOutputsHigh", 2);
+    advancedIO_setOutputsLow(0x05);
+    Test_count("advancedIO_setOutputsLow", 2);
+    Test_check("  LATx = 0xAF & ~0x05", expander.reg[SIM_EXP_LAT] == 0xAA);
+    
+    advancedIO_setPinsAsInputs(0x01);
+    Test_count("advancedIO_setPinsAsInputs", 2);
+    advancedIO_setPinsAsOutputs(0x80);
+    Test_count("advancedIO_setPinsAsOutputs", 2);
+    Test_check("  TRISx = 0xF1 & ~0x80", expander.reg[SIM_EXP_TRIS] == 0x71);
+    
+    //README example: 2 reads, then LATx and TRISx written separately (LATx first)
+    advancedIO_setRegister(ADV_IO_LATx, 0x00);
+    advancedIO_setRegister(ADV_IO_TRISx, 0xFF);
+    I2C_clearTransactionCount();
+    SimExpander_clearLog(&expander);
+    
+    advancedIO_begin();
+    advancedIO_setOutputsHigh(0x0F);
+    advancedIO_setPinsAsOutputs(0xFF);
+    Test_check("  no writes before the commit", expander.logCount == 0);
+    Test_check("  advancedIO_commit succeeds", advancedIO_commit());
+    Test_count("begin, setOutputsHigh, setPinsAsOutputs, commit", 2 + 1 + 1);
+    Test_check("  LATx written before TRISx", (SimExpander_findWrite(&expander, SIM_EXP_LAT) >= 0)
+            && (SimExpander_findWrite(&expander, SIM_EXP_LAT) < SimExpander_findWrite(&expander, SIM_EXP_TRIS)));
+    Test_check("  LATx = 0x0F, TRISx = 0x00", (expander.reg[SIM_EXP_LAT] == 0x0F) && (expander.reg[SIM_EXP_TRIS] == 0x00));
+    
+    //Adjacent registers are one burst (IOCxP and IOCxN), with no reads for full writes
+    advancedIO_begin();
+    advancedIO_setRegister(ADV_IO_IOCxP, 0x11);
+    advancedIO_setRegister(ADV_IO_IOCxN, 0x22);
+    advancedIO_commit();
+    Test_count("begin, 2 adjacent setRegister, commit", 1);
+    Test_check("  IOCxP and IOCxN written", (expander.reg[0x05] == 0x11) && (expander.reg[0x06] == 0x22));
+    
+    //README pin group example: 3 reads, then 1 write each for LATx, TRISx and WPUx
+    const ADVANCED_IO_PIN_GROUP startup = ADV_IO_PIN_GROUP(ADV_IO_PIN(0) | ADV_IO_PIN(3), 0x00, ADV_IO_PIN(5), 0x00);
+    advancedIO_setRegister(ADV_IO_LATx, 0x00);
+    advancedIO_setRegister(ADV_IO_TRISx, 0xFF);
+    advancedIO_setRegister(ADV_IO_WPUx, 0x00);
+    I2C_clearTransactionCount();
+    SimExpander_clearLog(&expander);
+    
+    Test_check("  advancedIO_applyPinGroup succeeds", advancedIO_applyPinGroup(&startup));
+    Test_count("advancedIO_applyPinGroup (partial)", 3 + 3);
+    Test_check("  LATx, TRISx, WPUx", (expander.reg[SIM_EXP_LAT] == 0x09) && (expander.reg[SIM_EXP_TRIS] == 0xF6)
+            && (expander.reg[SIM_EXP_WPU] == 0x20));
+    Test_check("  written in the order LATx, TRISx, WPUx", (SimExpander_findWrite(&expander, SIM_EXP_LAT) == 0)
+            && (SimExpander_findWrite(&expander, SIM_EXP_TRIS) > 0)
+            && (SimExpander_findWrite(&expander, SIM_EXP_WPU) > SimExpander_findWrite(&expander, SIM_EXP_TRIS)));
+    
+    const ADVANCED_IO_PIN_GROUP full = ADV_IO_PIN_GROUP(0xAA, 0x55, 0x00, 0x00);
+    advancedIO_applyPinGroup(&full);
+    Test_count("advancedIO_applyPinGroup (every bit set or cleared)", 2);
+    
+    //Memory operations: save, change, load back
+    ADVANCED_IO_MEMORY_OP save = {.OP = ADV_IO_OP_SAVE};
+    ADVANCED_IO_MEMORY_OP load = {.OP = ADV_IO_OP_LOAD};
+    uint16_t checks;
+    
+    advancedIO_setRegister(ADV_IO_LATx, 0x3C);
+    I2C_clearTransactionCount();
+    Test_check("  advancedIO_performMemoryOP(SAVE) pending", advancedIO_performMemoryOP(save) == ADV_IO_MEM_PENDING);
+    Test_count("advancedIO_performMemoryOP", 1);
+    Test_check("  a 2nd operation is refused while pending", advancedIO_performMemoryOP(save) == ADV_IO_MEM_ERROR);
+    I2C_clearTransactionCount();
+    
+    Test_check("  SAVE completes", Test_waitMemoryOP(&checks) == ADV_IO_MEM_COMPLETE);
+#ifdef ADV_IO_USE_INT_PIN
+    Test_count("advancedIO_getMemoryOPStatus (all checks)", 0);
+#else
+    Test_count("advancedIO_getMemoryOPStatus (all checks)", checks);
+#endif
+    Test_check("  expander saved LATx", expander.saved[SIM_EXP_LAT] == 0x3C);
+    
+    //A batch read before a Load is dropped - the commit must not write back the stale value
+    advancedIO_setRegister(ADV_IO_LATx, 0x00);
+    advancedIO_begin();
+    advancedIO_getRegister(ADV_IO_LATx);
+    advancedIO_performMemoryOP(load);
+    Test_check("  LOAD completes", Test_waitMemoryOP(&checks) == ADV_IO_MEM_COMPLETE);
+    Test_check("  expander loaded LATx", expander.reg[SIM_EXP_LAT] == 0x3C);
+    I2C_clearTransactionCount();
+    advancedIO_setOutputsHigh(0x01);
+    advancedIO_commit();
+    Test_count("setOutputsHigh after a Load in a batch (re-read)", 2);
+    Test_check("  LATx = loaded value | 0x01", expander.reg[SIM_EXP_LAT] == 0x3D);
+    
+    I2C_clearTransactionCount();
+    Test_check("  advancedIO_resetToDefault pending", advancedIO_resetToDefault() == ADV_IO_MEM_PENDING);
+    Test_count("advancedIO_resetToDefault", 1);
+    Test_check("  reset completes", Test_waitMemoryOP(&checks) == ADV_IO_MEM_COMPLETE);
+    Test_check("  registers at their defaults", (expander.reg[SIM_EXP_LAT] == 0x00) && (expander.reg[SIM_EXP_TRIS] == 0xFF));
+    
+    //No completion: the status times out after ADV_IO_MEM_OP_TIMEOUT_MS
+    expander.intStuck = true;
+    uint64_t start = Sim_now(SIM_HOST);
+    advancedIO_performMemoryOP(save);
+
+#ifndef ADV_IO_USE_INT_PIN
+    //The operation never ends, so the address stays NACKed
+    Sim_stopTimer(&expander.done);
+#endif
+    Test_check("  no completion: times out", Test_waitMemoryOP(&checks) == ADV_IO_MEM_TIMEOUT);
+    double ms = (double) (Sim_now(SIM_HOST) - start) / SIM_PS_PER_MS;
+    printf("  timeout after %.1f ms\n", ms);
+    Test_check("  timeout is ADV_IO_MEM_OP_TIMEOUT_MS", (ms >= ADV_IO_MEM_OP_TIMEOUT_MS) && (ms < ADV_IO_MEM_OP_TIMEOUT_MS + 2));
+    
+    if (failures != 0)
+    {
+        printf("FAIL: %u checks\n", failures);
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
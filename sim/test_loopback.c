@@ -0,0 +1,54 @@
+//Loopback sweep (user guide: "Loopback Test") between the host and client drivers on the simulated bus
+//The elapsed time measured by the host with TMR1 is checked against the simulated time
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_client.h"
+#include "sim_host.h"
+
+#include "loopback.h"
+
+int main(void)
+{
+    SimHost_init();
+    SimClient_init();
+    Sim_clearStats();
+    
+    Loopback_Results results;
+    uint64_t start = Sim_now(SIM_HOST);
+    bool ok = Loopback_runSweep(&results);
+    uint64_t elapsed = Sim_now(SIM_HOST) - start;
+
+#ifdef LOOPBACK_FIRST_BYTE_ADDR
+    printf("loopback sweep (FIRST_BYTE_ADDR)\n");
+#else
+    printf("loopback sweep (raw)\n");
+#endif
+    printf("  transfers %u, bytes %lu, errors %u\n", results.transfers, (unsigned long) results.bytes, results.errors);
+    
+    //The sweep runs for seconds - far longer than one 16-bit TMR1 period (131 ms)
+    uint64_t measured = (uint64_t) results.ticks * 2 * SIM_PS_PER_US;
+    printf("  time %.1f ms (TMR1 %.1f ms), active %.1f ms\n", (double) elapsed / SIM_PS_PER_MS,
+            (double) measured / SIM_PS_PER_MS, (double) results.activeTicks * 2 / 1000);
+    
+    SimHost_printStats();
+    
+    if (!ok)
+    {
+        printf("FAIL: %u errors\n", results.errors);
+        return 1;
+    }
+    
+    //TMR1 is sampled inside the sweep, a few instructions after the simulated clock - allow 1%
+    uint64_t error = (measured > elapsed) ? (measured - elapsed) : (elapsed - measured);
+    if (error > (elapsed / 100))
+    {
+        printf("FAIL: TMR1 time differs from the simulated time\n");
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,34 @@
+//Multi-role firmware (user guide: "Shared I2C Core") - I2C_ROLE_HOST and I2C_ROLE_CLIENT both set
+//Built from the host's sources with i2c_client.c added, to check that both drivers and the shared core
+//compile and link into one program. The drivers are set up on the host CPU, but no transfers are run
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+
+#include "i2c_config.h"
+#include "i2c_host.h"
+#include "i2c_client.h"
+
+#define CLIENT_ADDR 0x64
+
+int main(void)
+{
+    printf("host and client roles in one firmware\n");
+
+#if (!I2C_ROLE_HOST) || (!I2C_ROLE_CLIENT)
+    printf("FAIL: i2c_config.h does not select both roles\n");
+    return 1;
+#endif
+    
+    Sim_reset();
+    
+    //Shared core, then each role
+    I2C_initPins();
+    I2C_initHost();
+    I2C_initClient(CLIENT_ADDR);
+    
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,290 @@
+//Software bus (user guide: "Second Bus (Bit-Bang)") on the simulated board
+//i2c_soft.c runs on RB1 (SCL) and RB2 (SDA), against wired-AND models of register devices.
+//Checks a write, a write then read, a read, a NACK, clock stretching, the SCL timeout and block lengths.
+//Then runs the same sweep on I2C1 alone, and split across I2C1 and the software bus, and compares throughput
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_host.h"
+
+#include "i2c_host.h"
+#include "i2c_soft.h"
+#include "power.h"
+
+#include <xc.h>
+
+#define SOFT_SCL_PIN 1
+#define SOFT_SDA_PIN 2
+
+#define SENSOR_ADDR 0x48
+#define MEMORY_ADDR 0x50
+#define ABSENT_ADDR 0x33
+
+//Length-prefixed block in the sensor's registers
+#define BLOCK_REG 0x10
+#define BLOCK_LEN 6
+
+#define SENSOR_REG 0x00
+#define SENSOR_BYTES 2
+#define ROUNDS 20
+
+//Device with 256 registers - the 1st byte written sets the pointer, which increments on each byte
+typedef struct {
+    Sim_Device dev;
+    uint8_t reg[256];
+    uint8_t pointer;
+    bool pointerSet;
+} Memory;
+
+//Sensor on the software bus and on I2C1, and a memory on I2C1
+static Memory softSensor;
+static Memory sensor;
+static Memory memory;
+
+static uint16_t failures = 0;
+
+static bool Memory_start(Sim_Device* dev, bool read)
+{
+    Memory* m = (Memory*) dev->context;
+    
+    if (!read)
+    {
+        m->pointerSet = false;
+    }
+    return true;
+}
+
+static bool Memory_write(Sim_Device* dev, uint8_t data)
+{
+    Memory* m = (Memory*) dev->context;
+    
+    if (!m->pointerSet)
+    {
+        m->pointer = data;
+        m->pointerSet = true;
+    }
+    else
+    {
+        m->reg[m->pointer++] = data;
+    }
+    return true;
+}
+
+static uint8_t Memory_read(Sim_Device* dev)
+{
+    Memory* m = (Memory*) dev->context;
+    
+    return m->reg[m->pointer++];
+}
+
+static void Memory_stop(Sim_Device* dev)
+{
+    (void) dev;
+}
+
+//Sets up M at ADDR, with each register holding its index + SEED
+static void Memory_init(Memory* m, uint8_t addr, uint8_t seed)
+{
+    m->dev.addr = addr;
+    m->dev.start = &Memory_start;
+    m->dev.write = &Memory_write;
+    m->dev.read = &Memory_read;
+    m->dev.stop = &Memory_stop;
+    m->dev.context = m;
+    
+    for (uint16_t i = 0; i < sizeof(m->reg); i++)
+    {
+        m->reg[i] = (uint8_t) (i + seed);
+    }
+}
+
+//Reports one check
+static void Test_check(const char* name, bool ok)
+{
+    printf("  %-58s %s\n", name, (ok) ? "ok" : "FAIL");
+    
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+//Returns true if LEN bytes of DATA match the registers of M from REG
+static bool Test_match(const Memory* m, uint8_t reg, const uint8_t* data, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] != m->reg[(uint8_t) (reg + i)])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Transfers on the software bus
+static void Test_functions(I2C_SoftBus* bus)
+{
+    uint8_t data[16];
+    uint8_t len;
+    
+    printf("software bus on RB%u (SCL) and RB%u (SDA), %u us half period\n",
+            SOFT_SCL_PIN, SOFT_SDA_PIN, I2C_SOFT_HALF_PERIOD_US);
+    
+    //Write the pointer and 3 bytes, then read them back
+    uint8_t write[] = {0x40, 0xA1, 0xB2, 0xC3};
+    Test_check("write", I2C_Soft_sendBytes(bus, SENSOR_ADDR, &write[0], sizeof(write))
+            && Test_match(&softSensor, 0x40, &write[1], 3));
+    Test_check("write then read", I2C_Soft_registerWriteRead(bus, SENSOR_ADDR, 0x40, &data[0], 3)
+            && Test_match(&softSensor, 0x40, &data[0], 3));
+    Test_check("read from the pointer", I2C_Soft_readBytes(bus, SENSOR_ADDR, &data[0], 2)
+            && Test_match(&softSensor, 0x43, &data[0], 2));
+    
+    //Only the software bus carries the transactions
+    Sim_Stats stats;
+    Sim_getStats(&stats);
+    Test_check("STARTs and bytes seen on the software bus only",
+            (stats.softStarts == 4) && (stats.softBytes == 10) && (stats.starts == 0));
+    
+    //No device at the address
+    Test_check("NACK", !I2C_Soft_sendBytes(bus, ABSENT_ADDR, &write[0], 1)
+            && (I2C_Soft_getLastError(bus) == I2C_HOST_NACK));
+    
+    //Stretching shorter than the timeout only slows the bus
+    Sim_setSoftStretch(300 * SIM_PS_PER_US);
+    Test_check("300 us clock stretch", I2C_Soft_registerWriteRead(bus, SENSOR_ADDR, 0x40, &data[0], 3)
+            && Test_match(&softSensor, 0x40, &data[0], 3));
+    
+    //SCL held low - the transfer ends after I2C_SOFT_STRETCH_TICKS half periods
+    Sim_setSoftStretch(SIM_SOFT_STUCK);
+    Test_check("SCL held low times out", !I2C_Soft_registerWriteRead(bus, SENSOR_ADDR, 0x40, &data[0], 3)
+            && (I2C_Soft_getLastError(bus) == I2C_HOST_TIMEOUT));
+    Sim_setSoftStretch(0);
+    Test_check("bus recovers once SCL is released", I2C_Soft_registerWriteRead(bus, SENSOR_ADDR, 0x40, &data[0], 3)
+            && Test_match(&softSensor, 0x40, &data[0], 3));
+    
+    //The 1st byte read is the block length
+    Test_check("block length", I2C_Soft_registerReadBlock(bus, SENSOR_ADDR, BLOCK_REG, &data[0], sizeof(data), &len)
+            && (len == BLOCK_LEN) && Test_match(&softSensor, BLOCK_REG + 1, &data[0], BLOCK_LEN));
+    Test_check("block larger than MAXLEN fails, and reports its length",
+            !I2C_Soft_registerReadBlock(bus, SENSOR_ADDR, BLOCK_REG, &data[0], 4, &len) && (len == BLOCK_LEN));
+}
+
+//Sweep of ROUNDS rounds: a SENSOR_BYTES read of the sensor, and BLOCK bytes written to the memory and read back
+//The sensor is on I2C1, or on BUS if BUS is not 0. Runs in a burst (4 MHz), as the software bus needs the CPU time
+//Returns the payload bytes per second, or 0 if a transfer failed
+static double Test_sweep(I2C_SoftBus* bus, uint8_t block)
+{
+    uint8_t write[1 + 128];
+    uint8_t read[128];
+    uint8_t temp[SENSOR_BYTES];
+    uint8_t reg = SENSOR_REG;
+    bool ok = true;
+    
+    Power_beginBurst();
+    Sim_flush(SIM_HOST);
+    uint64_t start = Sim_now(SIM_HOST);
+    
+    for (uint8_t n = 0; n < ROUNDS; n++)
+    {
+        uint8_t address = (uint8_t) (n * block);
+        
+        write[0] = address;
+        for (uint8_t i = 0; i < block; i++)
+        {
+            write[1 + i] = (uint8_t) (n ^ i);
+        }
+        
+        //The sensor read runs on the software bus while I2C1 waits
+        if (bus != 0)
+        {
+            ok &= I2C_Soft_startTransfer(bus, SENSOR_ADDR, &reg, 1, &temp[0], SENSOR_BYTES);
+        }
+        else
+        {
+            ok &= I2C_registerWriteRead(SENSOR_ADDR, SENSOR_REG, &temp[0], SENSOR_BYTES);
+        }
+        
+        ok &= I2C_sendBytes(MEMORY_ADDR, &write[0], block + 1);
+        ok &= I2C_registerWriteRead(MEMORY_ADDR, address, &read[0], block);
+        ok &= Test_match(&memory, address, &read[0], block);
+        
+        if (bus != 0)
+        {
+            ok &= I2C_Soft_waitForTransfer(bus);
+        }
+        ok &= Test_match((bus != 0) ? &softSensor : &sensor, SENSOR_REG, &temp[0], SENSOR_BYTES);
+    }
+    
+    Sim_flush(SIM_HOST);
+    uint64_t time = Sim_now(SIM_HOST) - start;
+    Power_endBurst();
+    
+    if (!ok)
+    {
+        return 0;
+    }
+    return (double) ROUNDS * (SENSOR_BYTES + 2 * block) * SIM_PS_PER_US * 1000000 / time;
+}
+
+int main(void)
+{
+    static const uint8_t blocks[] = {8, 32, 64, 128};
+    
+    SimHost_init();
+    
+    Memory_init(&softSensor, SENSOR_ADDR, 0x00);
+    Memory_init(&sensor, SENSOR_ADDR, 0x00);
+    Memory_init(&memory, MEMORY_ADDR, 0x80);
+    softSensor.reg[BLOCK_REG] = BLOCK_LEN;
+    
+    Sim_attachDevice(&sensor.dev);
+    Sim_attachDevice(&memory.dev);
+    Sim_setupSoftBus(SOFT_SCL_PIN, SOFT_SDA_PIN);
+    Sim_attachSoftDevice(&softSensor.dev);
+    
+    I2C_SoftBus bus = I2C_SOFT_BUS(B, SOFT_SCL_PIN, SOFT_SDA_PIN);
+    I2C_Soft_init(&bus);
+    
+    Sim_clearStats();
+    Test_functions(&bus);
+    
+    //Throughput of the same sweep, with the sensor on I2C1 or on the software bus
+    I2C_assignWaitHandler(&I2C_Soft_service);
+    
+    printf("sweep of %u rounds: %u-byte sensor read, memory block written and read back\n", ROUNDS, SENSOR_BYTES);
+    printf("  %-6s | %-14s | %-14s | %s\n", "block", "I2C1 alone", "I2C1 + soft", "gain");
+    
+    bool gain = false;
+    for (uint8_t i = 0; i < sizeof(blocks); i++)
+    {
+        double single = Test_sweep(0, blocks[i]);
+        double split = Test_sweep(&bus, blocks[i]);
+        
+        printf("  %6u | %8.0f B/s | %8.0f B/s | %+5.1f %%\n", blocks[i], single, split,
+                (single != 0) ? (split / single - 1) * 100 : 0.0);
+        
+        if ((single == 0) || (split == 0))
+        {
+            failures++;
+        }
+        gain = gain || (split > single);
+    }
+    
+    if (failures != 0)
+    {
+        printf("FAIL: %u checks\n", failures);
+        return 1;
+    }
+    
+    if (!gain)
+    {
+        printf("FAIL: splitting the sweep is never faster\n");
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,71 @@
+//Randomized transaction storm (user guide: "Loopback Test") on the simulated bus
+//Usage: storm [transactions] [seed]. The client is built with I2C_CLIENT_ISR_STATS
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_client.h"
+#include "sim_host.h"
+
+#include "loopback.h"
+
+int main(int argc, char** argv)
+{
+    uint32_t count = (argc > 1) ? (uint32_t) strtoul(argv[1], 0, 0) : LOOPBACK_STORM_TRANSACTIONS;
+    uint16_t seed = (argc > 2) ? (uint16_t) strtoul(argv[2], 0, 0) : 0xACE1;
+
+    SimHost_init();
+    SimClient_init();
+    Sim_clearStats();
+
+    Loopback_StormResults results;
+    uint64_t start = Sim_now(SIM_HOST);
+    bool ok = Loopback_runStorm(count, seed, &results);
+    uint64_t elapsed = Sim_now(SIM_HOST) - start;
+
+    Sim_Stats stats;
+    Sim_getStats(&stats);
+
+    printf("loopback storm, seed 0x%04X\n", seed);
+    printf("  transactions %lu, bytes %lu, errors %lu", (unsigned long) results.transactions,
+            (unsigned long) results.bytes, (unsigned long) results.errors);
+    if (results.firstError != 0)
+    {
+        printf(" (1st at %lu)", (unsigned long) results.firstError);
+    }
+    printf("\n");
+
+    //Power_getTime wraps after ~2.4 hours of 2 us ticks, so the check is only made below that
+    uint64_t measured = (uint64_t) results.ticks * 2 * SIM_PS_PER_US;
+    printf("  time %.2f s (TMR1 %.2f s)\n", (double) elapsed / (1000 * SIM_PS_PER_MS),
+            (double) measured / (1000 * SIM_PS_PER_MS));
+
+    SimHost_printStats();
+
+    //ISR load per transaction, from the simulated client and from the client's own timebase
+    uint64_t ns;
+    uint32_t stops;
+    printf("  client ISR time per transaction: %.2f us", (double) stats.isrTime / stats.stops / SIM_PS_PER_US);
+    if (SimClient_getISRLoad(&ns, &stops) && (stops != 0))
+    {
+        printf(" (I2C_getISRLoad: %.2f us over %lu STOPs)", (double) ns / stops / 1000, (unsigned long) stops);
+    }
+    printf("\n");
+
+    if (!ok)
+    {
+        printf("FAIL: %lu errors\n", (unsigned long) results.errors);
+        return 1;
+    }
+
+    uint64_t error = (measured > elapsed) ? (measured - elapsed) : (elapsed - measured);
+    if ((elapsed < (uint64_t) 8000 * 1000 * SIM_PS_PER_MS) && (error > (elapsed / 100)))
+    {
+        printf("FAIL: TMR1 time differs from the simulated time\n");
+        return 1;
+    }
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+//Clock stretch of the client's TX path (user guide: "TX Prefetch") at 100 kHz, 400 kHz and 1 MHz
+//The host reads the client's 16 byte buffer, and the model measures how long the client held SCL
+//for I2C1TXB. This is done with the read handler of main.c, and with one that takes 5 us longer.
+//Built once with I2C_TX_PREFETCH (stretch) and once without (stretch-noprefetch)
+
+#include <xc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sim_client.h"
+#include "sim_host.h"
+
+#include "i2c_host.h"
+
+#define CLIENT_ADDR 0x64
+#define BUFFER_SIZE 16
+#define READS 200
+
+//Extra time of the slow read handler, in client instruction cycles (64 MHz, 62.5 ns)
+#define SLOW_HANDLER_TCY 80
+
+//Host bus rates (HFINTOSC, 4 MHz)
+typedef struct {
+    const char* name;
+    uint8_t baud;
+    bool fme;
+} Rate;
+
+static const Rate rates[] = {
+    {"100 kHz", 8, false},
+    {"400 kHz", 1, false},
+    {"1 MHz", 0, true}
+};
+
+//Runs the reads at RATE. Returns the number of errors
+static uint32_t Test_run(const Rate* rate, const char* handler, uint16_t delay)
+{
+    uint32_t errors = 0;
+    uint8_t data[BUFFER_SIZE];
+    
+    SimClient_setReadDelay(delay);
+    I2C1BAUD = rate->baud;
+    I2C1CON2bits.FME = rate->fme;
+    Sim_clearStats();
+    
+    uint64_t start = Sim_now(SIM_HOST);
+    
+    for (uint16_t n = 0; n < READS; n++)
+    {
+        //Read the buffer from a different start each time
+        uint8_t offset = (uint8_t) (n % 4);
+        uint8_t len = BUFFER_SIZE - offset;
+        
+        if (!I2C_registerWriteRead(CLIENT_ADDR, offset, &data[0], len))
+        {
+            errors++;
+            continue;
+        }
+        
+        for (uint8_t i = 0; i < len; i++)
+        {
+            if (data[i] != (uint8_t) (0xA0 + offset + i))
+            {
+                errors++;
+                break;
+            }
+        }
+    }
+    
+    uint64_t elapsed = Sim_now(SIM_HOST) - start;
+    
+    Sim_Stats stats;
+    Sim_getStats(&stats);
+    
+    uint32_t holds = stats.holds[SIM_HOLD_CLIENT_TX];
+    double total = (double) stats.holdTime[SIM_HOLD_CLIENT_TX] / SIM_PS_PER_US;
+    
+    printf("  %-8s %-10s TX holds %.1f per read, avg %5.2f us, worst %5.2f us, %6.2f us per read | %5.1f ms\n",
+            rate->name, handler, (double) holds / READS, (holds != 0) ? total / holds : 0.0,
+            (double) stats.holdWorst[SIM_HOLD_CLIENT_TX] / SIM_PS_PER_US, total / READS,
+            (double) elapsed / SIM_PS_PER_MS);
+    
+    return errors;
+}
+
+int main(void)
+{
+    SimHost_init();
+    SimClient_init();
+    
+    uint8_t block[BUFFER_SIZE + 1];
+    uint32_t errors = 0;
+    
+    //Register address, then the data
+    block[0] = 0x00;
+    for (uint8_t i = 0; i < BUFFER_SIZE; i++)
+    {
+        block[1 + i] = (uint8_t) (0xA0 + i);
+    }
+    
+    if (!I2C_sendBytes(CLIENT_ADDR, &block[0], BUFFER_SIZE + 1))
+    {
+        errors++;
+    }
+    
+    printf("client TX stretch, %u reads of %u bytes (%s)\n", READS, BUFFER_SIZE,
+            (SimClient_hasTxPrefetch()) ? "I2C_TX_PREFETCH" : "no prefetch");
+    
+    for (uint8_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        errors += Test_run(&rates[r], "main.c", 0);
+        errors += Test_run(&rates[r], "+5 us", SLOW_HANDLER_TCY);
+    }
+    
+    printf("  client I2C_getWorstTxStretch %.2f us\n", (double) SimClient_getWorstTxStretch() / 1000);
+    
+    if (errors != 0)
+    {
+        printf("FAIL: %u errors\n", errors);
+        return 1;
+    }
+    
+    printf("PASS\n");
+    return 0;
+}
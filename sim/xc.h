@@ -0,0 +1,440 @@
+//Stand-in for the XC8 device header, used to build the drivers on a PC
+//Every SFR access goes through sim_reg(), so the bus model sees it at the CPU's simulated time
+//SIM_CPU selects the CPU that the file is built for (see sim.h)
+
+#ifndef SIM_XC_H
+#define	SIM_XC_H
+
+#include <stdint.h>
+
+#include "sim_regs.h"
+
+#ifndef SIM_CPU
+#error "Build with -DSIM_CPU=<n> (see sim.h)"
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+    
+    volatile uint8_t* sim_reg(uint8_t cpu, Sim_Register reg);
+    void sim_sleep(uint8_t cpu);
+    void sim_nop(uint8_t cpu);
+
+#ifdef	__cplusplus
+}
+#endif
+
+//Compiler keywords and intrinsics
+#define __interrupt(...)
+#define SLEEP() sim_sleep(SIM_CPU)
+#define NOP() sim_nop(SIM_CPU)
+
+#define SIM_SFR(name) (*(volatile uint8_t*) sim_reg(SIM_CPU, SIM_##name))
+#define SIM_SFR_BITS(name) (*(volatile name##bits_t*) sim_reg(SIM_CPU, SIM_##name))
+
+//Registers without bit definitions
+#define I2C1CNTL SIM_SFR(I2C1CNTL)
+#define I2C1CNTH SIM_SFR(I2C1CNTH)
+#define I2C1ADB0 SIM_SFR(I2C1ADB0)
+#define I2C1ADB1 SIM_SFR(I2C1ADB1)
+#define I2C1ADR0 SIM_SFR(I2C1ADR0)
+#define I2C1ADR1 SIM_SFR(I2C1ADR1)
+#define I2C1ADR2 SIM_SFR(I2C1ADR2)
+#define I2C1ADR3 SIM_SFR(I2C1ADR3)
+#define I2C1TXB SIM_SFR(I2C1TXB)
+#define I2C1RXB SIM_SFR(I2C1RXB)
+#define I2C1BAUD SIM_SFR(I2C1BAUD)
+#define I2C1CLK SIM_SFR(I2C1CLK)
+#define I2C1BTO SIM_SFR(I2C1BTO)
+#define I2C1BTOC SIM_SFR(I2C1BTOC)
+#define I2C1SCLPPS SIM_SFR(I2C1SCLPPS)
+#define I2C1SDAPPS SIM_SFR(I2C1SDAPPS)
+#define I2C1CON3 SIM_SFR(I2C1CON3)
+#define OSCCON1 SIM_SFR(OSCCON1)
+#define OSCCON2 SIM_SFR(OSCCON2)
+#define T1CLK SIM_SFR(T1CLK)
+#define TMR1H SIM_SFR(TMR1H)
+#define TMR1L SIM_SFR(TMR1L)
+#define T2CLKCON SIM_SFR(T2CLKCON)
+#define T2HLT SIM_SFR(T2HLT)
+#define T2PR SIM_SFR(T2PR)
+#define T2TMR SIM_SFR(T2TMR)
+#define T4CLKCON SIM_SFR(T4CLKCON)
+#define T4PR SIM_SFR(T4PR)
+#define T4TMR SIM_SFR(T4TMR)
+#define PORTB SIM_SFR(PORTB)
+#define LATB SIM_SFR(LATB)
+#define WPUB SIM_SFR(WPUB)
+#define IOCBP SIM_SFR(IOCBP)
+#define PORTC SIM_SFR(PORTC)
+#define LATC SIM_SFR(LATC)
+#define RC3PPS SIM_SFR(RC3PPS)
+#define RC4PPS SIM_SFR(RC4PPS)
+
+//Registers with bit definitions - the bit order matches the PIC18F56Q71 data sheet (LSb first)
+typedef union {
+    struct {
+        uint8_t MODE : 3;
+        uint8_t MDR : 1;
+        uint8_t CSTR : 1;
+        uint8_t S : 1;
+        uint8_t RSEN : 1;
+        uint8_t EN : 1;
+    };
+} I2C1CON0bits_t;
+#define I2C1CON0 SIM_SFR(I2C1CON0)
+#define I2C1CON0bits SIM_SFR_BITS(I2C1CON0)
+
+typedef union {
+    struct {
+        uint8_t CSD : 1;
+        uint8_t TXU : 1;
+        uint8_t RXO : 1;
+        uint8_t : 1;
+        uint8_t ACKT : 1;
+        uint8_t ACKSTAT : 1;
+        uint8_t ACKDT : 1;
+        uint8_t ACKCNT : 1;
+    };
+} I2C1CON1bits_t;
+#define I2C1CON1 SIM_SFR(I2C1CON1)
+#define I2C1CON1bits SIM_SFR_BITS(I2C1CON1)
+
+typedef union {
+    struct {
+        uint8_t BFRET : 2;
+        uint8_t SDAHT : 2;
+        uint8_t ABD : 1;
+        uint8_t FME : 1;
+        uint8_t GCEN : 1;
+        uint8_t ACNT : 1;
+    };
+} I2C1CON2bits_t;
+#define I2C1CON2 SIM_SFR(I2C1CON2)
+#define I2C1CON2bits SIM_SFR_BITS(I2C1CON2)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t D : 1;
+        uint8_t R : 1;
+        uint8_t MMA : 1;
+        uint8_t SMA : 1;
+        uint8_t BFRE : 1;
+    };
+} I2C1STAT0bits_t;
+#define I2C1STAT0 SIM_SFR(I2C1STAT0)
+#define I2C1STAT0bits SIM_SFR_BITS(I2C1STAT0)
+
+typedef union {
+    struct {
+        uint8_t RXBF : 1;
+        uint8_t : 1;
+        uint8_t CLRBF : 1;
+        uint8_t RXRE : 1;
+        uint8_t : 1;
+        uint8_t TXBE : 1;
+        uint8_t : 1;
+        uint8_t TXWE : 1;
+    };
+} I2C1STAT1bits_t;
+#define I2C1STAT1 SIM_SFR(I2C1STAT1)
+#define I2C1STAT1bits SIM_SFR_BITS(I2C1STAT1)
+
+typedef union {
+    struct {
+        uint8_t SCIF : 1;
+        uint8_t RSCIF : 1;
+        uint8_t PCIF : 1;
+        uint8_t ADRIF : 1;
+        uint8_t WRIF : 1;
+        uint8_t : 1;
+        uint8_t ACKTIF : 1;
+        uint8_t CNTIF : 1;
+    };
+} I2C1PIRbits_t;
+#define I2C1PIR SIM_SFR(I2C1PIR)
+#define I2C1PIRbits SIM_SFR_BITS(I2C1PIR)
+
+typedef union {
+    struct {
+        uint8_t SCIE : 1;
+        uint8_t RSCIE : 1;
+        uint8_t PCIE : 1;
+        uint8_t ADRIE : 1;
+        uint8_t WRIE : 1;
+        uint8_t : 1;
+        uint8_t ACKTIE : 1;
+        uint8_t CNTIE : 1;
+    };
+    struct {
+        uint8_t : 2;
+        uint8_t PC1IE : 1;
+    };
+} I2C1PIEbits_t;
+#define I2C1PIE SIM_SFR(I2C1PIE)
+#define I2C1PIEbits SIM_SFR_BITS(I2C1PIE)
+
+typedef union {
+    struct {
+        uint8_t NACKIE : 1;
+        uint8_t BCLIE : 1;
+        uint8_t BTOIE : 1;
+        uint8_t : 1;
+        uint8_t NACKIF : 1;
+        uint8_t BCLIF : 1;
+        uint8_t BTOIF : 1;
+        uint8_t : 1;
+    };
+} I2C1ERRbits_t;
+#define I2C1ERR SIM_SFR(I2C1ERR)
+#define I2C1ERRbits SIM_SFR_BITS(I2C1ERR)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t TMR2IF : 1;
+        uint8_t TMR1IF : 1;
+        uint8_t : 2;
+        uint8_t TMR0IF : 1;
+    };
+} PIR3bits_t;
+#define PIR3 SIM_SFR(PIR3)
+#define PIR3bits SIM_SFR_BITS(PIR3)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t TMR2IE : 1;
+        uint8_t TMR1IE : 1;
+        uint8_t : 2;
+        uint8_t TMR0IE : 1;
+    };
+} PIE3bits_t;
+#define PIE3 SIM_SFR(PIE3)
+#define PIE3bits SIM_SFR_BITS(PIE3)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t TMR2IP : 1;
+        uint8_t TMR1IP : 1;
+        uint8_t : 2;
+        uint8_t TMR0IP : 1;
+    };
+} IPR3bits_t;
+#define IPR3 SIM_SFR(IPR3)
+#define IPR3bits SIM_SFR_BITS(IPR3)
+
+typedef union {
+    struct {
+        uint8_t I2C1RXIF : 1;
+        uint8_t I2C1TXIF : 1;
+        uint8_t I2C1IF : 1;
+        uint8_t I2C1EIF : 1;
+        uint8_t : 4;
+    };
+} PIR7bits_t;
+#define PIR7 SIM_SFR(PIR7)
+#define PIR7bits SIM_SFR_BITS(PIR7)
+
+typedef union {
+    struct {
+        uint8_t I2C1RXIE : 1;
+        uint8_t I2C1TXIE : 1;
+        uint8_t I2C1IE : 1;
+        uint8_t I2C1EIE : 1;
+        uint8_t : 4;
+    };
+} PIE7bits_t;
+#define PIE7 SIM_SFR(PIE7)
+#define PIE7bits SIM_SFR_BITS(PIE7)
+
+typedef union {
+    struct {
+        uint8_t I2C1RXIP : 1;
+        uint8_t I2C1TXIP : 1;
+        uint8_t I2C1IP : 1;
+        uint8_t I2C1EIP : 1;
+        uint8_t : 4;
+    };
+} IPR7bits_t;
+#define IPR7 SIM_SFR(IPR7)
+#define IPR7bits SIM_SFR_BITS(IPR7)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t TMR4IF : 1;
+        uint8_t : 4;
+    };
+} PIR11bits_t;
+#define PIR11 SIM_SFR(PIR11)
+#define PIR11bits SIM_SFR_BITS(PIR11)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t TMR4IE : 1;
+        uint8_t : 4;
+    };
+} PIE11bits_t;
+#define PIE11 SIM_SFR(PIE11)
+#define PIE11bits SIM_SFR_BITS(PIE11)
+
+typedef union {
+    struct {
+        uint8_t : 3;
+        uint8_t TMR4IP : 1;
+        uint8_t : 4;
+    };
+} IPR11bits_t;
+#define IPR11 SIM_SFR(IPR11)
+#define IPR11bits SIM_SFR_BITS(IPR11)
+
+typedef union {
+    struct {
+        uint8_t INT0EDG : 1;
+        uint8_t INT1EDG : 1;
+        uint8_t INT2EDG : 1;
+        uint8_t : 2;
+        uint8_t IPEN : 1;
+        uint8_t GIEL : 1;
+        uint8_t GIE : 1;
+    };
+} INTCON0bits_t;
+#define INTCON0 SIM_SFR(INTCON0)
+#define INTCON0bits SIM_SFR_BITS(INTCON0)
+
+typedef union {
+    struct {
+        uint8_t DOZE : 3;
+        uint8_t : 1;
+        uint8_t DOE : 1;
+        uint8_t ROI : 1;
+        uint8_t DOZEN : 1;
+        uint8_t IDLEN : 1;
+    };
+} CPUDOZEbits_t;
+#define CPUDOZE SIM_SFR(CPUDOZE)
+#define CPUDOZEbits SIM_SFR_BITS(CPUDOZE)
+
+typedef union {
+    struct {
+        uint8_t ON : 1;
+        uint8_t RD16 : 1;
+        uint8_t SYNC : 1;
+        uint8_t : 1;
+        uint8_t CKPS : 2;
+        uint8_t : 2;
+    };
+} T1CONbits_t;
+#define T1CON SIM_SFR(T1CON)
+#define T1CONbits SIM_SFR_BITS(T1CON)
+
+typedef union {
+    struct {
+        uint8_t OUTPS : 4;
+        uint8_t CKPS : 3;
+        uint8_t ON : 1;
+    };
+} T2CONbits_t;
+#define T2CON SIM_SFR(T2CON)
+#define T2CONbits SIM_SFR_BITS(T2CON)
+
+typedef T2CONbits_t T4CONbits_t;
+#define T4CON SIM_SFR(T4CON)
+#define T4CONbits SIM_SFR_BITS(T4CON)
+
+typedef union {
+    struct {
+        uint8_t MODE : 5;
+        uint8_t CKSYNC : 1;
+        uint8_t CKPOL : 1;
+        uint8_t PSYNC : 1;
+    };
+} T4HLTbits_t;
+#define T4HLT SIM_SFR(T4HLT)
+#define T4HLTbits SIM_SFR_BITS(T4HLT)
+
+//Port B (the expander's !INT is on RB4, the software bus of i2c_soft.c on RB1 and RB2)
+//ANSELx, TRISx and ODCONx have no byte names here - i2c_core.h pastes them into ANSELxbits
+//Port B has them for I2C_SOFT_BUS, so I2C1 must not be moved to port B
+#define ANSELB SIM_SFR(ANSELB)
+#define TRISB SIM_SFR(TRISB)
+typedef union {
+    struct {
+        uint8_t ANSELB0 : 1, ANSELB1 : 1, ANSELB2 : 1, ANSELB3 : 1;
+        uint8_t ANSELB4 : 1, ANSELB5 : 1, ANSELB6 : 1, ANSELB7 : 1;
+    };
+} ANSELBbits_t;
+#define ANSELBbits SIM_SFR_BITS(ANSELB)
+
+typedef union {
+    struct {
+        uint8_t TRISB0 : 1, TRISB1 : 1, TRISB2 : 1, TRISB3 : 1;
+        uint8_t TRISB4 : 1, TRISB5 : 1, TRISB6 : 1, TRISB7 : 1;
+    };
+} TRISBbits_t;
+#define TRISBbits SIM_SFR_BITS(TRISB)
+
+typedef union {
+    struct {
+        uint8_t IOCBN0 : 1, IOCBN1 : 1, IOCBN2 : 1, IOCBN3 : 1;
+        uint8_t IOCBN4 : 1, IOCBN5 : 1, IOCBN6 : 1, IOCBN7 : 1;
+    };
+} IOCBNbits_t;
+#define IOCBN SIM_SFR(IOCBN)
+#define IOCBNbits SIM_SFR_BITS(IOCBN)
+
+typedef union {
+    struct {
+        uint8_t IOCBF0 : 1, IOCBF1 : 1, IOCBF2 : 1, IOCBF3 : 1;
+        uint8_t IOCBF4 : 1, IOCBF5 : 1, IOCBF6 : 1, IOCBF7 : 1;
+    };
+} IOCBFbits_t;
+#define IOCBF SIM_SFR(IOCBF)
+#define IOCBFbits SIM_SFR_BITS(IOCBF)
+
+//Port C (I2C1 on RC3 and RC4)
+typedef union {
+    struct {
+        uint8_t ANSELC0 : 1, ANSELC1 : 1, ANSELC2 : 1, ANSELC3 : 1;
+        uint8_t ANSELC4 : 1, ANSELC5 : 1, ANSELC6 : 1, ANSELC7 : 1;
+    };
+} ANSELCbits_t;
+#define ANSELCbits SIM_SFR_BITS(ANSELC)
+
+typedef union {
+    struct {
+        uint8_t TRISC0 : 1, TRISC1 : 1, TRISC2 : 1, TRISC3 : 1;
+        uint8_t TRISC4 : 1, TRISC5 : 1, TRISC6 : 1, TRISC7 : 1;
+    };
+} TRISCbits_t;
+#define TRISCbits SIM_SFR_BITS(TRISC)
+
+typedef union {
+    struct {
+        uint8_t ODCC0 : 1, ODCC1 : 1, ODCC2 : 1, ODCC3 : 1;
+        uint8_t ODCC4 : 1, ODCC5 : 1, ODCC6 : 1, ODCC7 : 1;
+    };
+} ODCONCbits_t;
+#define ODCONCbits SIM_SFR_BITS(ODCONC)
+
+typedef union {
+    struct {
+        uint8_t TH : 2;
+        uint8_t : 2;
+        uint8_t PU : 2;
+        uint8_t SLEW : 2;
+    };
+} RC3I2Cbits_t;
+#define RC3I2C SIM_SFR(RC3I2C)
+#define RC3I2Cbits SIM_SFR_BITS(RC3I2C)
+
+typedef RC3I2Cbits_t RC4I2Cbits_t;
+#define RC4I2C SIM_SFR(RC4I2C)
+#define RC4I2Cbits SIM_SFR_BITS(RC4I2C)
+
+#endif	/* SIM_XC_H */